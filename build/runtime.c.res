@@ -0,0 +1,625 @@
+#define RUNTIME_C_RES { \
+	"#define _DEFAULT_SOURCE\n", \
+	"#include <unistd.h>\n", \
+	"#include <sys/mman.h>\n", \
+	"#include \"runtime.h\"\n", \
+	"\n", \
+	"#ifdef __SSE2__\n", \
+	"#include <emmintrin.h>\n", \
+	"#endif\n", \
+	"\n", \
+	"char japrint_buf[JAPRINT_BUF_SIZE];\n", \
+	"int64_t japrint_len;\n", \
+	"static int japrint_linebuf = -1;\n", \
+	"\n", \
+	"jastring ja_read_file(jastring filename)\n", \
+	"{\n", \
+	"	FILE *fs = fopen(filename.string, \"rb\");\n", \
+	"	if(!fs) return (jastring){0};\n", \
+	"	fseek(fs, 0, SEEK_END);\n", \
+	"	int64_t len = ftell(fs);\n", \
+	"	rewind(fs);\n", \
+	"	char *text = malloc(len + 1);\n", \
+	"	text[len] = 0;\n", \
+	"	fread(text, 1, len, fs);\n", \
+	"	fclose(fs);\n", \
+	"	return (jastring){.length = len, .string = text};\n", \
+	"}\n", \
+	"\n", \
+	"_Noreturn void jabounds_fail(int64_t index, int64_t length, char *where)\n", \
+	"{\n", \
+	"	jaflush();\n", \
+	"	\n", \
+	"	fprintf(\n", \
+	"		stderr,\n", \
+	"		\"%s: error: index %\" PRId64 \" is out of range 0 .. %\" PRId64 \"\\n\",\n", \
+	"		where, index, length - 1\n", \
+	"	);\n", \
+	"	\n", \
+	"	exit(EXIT_FAILURE);\n", \
+	"}\n", \
+	"\n", \
+	"static _Noreturn void jaout_of_memory()\n", \
+	"{\n", \
+	"	jaflush();\n", \
+	"	fprintf(stderr, \"error: out of memory\\n\");\n", \
+	"	exit(EXIT_FAILURE);\n", \
+	"}\n", \
+	"\n", \
+	"_Noreturn void jadynarray_fail(char *msg, char *where)\n", \
+	"{\n", \
+	"	jaflush();\n", \
+	"	fprintf(stderr, \"%s: error: %s\\n\", where, msg);\n", \
+	"	exit(EXIT_FAILURE);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Grow the buffer to hold at least capacity items, at least doubling it;\n", \
+	"	returns keep moved along if it pointed into the old buffer\n", \
+	"*/\n", \
+	"void *jadynarray_grow(\n", \
+	"	jadynarray *array, int64_t capacity, int64_t itemsize, void *keep\n", \
+	") {\n", \
+	"	int64_t new_cap = array->capacity * 2;\n", \
+	"	\n", \
+	"	if(new_cap < capacity) new_cap = capacity;\n", \
+	"	if(new_cap < 8) new_cap = 8;\n", \
+	"	\n", \
+	"	// the old buffer must not be looked at once realloc has freed it\n", \
+	"	uintptr_t offset = (uintptr_t)keep - (uintptr_t)array->items;\n", \
+	"	jabool inside = keep && offset < (uintptr_t)(array->length * itemsize);\n", \
+	"	char *items = realloc(array->items, new_cap * itemsize);\n", \
+	"	\n", \
+	"	if(items == 0)\n", \
+	"		jaout_of_memory();\n", \
+	"	\n", \
+	"	if(inside)\n", \
+	"		keep = items + offset;\n", \
+	"	\n", \
+	"	array->items = items;\n", \
+	"	array->capacity = new_cap;\n", \
+	"	return keep;\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Write the decimal digits of val backwards from end, returns the first\n", \
+	"*/\n", \
+	"static char *jaformat_uint(char *end, uint64_t val)\n", \
+	"{\n", \
+	"	do {\n", \
+	"		*--end = '0' + val % 10;\n", \
+	"		val /= 10;\n", \
+	"	} while(val);\n", \
+	"	\n", \
+	"	return end;\n", \
+	"}\n", \
+	"\n", \
+	"jastring jastring_concat(int64_t count, jastring *parts)\n", \
+	"{\n", \
+	"	int64_t length = 0;\n", \
+	"	\n", \
+	"	for(int64_t i = 0; i < count; i ++) {\n", \
+	"		length += parts[i].length;\n", \
+	"	}\n", \
+	"	\n", \
+	"	char *string = malloc(length + 1);\n", \
+	"	char *cursor = string;\n", \
+	"	\n", \
+	"	if(string == 0)\n", \
+	"		jaout_of_memory();\n", \
+	"	\n", \
+	"	for(int64_t i = 0; i < count; i ++) {\n", \
+	"		memcpy(cursor, parts[i].string, parts[i].length);\n", \
+	"		cursor += parts[i].length;\n", \
+	"	}\n", \
+	"	\n", \
+	"	*cursor = 0;\n", \
+	"	return (jastring){.length = length, .string = string};\n", \
+	"}\n", \
+	"\n", \
+	"void jabuilder_append_uint(jabuilder *builder, uint64_t val)\n", \
+	"{\n", \
+	"	char digits[20];\n", \
+	"	char *end = digits + sizeof(digits);\n", \
+	"	char *start = jaformat_uint(end, val);\n", \
+	"	jadynarray_append(builder, start, end - start, 1);\n", \
+	"}\n", \
+	"\n", \
+	"void jabuilder_append_int(jabuilder *builder, int64_t val)\n", \
+	"{\n", \
+	"	if(val < 0) {\n", \
+	"		jabuilder_push(builder, '-');\n", \
+	"		jabuilder_append_uint(builder, -(uint64_t)val);\n", \
+	"	}\n", \
+	"	else {\n", \
+	"		jabuilder_append_uint(builder, val);\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	The string keeps the buffer, terminated for use as a cstring\n", \
+	"*/\n", \
+	"jastring jabuilder_finish(jabuilder *builder)\n", \
+	"{\n", \
+	"	jabuilder_push(builder, 0);\n", \
+	"	jastring string = {.length = builder->length - 1, .string = builder->items};\n", \
+	"	*builder = (jabuilder){0};\n", \
+	"	return string;\n", \
+	"}\n", \
+	"\n", \
+	"#define JAMAP_GROUP 16\n", \
+	"#define JAMAP_EMPTY 0x80\n", \
+	"#define JAMAP_DELETED 0xfe\n", \
+	"\n", \
+	"static uint64_t jamap_hash(jamap_layout *layout, void *key)\n", \
+	"{\n", \
+	"	uint64_t hash = 0;\n", \
+	"	\n", \
+	"	if(layout->strkey) {\n", \
+	"		jastring string = *(jastring*)key;\n", \
+	"		hash = 0xcbf29ce484222325;\n", \
+	"		\n", \
+	"		for(int64_t i = 0; i < string.length; i ++) {\n", \
+	"			hash = (hash ^ (uint8_t)string.string[i]) * 0x100000001b3;\n", \
+	"		}\n", \
+	"	}\n", \
+	"	else {\n", \
+	"		memcpy(&hash, key, layout->keysize);\n", \
+	"	}\n", \
+	"	\n", \
+	"	// mix all bits into the low seven of the control byte\n", \
+	"	hash ^= hash >> 33;\n", \
+	"	hash *= 0xff51afd7ed558ccd;\n", \
+	"	hash ^= hash >> 33;\n", \
+	"	hash *= 0xc4ceb9fe1a85ec53;\n", \
+	"	hash ^= hash >> 33;\n", \
+	"	return hash;\n", \
+	"}\n", \
+	"\n", \
+	"static jabool jamap_key_equ(jamap_layout *layout, void *left, void *right)\n", \
+	"{\n", \
+	"	if(layout->strkey)\n", \
+	"		return jastring_equ(*(jastring*)left, *(jastring*)right);\n", \
+	"	\n", \
+	"	return memcmp(left, right, layout->keysize) == 0;\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Bit i is set if control byte i of the group equals byte\n", \
+	"*/\n", \
+	"static uint32_t jamap_match(uint8_t *group, uint8_t byte)\n", \
+	"{\n", \
+	"#ifdef __SSE2__\n", \
+	"	__m128i ctrl = _mm_loadu_si128((__m128i*)group);\n", \
+	"	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));\n", \
+	"#else\n", \
+	"	uint32_t mask = 0;\n", \
+	"	\n", \
+	"	for(int i = 0; i < JAMAP_GROUP; i ++) {\n", \
+	"		mask |= (uint32_t)(group[i] == byte) << i;\n", \
+	"	}\n", \
+	"	\n", \
+	"	return mask;\n", \
+	"#endif\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Bit i is set if slot i of the group is empty or deleted\n", \
+	"*/\n", \
+	"static uint32_t jamap_match_free(uint8_t *group)\n", \
+	"{\n", \
+	"#ifdef __SSE2__\n", \
+	"	return _mm_movemask_epi8(_mm_loadu_si128((__m128i*)group));\n", \
+	"#else\n", \
+	"	uint32_t mask = 0;\n", \
+	"	\n", \
+	"	for(int i = 0; i < JAMAP_GROUP; i ++) {\n", \
+	"		mask |= (uint32_t)(group[i] >> 7) << i;\n", \
+	"	}\n", \
+	"	\n", \
+	"	return mask;\n", \
+	"#endif\n", \
+	"}\n", \
+	"\n", \
+	"static int64_t jamap_round(int64_t size, int64_t align)\n", \
+	"{\n", \
+	"	return (size + align - 1) / align * align;\n", \
+	"}\n", \
+	"\n", \
+	"static int64_t jamap_val_offset(jamap_layout *layout)\n", \
+	"{\n", \
+	"	return jamap_round(layout->keysize, layout->valalign);\n", \
+	"}\n", \
+	"\n", \
+	"static int64_t jamap_entry_size(jamap_layout *layout)\n", \
+	"{\n", \
+	"	int64_t align = layout->keyalign > layout->valalign ?\n", \
+	"		layout->keyalign : layout->valalign;\n", \
+	"	\n", \
+	"	return jamap_round(jamap_val_offset(layout) + layout->valsize, align);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Returns the slot of key or -1; probing goes group by group in triangular\n", \
+	"	steps, which visits every group of a power of two count, and stops at the\n", \
+	"	first group with an empty slot\n", \
+	"*/\n", \
+	"static int64_t jamap_find_slot(\n", \
+	"	jamap *map, jamap_layout *layout, void *key, uint64_t hash\n", \
+	") {\n", \
+	"	if(map->capacity == 0) return -1;\n", \
+	"	\n", \
+	"	int64_t entry_size = jamap_entry_size(layout);\n", \
+	"	uint64_t mask = map->capacity / JAMAP_GROUP - 1;\n", \
+	"	uint64_t pos = (hash >> 7) & mask;\n", \
+	"	\n", \
+	"	for(uint64_t step = 1;; step ++) {\n", \
+	"		uint8_t *group = map->ctrl + pos * JAMAP_GROUP;\n", \
+	"		uint32_t match = jamap_match(group, hash & 0x7f);\n", \
+	"		\n", \
+	"		while(match) {\n", \
+	"			int64_t slot = pos * JAMAP_GROUP + __builtin_ctz(match);\n", \
+	"			char *entry = map->entries + slot * entry_size;\n", \
+	"			\n", \
+	"			if(jamap_key_equ(layout, entry, key)) return slot;\n", \
+	"			\n", \
+	"			match &= match - 1;\n", \
+	"		}\n", \
+	"		\n", \
+	"		if(jamap_match(group, JAMAP_EMPTY)) return -1;\n", \
+	"		\n", \
+	"		pos = (pos + step) & mask;\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	First empty or deleted slot on the probe sequence of hash\n", \
+	"*/\n", \
+	"static int64_t jamap_free_slot(jamap *map, uint64_t hash)\n", \
+	"{\n", \
+	"	uint64_t mask = map->capacity / JAMAP_GROUP - 1;\n", \
+	"	uint64_t pos = (hash >> 7) & mask;\n", \
+	"	\n", \
+	"	for(uint64_t step = 1;; step ++) {\n", \
+	"		uint32_t match = jamap_match_free(map->ctrl + pos * JAMAP_GROUP);\n", \
+	"		\n", \
+	"		if(match) return pos * JAMAP_GROUP + __builtin_ctz(match);\n", \
+	"		\n", \
+	"		pos = (pos + step) & mask;\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Move all entries into a new table, doubling it unless dropping the\n", \
+	"	deleted slots frees enough room\n", \
+	"*/\n", \
+	"static void jamap_rehash(jamap *map, jamap_layout *layout)\n", \
+	"{\n", \
+	"	int64_t entry_size = jamap_entry_size(layout);\n", \
+	"	int64_t capacity = map->capacity;\n", \
+	"	\n", \
+	"	if(capacity == 0)\n", \
+	"		capacity = JAMAP_GROUP;\n", \
+	"	else if(map->length >= capacity * 7 / 16)\n", \
+	"		capacity *= 2;\n", \
+	"	\n", \
+	"	uint8_t *ctrl = malloc(capacity + capacity * entry_size);\n", \
+	"	\n", \
+	"	if(ctrl == 0)\n", \
+	"		jaout_of_memory();\n", \
+	"	\n", \
+	"	memset(ctrl, JAMAP_EMPTY, capacity);\n", \
+	"	\n", \
+	"	jamap old = *map;\n", \
+	"	map->capacity = capacity;\n", \
+	"	map->growth_left = capacity * 7 / 8 - old.length;\n", \
+	"	map->ctrl = ctrl;\n", \
+	"	map->entries = (char*)ctrl + capacity;\n", \
+	"	\n", \
+	"	for(int64_t i = 0; i < old.capacity; i ++) {\n", \
+	"		if(old.ctrl[i] & 0x80) continue;\n", \
+	"		\n", \
+	"		char *entry = old.entries + i * entry_size;\n", \
+	"		uint64_t hash = jamap_hash(layout, entry);\n", \
+	"		int64_t slot = jamap_free_slot(map, hash);\n", \
+	"		\n", \
+	"		map->ctrl[slot] = hash & 0x7f;\n", \
+	"		memcpy(map->entries + slot * entry_size, entry, entry_size);\n", \
+	"	}\n", \
+	"	\n", \
+	"	free(old.ctrl);\n", \
+	"}\n", \
+	"\n", \
+	"void *jamap_find(jamap *map, jamap_layout *layout, void *key)\n", \
+	"{\n", \
+	"	uint64_t hash = jamap_hash(layout, key);\n", \
+	"	int64_t slot = jamap_find_slot(map, layout, key, hash);\n", \
+	"	\n", \
+	"	if(slot < 0) return 0;\n", \
+	"	\n", \
+	"	return\n", \
+	"		map->entries + slot * jamap_entry_size(layout) +\n", \
+	"		jamap_val_offset(layout);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Returns the value of key, a new key gets a zero value\n", \
+	"*/\n", \
+	"void *jamap_insert(jamap *map, jamap_layout *layout, void *key)\n", \
+	"{\n", \
+	"	int64_t entry_size = jamap_entry_size(layout);\n", \
+	"	uint64_t hash = jamap_hash(layout, key);\n", \
+	"	int64_t slot = jamap_find_slot(map, layout, key, hash);\n", \
+	"	\n", \
+	"	if(slot < 0) {\n", \
+	"		if(map->growth_left == 0)\n", \
+	"			jamap_rehash(map, layout);\n", \
+	"		\n", \
+	"		slot = jamap_free_slot(map, hash);\n", \
+	"		\n", \
+	"		// reusing a deleted slot does not use up an empty one\n", \
+	"		if(map->ctrl[slot] == JAMAP_EMPTY)\n", \
+	"			map->growth_left --;\n", \
+	"		\n", \
+	"		char *entry = map->entries + slot * entry_size;\n", \
+	"		map->ctrl[slot] = hash & 0x7f;\n", \
+	"		memset(entry, 0, entry_size);\n", \
+	"		memcpy(entry, key, layout->keysize);\n", \
+	"		map->length ++;\n", \
+	"	}\n", \
+	"	\n", \
+	"	return map->entries + slot * entry_size + jamap_val_offset(layout);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	A slot can go back to empty only if its group still has an empty slot,\n", \
+	"	then no probe sequence passes beyond the group\n", \
+	"*/\n", \
+	"void jamap_remove(jamap *map, jamap_layout *layout, void *key)\n", \
+	"{\n", \
+	"	uint64_t hash = jamap_hash(layout, key);\n", \
+	"	int64_t slot = jamap_find_slot(map, layout, key, hash);\n", \
+	"	\n", \
+	"	if(slot < 0) return;\n", \
+	"	\n", \
+	"	uint8_t *group = map->ctrl + slot / JAMAP_GROUP * JAMAP_GROUP;\n", \
+	"	\n", \
+	"	if(jamap_match(group, JAMAP_EMPTY)) {\n", \
+	"		map->ctrl[slot] = JAMAP_EMPTY;\n", \
+	"		map->growth_left ++;\n", \
+	"	}\n", \
+	"	else {\n", \
+	"		map->ctrl[slot] = JAMAP_DELETED;\n", \
+	"	}\n", \
+	"	\n", \
+	"	map->length --;\n", \
+	"}\n", \
+	"\n", \
+	"void jamap_clear(jamap *map)\n", \
+	"{\n", \
+	"	free(map->ctrl);\n", \
+	"	*map = (jamap){0};\n", \
+	"}\n", \
+	"\n", \
+	"#ifndef JA_SYSTEM_MALLOC\n", \
+	"\n", \
+	"_Thread_local void *jaheap_lists[JAHEAP_CLASSES];\n", \
+	"\n", \
+	"static int64_t jaheap_class_size(int sizeclass)\n", \
+	"{\n", \
+	"	return sizeclass < 16 ? (sizeclass + 1) * 16 : 1 << (sizeclass - 7);\n", \
+	"}\n", \
+	"\n", \
+	"void *jaheap_map(int64_t size)\n", \
+	"{\n", \
+	"	void *ptr = mmap(\n", \
+	"		0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0\n", \
+	"	);\n", \
+	"	\n", \
+	"	if(ptr == MAP_FAILED)\n", \
+	"		jaout_of_memory();\n", \
+	"	\n", \
+	"	return ptr;\n", \
+	"}\n", \
+	"\n", \
+	"void jaheap_unmap(void *ptr, int64_t size)\n", \
+	"{\n", \
+	"	munmap(ptr, size);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	Carve a fresh chunk into objects of the size class, hand out the first\n", \
+	"	and put the rest on the list of this thread. Chunks are never unmapped,\n", \
+	"	freed objects only go back to a list\n", \
+	"*/\n", \
+	"void *jaheap_refill(int sizeclass)\n", \
+	"{\n", \
+	"	int64_t size = jaheap_class_size(sizeclass);\n", \
+	"	char *chunk = jaheap_map(JAHEAP_CHUNK_SIZE);\n", \
+	"	\n", \
+	"	// not every class size divides the chunk, the rest stays unused\n", \
+	"	int64_t count = JAHEAP_CHUNK_SIZE / size;\n", \
+	"	char *last = chunk + (count - 1) * size;\n", \
+	"	\n", \
+	"	for(char *obj = chunk + size; obj < last; obj += size) {\n", \
+	"		*(void**)obj = obj + size;\n", \
+	"	}\n", \
+	"	\n", \
+	"	*(void**)last = jaheap_lists[sizeclass];\n", \
+	"	jaheap_lists[sizeclass] = chunk + size;\n", \
+	"	return chunk;\n", \
+	"}\n", \
+	"\n", \
+	"#endif\n", \
+	"\n", \
+	"/*\n", \
+	"	Move on to the next block that fits, blocks too small for this size are\n", \
+	"	skipped but stay in the chain; a new block is linked in after the\n", \
+	"	current one\n", \
+	"*/\n", \
+	"void *jaarena_alloc_slow(jaarena *arena, int64_t size)\n", \
+	"{\n", \
+	"	jaarena_block *block = arena->current ? arena->current->next : 0;\n", \
+	"	\n", \
+	"	while(block && block->size < size) {\n", \
+	"		block = block->next;\n", \
+	"	}\n", \
+	"	\n", \
+	"	if(!block) {\n", \
+	"		int64_t block_size = size > JAARENA_BLOCK_SIZE ?\n", \
+	"			size : JAARENA_BLOCK_SIZE;\n", \
+	"		\n", \
+	"		block = malloc(sizeof(jaarena_block) + block_size);\n", \
+	"		\n", \
+	"		if(block == 0)\n", \
+	"			jaout_of_memory();\n", \
+	"		\n", \
+	"		block->size = block_size;\n", \
+	"		\n", \
+	"		if(arena->current) {\n", \
+	"			block->next = arena->current->next;\n", \
+	"			arena->current->next = block;\n", \
+	"		}\n", \
+	"		else {\n", \
+	"			block->next = 0;\n", \
+	"			arena->first = block;\n", \
+	"		}\n", \
+	"	}\n", \
+	"	\n", \
+	"	arena->current = block;\n", \
+	"	arena->cursor = (char*)(block + 1) + size;\n", \
+	"	arena->end = (char*)(block + 1) + block->size;\n", \
+	"	return block + 1;\n", \
+	"}\n", \
+	"\n", \
+	"typedef struct JaLib {\n", \
+	"	struct JaLib *next;\n", \
+	"	char *filename;\n", \
+	"	void *handle;\n", \
+	"} JaLib;\n", \
+	"\n", \
+	"static JaLib *jalibs;\n", \
+	"\n", \
+	"void *jaforeign_lib(char *filename)\n", \
+	"{\n", \
+	"	for(JaLib *lib = jalibs; lib; lib = lib->next) {\n", \
+	"		if(strcmp(lib->filename, filename) == 0) return lib->handle;\n", \
+	"	}\n", \
+	"	\n", \
+	"	void *handle = dlopen(filename, RTLD_LAZY);\n", \
+	"	\n", \
+	"	if(handle == 0) {\n", \
+	"		jaflush();\n", \
+	"		fprintf(stderr, \"error: could not load library %s\\n\", filename);\n", \
+	"		exit(EXIT_FAILURE);\n", \
+	"	}\n", \
+	"	\n", \
+	"	JaLib *lib = malloc(sizeof(JaLib));\n", \
+	"	*lib = (JaLib){.next = jalibs, .filename = filename, .handle = handle};\n", \
+	"	jalibs = lib;\n", \
+	"	return handle;\n", \
+	"}\n", \
+	"\n", \
+	"void *jaforeign_bind(char *filename, char *name)\n", \
+	"{\n", \
+	"	void *sym = dlsym(jaforeign_lib(filename), name);\n", \
+	"	\n", \
+	"	if(sym == 0) {\n", \
+	"		jaflush();\n", \
+	"		fprintf(stderr, \"error: could not load symbol %s\\n\", name);\n", \
+	"		exit(EXIT_FAILURE);\n", \
+	"	}\n", \
+	"	\n", \
+	"	return sym;\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_drain()\n", \
+	"{\n", \
+	"	fwrite(japrint_buf, 1, japrint_len, stdout);\n", \
+	"	japrint_len = 0;\n", \
+	"}\n", \
+	"\n", \
+	"void jaflush()\n", \
+	"{\n", \
+	"	japrint_sync();\n", \
+	"	fflush(stdout);\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_raw_slow(char *data, int64_t length)\n", \
+	"{\n", \
+	"	japrint_sync();\n", \
+	"	\n", \
+	"	if(length > JAPRINT_BUF_SIZE) {\n", \
+	"		fwrite(data, 1, length, stdout);\n", \
+	"	}\n", \
+	"	else {\n", \
+	"		memcpy(japrint_buf, data, length);\n", \
+	"		japrint_len = length;\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_string(jastring string)\n", \
+	"{\n", \
+	"	japrint_raw(string.string, string.length);\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_uint(uint64_t val)\n", \
+	"{\n", \
+	"	char digits[20];\n", \
+	"	char *end = digits + sizeof(digits);\n", \
+	"	char *start = jaformat_uint(end, val);\n", \
+	"	japrint_raw(start, end - start);\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_int(int64_t val)\n", \
+	"{\n", \
+	"	if(val < 0) {\n", \
+	"		japrint_raw(\"-\", 1);\n", \
+	"		japrint_uint(-(uint64_t)val);\n", \
+	"	}\n", \
+	"	else {\n", \
+	"		japrint_uint(val);\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_bool(jabool val)\n", \
+	"{\n", \
+	"	if(val)\n", \
+	"		japrint_raw(\"true\", 4);\n", \
+	"	else\n", \
+	"		japrint_raw(\"false\", 5);\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_ptr(void *ptr)\n", \
+	"{\n", \
+	"	static char hexdigits[] = \"0123456789abcdef\";\n", \
+	"	uintptr_t val = (uintptr_t)ptr;\n", \
+	"	char digits[2 + sizeof(val) * 2];\n", \
+	"	char *p = digits + sizeof(digits);\n", \
+	"	\n", \
+	"	if(!ptr) {\n", \
+	"		japrint_raw(\"(nil)\", 5);\n", \
+	"		return;\n", \
+	"	}\n", \
+	"	\n", \
+	"	do {\n", \
+	"		*--p = hexdigits[val & 0xf];\n", \
+	"		val >>= 4;\n", \
+	"	} while(val);\n", \
+	"	\n", \
+	"	*--p = 'x';\n", \
+	"	*--p = '0';\n", \
+	"	japrint_raw(p, digits + sizeof(digits) - p);\n", \
+	"}\n", \
+	"\n", \
+	"void japrint_newline()\n", \
+	"{\n", \
+	"	japrint_raw(\"\\n\", 1);\n", \
+	"	\n", \
+	"	if(japrint_linebuf == -1)\n", \
+	"		japrint_linebuf = isatty(STDOUT_FILENO);\n", \
+	"	\n", \
+	"	if(japrint_linebuf)\n", \
+	"		jaflush();\n", \
+	"}\n", \
+	0 }
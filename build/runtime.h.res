@@ -0,0 +1,419 @@
+#define RUNTIME_H_RES { \
+	"#ifndef JA_RUNTIME_H\n", \
+	"#define JA_RUNTIME_H\n", \
+	"\n", \
+	"#include <stdio.h>\n", \
+	"#include <stdint.h>\n", \
+	"#include <inttypes.h>\n", \
+	"#include <string.h>\n", \
+	"#include <stdlib.h>\n", \
+	"#include <dlfcn.h>\n", \
+	"\n", \
+	"#define jafalse ((jabool)0)\n", \
+	"#define jatrue ((jabool)1)\n", \
+	"\n", \
+	"typedef uint8_t jabool;\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	int64_t length;\n", \
+	"	void *items;\n", \
+	"} jaslice;\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	int64_t length;\n", \
+	"	char *string;\n", \
+	"} jastring;\n", \
+	"\n", \
+	"static inline jabool jastring_equ(jastring left, jastring right)\n", \
+	"{\n", \
+	"	return\n", \
+	"		left.length == right.length &&\n", \
+	"		memcmp(left.string, right.string, left.length) == 0;\n", \
+	"}\n", \
+	"\n", \
+	"jastring ja_read(jastring filename);\n", \
+	"\n", \
+	"/*\n", \
+	"	bounds checks\n", \
+	"	\n", \
+	"	emitted for subscripts when compiling with -bc, unless the analyzer can\n", \
+	"	prove the index to be in range\n", \
+	"*/\n", \
+	"\n", \
+	"__attribute__((cold))\n", \
+	"_Noreturn void jabounds_fail(int64_t index, int64_t length, char *where);\n", \
+	"\n", \
+	"static inline int64_t jabounds(int64_t index, int64_t length, char *where)\n", \
+	"{\n", \
+	"	if(__builtin_expect((uint64_t)index >= (uint64_t)length, 0))\n", \
+	"		jabounds_fail(index, length, where);\n", \
+	"	\n", \
+	"	return index;\n", \
+	"}\n", \
+	"\n", \
+	"static inline void *jaslice_item(\n", \
+	"	jaslice slice, int64_t index, int64_t itemsize, char *where\n", \
+	") {\n", \
+	"	jabounds(index, slice.length, where);\n", \
+	"	return (char*)slice.items + index * itemsize;\n", \
+	"}\n", \
+	"\n", \
+	"static inline jastring jastring_item(\n", \
+	"	jastring string, int64_t index, char *where\n", \
+	") {\n", \
+	"	jabounds(index, string.length, where);\n", \
+	"	return (jastring){1, string.string + index};\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	growable arrays\n", \
+	"	\n", \
+	"	length and items come first as in jaslice; the buffer grows geometrically\n", \
+	"	out of line, so the inline fast paths only compare against the capacity\n", \
+	"*/\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	int64_t length;\n", \
+	"	void *items;\n", \
+	"	int64_t capacity;\n", \
+	"} jadynarray;\n", \
+	"\n", \
+	"__attribute__((cold))\n", \
+	"_Noreturn void jadynarray_fail(char *msg, char *where);\n", \
+	"\n", \
+	"void *jadynarray_grow(\n", \
+	"	jadynarray *array, int64_t capacity, int64_t itemsize, void *keep\n", \
+	");\n", \
+	"\n", \
+	"static inline jaslice jadynarray_view(jadynarray array)\n", \
+	"{\n", \
+	"	return (jaslice){array.length, array.items};\n", \
+	"}\n", \
+	"\n", \
+	"static inline void jadynarray_append(\n", \
+	"	jadynarray *array, void *items, int64_t count, int64_t itemsize\n", \
+	") {\n", \
+	"	int64_t length = array->length + count;\n", \
+	"	\n", \
+	"	// items may point into the buffer that is about to move\n", \
+	"	if(__builtin_expect(length > array->capacity, 0))\n", \
+	"		items = jadynarray_grow(array, length, itemsize, items);\n", \
+	"	\n", \
+	"	memcpy(\n", \
+	"		(char*)array->items + array->length * itemsize, items,\n", \
+	"		count * itemsize\n", \
+	"	);\n", \
+	"	\n", \
+	"	array->length = length;\n", \
+	"}\n", \
+	"\n", \
+	"static inline void jadynarray_append_slice(\n", \
+	"	jadynarray *array, jaslice slice, int64_t itemsize\n", \
+	") {\n", \
+	"	jadynarray_append(array, slice.items, slice.length, itemsize);\n", \
+	"}\n", \
+	"\n", \
+	"static inline void *jadynarray_pop(\n", \
+	"	jadynarray *array, int64_t itemsize, char *where\n", \
+	") {\n", \
+	"	if(__builtin_expect(array->length == 0, 0))\n", \
+	"		jadynarray_fail(\"pop from empty array\", where);\n", \
+	"	\n", \
+	"	array->length --;\n", \
+	"	return (char*)array->items + array->length * itemsize;\n", \
+	"}\n", \
+	"\n", \
+	"static inline void jadynarray_reserve(\n", \
+	"	jadynarray *array, int64_t capacity, int64_t itemsize, char *where\n", \
+	") {\n", \
+	"	if(__builtin_expect(capacity < 0, 0))\n", \
+	"		jadynarray_fail(\"negative capacity\", where);\n", \
+	"	\n", \
+	"	if(capacity > array->capacity)\n", \
+	"		jadynarray_grow(array, capacity, itemsize, 0);\n", \
+	"}\n", \
+	"\n", \
+	"static inline void jadynarray_resize(\n", \
+	"	jadynarray *array, int64_t length, int64_t itemsize, char *where\n", \
+	") {\n", \
+	"	if(__builtin_expect(length < 0, 0))\n", \
+	"		jadynarray_fail(\"negative length\", where);\n", \
+	"	\n", \
+	"	if(length > array->capacity)\n", \
+	"		jadynarray_grow(array, length, itemsize, 0);\n", \
+	"	\n", \
+	"	if(length > array->length) {\n", \
+	"		memset(\n", \
+	"			(char*)array->items + array->length * itemsize, 0,\n", \
+	"			(length - array->length) * itemsize\n", \
+	"		);\n", \
+	"	}\n", \
+	"	\n", \
+	"	array->length = length;\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	string builders and concatenation\n", \
+	"	\n", \
+	"	a builder is a growable array of bytes, finishing it hands the buffer\n", \
+	"	over to the string and leaves the builder empty. A chain of + on strings\n", \
+	"	is a single jastring_concat, which sums up the lengths and allocates once\n", \
+	"*/\n", \
+	"\n", \
+	"typedef jadynarray jabuilder;\n", \
+	"\n", \
+	"jastring jastring_concat(int64_t count, jastring *parts);\n", \
+	"void jabuilder_append_int(jabuilder *builder, int64_t val);\n", \
+	"void jabuilder_append_uint(jabuilder *builder, uint64_t val);\n", \
+	"jastring jabuilder_finish(jabuilder *builder);\n", \
+	"\n", \
+	"static inline void jabuilder_append(jabuilder *builder, jastring string)\n", \
+	"{\n", \
+	"	jadynarray_append(builder, string.string, string.length, 1);\n", \
+	"}\n", \
+	"\n", \
+	"static inline void jabuilder_push(jabuilder *builder, uint8_t byte)\n", \
+	"{\n", \
+	"	jadynarray_append(builder, &byte, 1, 1);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	maps\n", \
+	"	\n", \
+	"	open addressing in the manner of a Swiss table: each slot has a control\n", \
+	"	byte holding seven bits of the hash or marking it empty or deleted, a\n", \
+	"	lookup matches a whole group of 16 control bytes at once and compares only\n", \
+	"	the keys whose bits match. Keys and values are stored inline, the layout\n", \
+	"	gives their sizes. At least one slot in eight stays empty\n", \
+	"*/\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	int64_t length;\n", \
+	"	int64_t capacity;\n", \
+	"	int64_t growth_left;\n", \
+	"	uint8_t *ctrl;\n", \
+	"	char *entries;\n", \
+	"} jamap;\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	int64_t keysize;\n", \
+	"	int64_t keyalign;\n", \
+	"	int64_t valsize;\n", \
+	"	int64_t valalign;\n", \
+	"	jabool strkey;\n", \
+	"} jamap_layout;\n", \
+	"\n", \
+	"void *jamap_find(jamap *map, jamap_layout *layout, void *key);\n", \
+	"void *jamap_insert(jamap *map, jamap_layout *layout, void *key);\n", \
+	"void jamap_remove(jamap *map, jamap_layout *layout, void *key);\n", \
+	"void jamap_clear(jamap *map);\n", \
+	"\n", \
+	"static inline void *jamap_get(\n", \
+	"	jamap *map, jamap_layout *layout, void *key, void *zero\n", \
+	") {\n", \
+	"	void *val = jamap_find(map, layout, key);\n", \
+	"	return val ? val : zero;\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	default heap\n", \
+	"	\n", \
+	"	new and delete without an allocator call ja_alloc and ja_free; small\n", \
+	"	objects come from per-thread free lists, one for each size class, and\n", \
+	"	larger ones are mapped directly. ja_free is told the size again, so\n", \
+	"	objects carry no header. Compiling with -malloc defines JA_SYSTEM_MALLOC,\n", \
+	"	which maps both onto malloc and free for comparison\n", \
+	"*/\n", \
+	"\n", \
+	"#ifdef JA_SYSTEM_MALLOC\n", \
+	"\n", \
+	"static inline void *ja_alloc(int64_t size)\n", \
+	"{\n", \
+	"	return malloc(size);\n", \
+	"}\n", \
+	"\n", \
+	"static inline void ja_free(void *ptr, int64_t size)\n", \
+	"{\n", \
+	"	free(ptr);\n", \
+	"}\n", \
+	"\n", \
+	"#else\n", \
+	"\n", \
+	"// 16 byte steps up to 256, then powers of two up to 32768\n", \
+	"#define JAHEAP_CLASSES 23\n", \
+	"#define JAHEAP_SMALL_MAX 32768\n", \
+	"#define JAHEAP_CHUNK_SIZE 65536\n", \
+	"\n", \
+	"extern _Thread_local void *jaheap_lists[JAHEAP_CLASSES];\n", \
+	"\n", \
+	"void *jaheap_refill(int sizeclass);\n", \
+	"void *jaheap_map(int64_t size);\n", \
+	"void jaheap_unmap(void *ptr, int64_t size);\n", \
+	"\n", \
+	"static inline int jaheap_class(int64_t size)\n", \
+	"{\n", \
+	"	if(size <= 256)\n", \
+	"		return size > 0 ? (size - 1) >> 4 : 0;\n", \
+	"	\n", \
+	"	return 64 - __builtin_clzll(size - 1) + 7;\n", \
+	"}\n", \
+	"\n", \
+	"static inline void *ja_alloc(int64_t size)\n", \
+	"{\n", \
+	"	if(__builtin_expect(size > JAHEAP_SMALL_MAX, 0))\n", \
+	"		return jaheap_map(size);\n", \
+	"	\n", \
+	"	int sizeclass = jaheap_class(size);\n", \
+	"	void *ptr = jaheap_lists[sizeclass];\n", \
+	"	\n", \
+	"	if(__builtin_expect(ptr == 0, 0))\n", \
+	"		return jaheap_refill(sizeclass);\n", \
+	"	\n", \
+	"	jaheap_lists[sizeclass] = *(void**)ptr;\n", \
+	"	return ptr;\n", \
+	"}\n", \
+	"\n", \
+	"static inline void ja_free(void *ptr, int64_t size)\n", \
+	"{\n", \
+	"	if(ptr == 0) return;\n", \
+	"	\n", \
+	"	if(__builtin_expect(size > JAHEAP_SMALL_MAX, 0)) {\n", \
+	"		jaheap_unmap(ptr, size);\n", \
+	"		return;\n", \
+	"	}\n", \
+	"	\n", \
+	"	int sizeclass = jaheap_class(size);\n", \
+	"	*(void**)ptr = jaheap_lists[sizeclass];\n", \
+	"	jaheap_lists[sizeclass] = ptr;\n", \
+	"}\n", \
+	"\n", \
+	"#endif\n", \
+	"\n", \
+	"/*\n", \
+	"	arenas and pools\n", \
+	"	\n", \
+	"	an arena bumps a cursor through a chain of blocks, deleting it rewinds to\n", \
+	"	the first block in O(1) and keeps the blocks for reuse; a pool hands out\n", \
+	"	objects of one type from an arena of its own and recycles deleted ones\n", \
+	"	through a free list\n", \
+	"*/\n", \
+	"\n", \
+	"#define JAARENA_BLOCK_SIZE 65536\n", \
+	"\n", \
+	"typedef struct jaarena_block {\n", \
+	"	struct jaarena_block *next;\n", \
+	"	int64_t size;\n", \
+	"} jaarena_block;\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	char *cursor;\n", \
+	"	char *end;\n", \
+	"	jaarena_block *first;\n", \
+	"	jaarena_block *current;\n", \
+	"} jaarena;\n", \
+	"\n", \
+	"typedef struct {\n", \
+	"	void *free;\n", \
+	"	jaarena arena;\n", \
+	"} japool;\n", \
+	"\n", \
+	"void *jaarena_alloc_slow(jaarena *arena, int64_t size);\n", \
+	"\n", \
+	"static inline void *jaarena_alloc(jaarena *arena, int64_t size)\n", \
+	"{\n", \
+	"	size = (size + 15) & ~(int64_t)15;\n", \
+	"	\n", \
+	"	if(__builtin_expect(arena->end - arena->cursor < size, 0))\n", \
+	"		return jaarena_alloc_slow(arena, size);\n", \
+	"	\n", \
+	"	void *ptr = arena->cursor;\n", \
+	"	arena->cursor += size;\n", \
+	"	return ptr;\n", \
+	"}\n", \
+	"\n", \
+	"static inline void jaarena_reset(jaarena *arena)\n", \
+	"{\n", \
+	"	if(arena->first) {\n", \
+	"		arena->current = arena->first;\n", \
+	"		arena->cursor = (char*)(arena->first + 1);\n", \
+	"		arena->end = arena->cursor + arena->first->size;\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"static inline void *japool_alloc(japool *pool, int64_t size)\n", \
+	"{\n", \
+	"	void *ptr = pool->free;\n", \
+	"	\n", \
+	"	if(ptr) {\n", \
+	"		pool->free = *(void**)ptr;\n", \
+	"		return ptr;\n", \
+	"	}\n", \
+	"	\n", \
+	"	return jaarena_alloc(&pool->arena, size);\n", \
+	"}\n", \
+	"\n", \
+	"static inline void japool_free(japool *pool, void *ptr)\n", \
+	"{\n", \
+	"	if(ptr) {\n", \
+	"		*(void**)ptr = pool->free;\n", \
+	"		pool->free = ptr;\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"static inline void japool_reset(japool *pool)\n", \
+	"{\n", \
+	"	pool->free = 0;\n", \
+	"	jaarena_reset(&pool->arena);\n", \
+	"}\n", \
+	"\n", \
+	"/*\n", \
+	"	foreign imports\n", \
+	"	\n", \
+	"	each library is opened once per process, however many units import it,\n", \
+	"	foreign functions look up their symbol on the first call\n", \
+	"*/\n", \
+	"\n", \
+	"void *jaforeign_lib(char *filename);\n", \
+	"void *jaforeign_bind(char *filename, char *name);\n", \
+	"\n", \
+	"/*\n", \
+	"	print output buffer\n", \
+	"	\n", \
+	"	print statements append to this buffer, which is written to stdout when it\n", \
+	"	is full, at exit, before foreign functions are called and, when stdout is a\n", \
+	"	terminal, at the end of each printed line\n", \
+	"*/\n", \
+	"\n", \
+	"#define JAPRINT_BUF_SIZE 65536\n", \
+	"\n", \
+	"extern char japrint_buf[JAPRINT_BUF_SIZE];\n", \
+	"extern int64_t japrint_len;\n", \
+	"\n", \
+	"void jaflush();\n", \
+	"void japrint_drain();\n", \
+	"void japrint_raw_slow(char *data, int64_t length);\n", \
+	"void japrint_string(jastring string);\n", \
+	"void japrint_int(int64_t val);\n", \
+	"void japrint_uint(uint64_t val);\n", \
+	"void japrint_bool(jabool val);\n", \
+	"void japrint_ptr(void *ptr);\n", \
+	"void japrint_newline();\n", \
+	"\n", \
+	"static inline void japrint_sync()\n", \
+	"{\n", \
+	"	if(japrint_len) japrint_drain();\n", \
+	"}\n", \
+	"\n", \
+	"static inline void japrint_raw(char *data, int64_t length)\n", \
+	"{\n", \
+	"	if(japrint_len + length <= JAPRINT_BUF_SIZE) {\n", \
+	"		memcpy(japrint_buf + japrint_len, data, length);\n", \
+	"		japrint_len += length;\n", \
+	"	}\n", \
+	"	else {\n", \
+	"		japrint_raw_slow(data, length);\n", \
+	"	}\n", \
+	"}\n", \
+	"\n", \
+	"#endif\n", \
+	0 }
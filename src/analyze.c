@@ -4,20 +4,32 @@
 #include "parse_internal.h"
 
 #include <stdio.h>
+#include <inttypes.h>
 
 static bool repeat_analyze = false;
+static BuildOptions *options;
+static Unit *cur_unit;
+static int64_t checks_emitted;
+static int64_t checks_eliminated;
 
 static void a_block(Block *block);
 static void a_expr(Expr *expr);
 static void a_stmts(Stmt **stmts);
 
-static void make_type_exportable(Type *type)
+void make_type_exportable(Type *type)
 {
-	while(type->kind == PTR || type->kind == ARRAY) {
+	while(
+		type->kind == PTR || type->kind == ARRAY || type->kind == SLICE ||
+		type->kind == DYNARRAY || type->kind == POOL || type->kind == MAP
+	) {
+		if(type->kind == MAP) make_type_exportable(type->keytype);
 		type = type->subtype;
 	}
 	
-	if(type->kind == STRUCT || type->kind == UNION) {
+	if(type->kind == ENUM) {
+		if(!type->decl->imported) type->decl->exported = 1;
+	}
+	else if(type->kind == STRUCT || type->kind == UNION) {
 		Decl *decl = type->decl;
 		
 		if(decl->exported == 0) {
@@ -60,6 +72,29 @@ static Type *a_named_type(Type *type, Token *start, int is_subtype_of_ptr)
 	return decl->type;
 }
 
+static int64_t a_array_length(Token *length_id, Token *start)
+{
+	Token *id = length_id->id;
+	Decl *decl = lookup(id);
+	
+	if(!decl)
+		fatal_at(length_id, "name %t not declared", id);
+	
+	if(decl->kind != VAR || !decl->isconst)
+		fatal_at(length_id, "%t is not a constant", id);
+	
+	if(decl->end > start)
+		fatal_at(length_id, "constant %t not declared yet", id);
+	
+	if(decl->init->kind != INT || !is_integer_type(decl->init->type))
+		fatal_at(length_id, "array length must be an integer");
+	
+	if(decl->init->value <= 0)
+		fatal_at(length_id, "array length must be greater than 0");
+	
+	return decl->init->value;
+}
+
 static Type *a_type(Type *type, Token *start, int is_subtype_of_ptr)
 {
 	switch(type->kind) {
@@ -69,14 +104,35 @@ static Type *a_type(Type *type, Token *start, int is_subtype_of_ptr)
 			type->subtype = a_type(type->subtype, start, 1);
 			break;
 		case ARRAY:
+			if(type->length_id) {
+				type->length = a_array_length(type->length_id, start);
+				type->length_id = 0;
+			}
+			
 			type->itemtype = a_type(type->itemtype, start, 0);
+			break;
+		case DYNARRAY:
+		case POOL:
+			type->itemtype = a_type(type->itemtype, start, 1);
+			break;
+		case MAP:
+			type->keytype = a_type(type->keytype, start, 0);
+			type->itemtype = a_type(type->itemtype, start, 1);
+			
+			if(
+				!is_integer_type(type->keytype) &&
+				type->keytype->kind != STRING && type->keytype->kind != ENUM
+			) {
+				fatal_at(start, "map keys must be integers, strings or enums");
+			}
+			
 			break;
 	}
 	
 	return type;
 }
 
-static void eval_integral_cast(Expr *expr, Type *type)
+void eval_integral_cast(Expr *expr, Type *type)
 {
 	expr->type = type;
 	expr->kind = INT;
@@ -107,7 +163,7 @@ static void eval_integral_cast(Expr *expr, Type *type)
 	}
 }
 
-static void eval_binop(Expr *expr)
+void eval_binop(Expr *expr)
 {
 	Expr *left = expr->left;
 	Expr *right = expr->right;
@@ -133,7 +189,24 @@ static void eval_binop(Expr *expr)
 				break; \
 			}
 		
-		INT_BINOP(PLUS, +)
+		case TK_PLUS:
+			if(expr->type->kind == STRING) {
+				int64_t length = left->length + right->length;
+				char *string = malloc(length + 1);
+				memcpy(string, left->string, left->length);
+				memcpy(string + left->length, right->string, right->length);
+				string[length] = 0;
+				expr->kind = STRING;
+				expr->string = string;
+				expr->length = length;
+			}
+			else if(is_integral_type(expr->type)) {
+				expr->kind = INT;
+				expr->value = left->value + right->value;
+			}
+			
+			break;
+		
 		INT_BINOP(MINUS, -)
 		INT_BINOP(MUL, *)
 		INT_BINOP(DSLASH, /)
@@ -245,6 +318,14 @@ static Expr *adjust_expr_to_type(Expr *expr, Type *type, bool explicit)
 		return new_cast_expr(expr, type);
 	}
 	
+	// so is a growable array, the slice views its current items
+	if(
+		type->kind == SLICE && expr_type->kind == DYNARRAY &&
+		type_equ(expr_type->itemtype, type->itemtype)
+	) {
+		return new_cast_expr(expr, type);
+	}
+	
 	// array literal with matching length
 	if(
 		expr->kind == ARRAY && type->kind == ARRAY &&
@@ -267,6 +348,13 @@ static Expr *adjust_expr_to_type(Expr *expr, Type *type, bool explicit)
 	);
 }
 
+bool is_literal(Expr *expr)
+{
+	return
+		expr->kind == INT || expr->kind == BOOL || expr->kind == STRING ||
+		expr->kind == ENUM;
+}
+
 static void a_var(Expr *expr)
 {
 	Decl *decl = lookup(expr->id);
@@ -291,6 +379,13 @@ static void a_var(Expr *expr)
 	if(decl->kind == VAR && decl->end > expr->start)
 		fatal_at(expr->start, "variable %t not declared yet", expr->id);
 	
+	if(decl->isconst && is_literal(decl->init)) {
+		Token *start = expr->start;
+		*expr = *clone_expr(decl->init);
+		expr->start = start;
+		return;
+	}
+	
 	if(decl->kind == VAR && scope->funchost) {
 		Decl *func = scope->funchost;
 		
@@ -304,7 +399,7 @@ static void a_var(Expr *expr)
 		}
 	}
 	
-	if(decl->kind == FUNC) {
+	if(decl->kind == FUNC && !decl->imported) {
 		if(decl->deps_scanned == 0) {
 			repeat_analyze = true;
 		}
@@ -326,10 +421,90 @@ static void a_var(Expr *expr)
 	expr->type = decl->type;
 }
 
+/*
+	Check if the object lies in a map item. With insert, the map subscripts
+	on the way are marked to add their key when it is missing; reading a
+	missing item yields a zero value and adds nothing
+*/
+static bool is_in_map(Expr *expr, bool insert)
+{
+	bool found = false;
+	
+	while(expr->kind == MEMBER || expr->kind == SUBSCRIPT) {
+		if(expr->kind == MEMBER) {
+			expr = expr->object;
+		}
+		else if(expr->array->type->kind == MAP) {
+			if(insert) expr->inserts = 1;
+			found = true;
+			expr = expr->array;
+		}
+		else if(expr->array->type->kind == ARRAY) {
+			expr = expr->array;
+		}
+		else {
+			break;
+		}
+	}
+	
+	return found;
+}
+
+/*
+	Maps, growable arrays and string builders own a buffer that is freed when
+	they grow. A copy would share it, so they are only passed around by
+	pointer. Returns the name of the first one type holds in place, if any
+*/
+static char *owned_buffer(Type *type)
+{
+	char *name = 0;
+	
+	switch(type->kind) {
+		case MAP:
+			return "map";
+		case DYNARRAY:
+			return "growable array";
+		case BUILDER:
+			return "string builder";
+		case ARRAY:
+			return owned_buffer(type->itemtype);
+		case STRUCT:
+		case UNION:
+			array_for(type->decl->members, i) {
+				name = owned_buffer(type->decl->members[i]->type);
+				if(name) return name;
+			}
+			
+			return 0;
+	}
+	
+	return 0;
+}
+
+static void check_copyable(Expr *expr)
+{
+	char *name = owned_buffer(expr->type);
+	
+	if(name) {
+		fatal_at(
+			expr->start, "can not copy a %s, use a pointer to it instead",
+			name
+		);
+	}
+}
+
 static void a_ptr(Expr *expr)
 {
 	Expr *subexpr = expr->subexpr;
 	a_expr(subexpr);
+	
+	if(is_in_map(subexpr, false)) {
+		fatal_at(
+			expr->start,
+			"can not point into a map, its items move when it grows"
+		);
+	}
+	
 	expr->type->subtype = subexpr->type;
 }
 
@@ -346,10 +521,22 @@ static void a_deref(Expr *expr)
 
 static void a_cast(Expr *expr)
 {
+	expr->type = a_type(expr->type, expr->start, 0);
 	a_expr(expr->subexpr);
 	*expr = *adjust_expr_to_type(expr->subexpr, expr->type, true);
 }
 
+static void a_map_subscript(Expr *expr)
+{
+	Expr *map = expr->array;
+	
+	if(!map->islvalue)
+		fatal_at(map->start, "map must be a variable or member");
+	
+	expr->index = adjust_expr_to_type(expr->index, map->type->keytype, false);
+	expr->type = map->type->itemtype;
+}
+
 static void a_subscript(Expr *expr)
 {
 	Expr *array = expr->array;
@@ -362,11 +549,18 @@ static void a_subscript(Expr *expr)
 		array = expr->array;
 	}
 	
+	if(array->type->kind == MAP) {
+		a_map_subscript(expr);
+		return;
+	}
+	
 	if(
 		array->type->kind != ARRAY && array->type->kind != SLICE &&
-		array->type->kind != STRING
+		array->type->kind != DYNARRAY && array->type->kind != STRING
 	) {
-		fatal_at(array->start, "need array, slice or string to subscript");
+		fatal_at(
+			array->start, "need array, slice, string or map to subscript"
+		);
 	}
 	
 	if(!is_integral_type(index->type))
@@ -384,11 +578,40 @@ static void a_subscript(Expr *expr)
 			);
 	}
 	
+	if(array->kind == STRING && index->isconst) {
+		if(index->value < 0 || index->value >= array->length)
+			fatal_at(
+				index->start,
+				"index is out of range, must be between 0 .. %u",
+				array->length - 1
+			);
+	}
+	
+	if(options->bounds_check) {
+		if(
+			index->isconst && (
+				array->kind == STRING ||
+				array->type->kind == ARRAY && array->type->length >= 0
+			)
+		) {
+			checks_eliminated ++;
+		}
+		else if(
+			array->type->kind != ARRAY || array->type->length >= 0
+		) {
+			expr->needs_check = 1;
+			checks_emitted ++;
+		}
+	}
+	
 	if(array->kind == ARRAY && index->isconst) {
 		*expr = *array->items[index->value];
 	}
 	
-	expr->type = array->type->itemtype;
+	if(array->type->kind == STRING)
+		expr->type = array->type;
+	else
+		expr->type = array->type->itemtype;
 }
 
 static void a_binop(Expr *expr)
@@ -434,6 +657,13 @@ static void a_binop(Expr *expr)
 		expr->type = new_type(BOOL);
 		found_match = true;
 	}
+	else if(
+		ltype->kind == STRING && rtype->kind == STRING &&
+		operator->kind == TK_PLUS
+	) {
+		expr->type = new_type(STRING);
+		found_match = true;
+	}
 	else if(
 		ltype->kind == ENUM && rtype->kind == ENUM && types_equal &&
 		operator->kind == TK_EQUALS
@@ -457,6 +687,14 @@ static void a_binop(Expr *expr)
 		}
 	}
 	
+	if(
+		expr->isconst && is_integral_type(expr->type) &&
+		(operator->kind == TK_DSLASH || operator->kind == TK_MOD) &&
+		expr->right->value == 0
+	) {
+		fatal_at(operator, "division by zero");
+	}
+	
 	if(expr->isconst)
 		eval_binop(expr);
 }
@@ -468,6 +706,7 @@ static void a_array(Expr *expr)
 	
 	array_for(items, i) {
 		a_expr(items[i]);
+		check_copyable(items[i]);
 		
 		if(i == 0) {
 			itemtype = items[i]->type;
@@ -480,10 +719,169 @@ static void a_array(Expr *expr)
 	expr->type->itemtype = itemtype;
 }
 
+static void check_arg_count(Expr *expr, int64_t count)
+{
+	if(array_length(expr->args) < count) {
+		fatal_at(expr->start, "not enough arguments, %i needed", count);
+	}
+	else if(array_length(expr->args) > count) {
+		fatal_at(expr->start, "too many arguments, %i needed", count);
+	}
+}
+
+/*
+	A string builder is a growable array of bytes that appends strings and
+	integers as text and is finished into a string
+*/
+static void a_builder_append(Expr *expr)
+{
+	Expr *arg = expr->args[0];
+	
+	if(arg->type->kind == STRING || arg->type->kind == UINT64)
+		return;
+	
+	if(!is_integer_type(arg->type)) {
+		fatal_at(
+			arg->start, "can not append type  %y  to a string builder",
+			arg->type
+		);
+	}
+	
+	expr->args[0] = adjust_expr_to_type(arg, new_type(INT), false);
+}
+
+static void a_dyncall(Expr *expr)
+{
+	a_expr(expr->array);
+	Expr *array = expr->array;
+	Expr **args = expr->args;
+	bool isbuilder = array->type->kind == BUILDER;
+	Type *itemtype = isbuilder ? new_type(UINT8) : array->type->itemtype;
+	char *name = "growable array";
+	
+	if(isbuilder)
+		name = "string builder";
+	else if(array->type->kind == MAP)
+		name = "map";
+	
+	if(!array->islvalue)
+		fatal_at(array->start, "%s must be a variable or member", name);
+	
+	is_in_map(array, true);
+	
+	check_arg_count(
+		expr, expr->dynop == DYN_POP || expr->dynop == DYN_FINISH ? 0 : 1
+	);
+	
+	array_for(args, i) {
+		a_expr(args[i]);
+	}
+	
+	switch(expr->dynop) {
+		case DYN_PUSH:
+			args[0] = adjust_expr_to_type(args[0], itemtype, false);
+			check_copyable(args[0]);
+			break;
+		case DYN_RESERVE:
+		case DYN_RESIZE:
+			if(!is_integral_type(args[0]->type))
+				fatal_at(args[0]->start, "size is not an integer");
+			
+			args[0] = adjust_expr_to_type(args[0], new_type(INT), false);
+			break;
+		case DYN_APPEND:
+			if(isbuilder) {
+				a_builder_append(expr);
+			}
+			else if(owned_buffer(itemtype)) {
+				fatal_at(
+					args[0]->start,
+					"can not copy a %s, use a pointer to it instead",
+					owned_buffer(itemtype)
+				);
+			}
+			// fixed arrays are copied directly, everything else as a slice
+			else if(
+				args[0]->type->kind != ARRAY ||
+				args[0]->type->length < 0 ||
+				!type_equ(args[0]->type->itemtype, itemtype)
+			) {
+				args[0] = adjust_expr_to_type(
+					args[0], new_slice_type(itemtype), false
+				);
+			}
+			
+			break;
+		case DYN_HAS:
+		case DYN_REMOVE:
+			args[0] = adjust_expr_to_type(
+				args[0], array->type->keytype, false
+			);
+			
+			break;
+	}
+	
+	if(expr->dynop == DYN_POP)
+		expr->type = itemtype;
+	else if(expr->dynop == DYN_FINISH)
+		expr->type = new_type(STRING);
+	else if(expr->dynop == DYN_HAS)
+		expr->type = new_type(BOOL);
+	else
+		expr->type = new_type(NONE);
+}
+
+/*
+	Methods of growable arrays, string builders and maps are called like
+	struct members
+*/
+static bool is_dyncall(Expr *callee, DynOp *dynop)
+{
+	int i = 0;
+	
+	if(callee->kind != MEMBER)
+		return false;
+	
+	while(i < _DYNOP_COUNT && !tokequ_str(callee->member_id, dynop_names[i])) {
+		i++;
+	}
+	
+	if(i == _DYNOP_COUNT)
+		return false;
+	
+	*dynop = i;
+	a_expr(callee->object);
+	
+	while(callee->object->type->kind == PTR) {
+		callee->object = new_deref_expr(callee->object->start, callee->object);
+	}
+	
+	switch(callee->object->type->kind) {
+		case BUILDER:
+			return
+				i == DYN_PUSH || i == DYN_RESERVE || i == DYN_APPEND ||
+				i == DYN_FINISH;
+		case MAP:
+			return i == DYN_HAS || i == DYN_REMOVE;
+		case DYNARRAY:
+			return i <= DYN_APPEND;
+	}
+	
+	return false;
+}
+
 static void a_call(Expr *expr)
 {
 	Expr *callee = expr->callee;
 	Expr **args = expr->args;
+	DynOp dynop = 0;
+	
+	if(is_dyncall(callee, &dynop)) {
+		*expr = *new_dyncall_expr(callee->object, dynop, args);
+		a_dyncall(expr);
+		return;
+	}
+	
 	a_expr(callee);
 	
 	if(callee->type->kind != FUNC)
@@ -491,23 +889,12 @@ static void a_call(Expr *expr)
 	
 	Type *type = callee->type;
 	Type **paramtypes = type->paramtypes;
-	
-	if(array_length(args) < array_length(paramtypes)) {
-		fatal_at(
-			expr->start, "not enough arguments, %i needed",
-			array_length(paramtypes)
-		);
-	}
-	else if(array_length(args) > array_length(paramtypes)) {
-		fatal_at(
-			expr->start, "too many arguments, %i needed",
-			array_length(paramtypes)
-		);
-	}
+	check_arg_count(expr, array_length(paramtypes));
 	
 	array_for(paramtypes, i) {
 		a_expr(args[i]);
 		args[i] = adjust_expr_to_type(args[i], paramtypes[i], false);
+		check_copyable(args[i]);
 	}
 	
 	expr->type = callee->type->returntype;
@@ -527,7 +914,8 @@ static void a_member(Expr *expr)
 	
 	if(
 		(object_type->kind == ARRAY || object_type->kind == SLICE ||
-			object_type->kind == STRING) &&
+			object_type->kind == DYNARRAY || object_type->kind == STRING ||
+			object_type->kind == BUILDER || object_type->kind == MAP) &&
 		tokequ_str(member_id, "length")
 	) {
 		*expr = *new_length_expr(object);
@@ -557,6 +945,49 @@ static void a_member(Expr *expr)
 	}
 }
 
+/*
+	The arena or pool that new or delete use, it is changed in place
+*/
+static Expr *a_allocator(Expr *allocator)
+{
+	a_expr(allocator);
+	
+	while(allocator->type->kind == PTR) {
+		allocator = new_deref_expr(allocator->start, allocator);
+	}
+	
+	if(allocator->type->kind != ARENA && allocator->type->kind != POOL)
+		fatal_at(allocator->start, "expected arena or pool");
+	
+	if(!allocator->islvalue) {
+		fatal_at(
+			allocator->start, "arena or pool must be a variable or member"
+		);
+	}
+	
+	is_in_map(allocator, true);
+	return allocator;
+}
+
+static void a_new(Expr *expr)
+{
+	expr->type = a_type(expr->type, expr->start, 0);
+	
+	if(expr->allocator) {
+		expr->allocator = a_allocator(expr->allocator);
+		Type *type = expr->allocator->type;
+		
+		if(
+			type->kind == POOL &&
+			!type_equ(type->itemtype, expr->type->subtype)
+		) {
+			fatal_at(
+				expr->start, "pool holds objects of type  %y", type->itemtype
+			);
+		}
+	}
+}
+
 static void a_negation(Expr *expr)
 {
 	a_expr(expr->subexpr);
@@ -627,6 +1058,12 @@ static void a_expr(Expr *expr)
 		case COMPLEMENT:
 			a_complement(expr);
 			break;
+		case DYNCALL:
+			a_dyncall(expr);
+			break;
+		case NEW:
+			a_new(expr);
+			break;
 	}
 }
 
@@ -665,6 +1102,15 @@ static void a_vardecl(Decl *decl)
 			decl->type = decl->init->type;
 		else
 			decl->init = adjust_expr_to_type(decl->init, decl->type, false);
+		
+		check_copyable(decl->init);
+		
+		if(decl->isconst && !is_literal(decl->init)) {
+			fatal_at(
+				decl->init->start,
+				"constant must be an integer, bool, enum item or string"
+			);
+		}
 	}
 	
 	decl->type = a_type(decl->type, decl->start, 0);
@@ -680,10 +1126,25 @@ static void a_funcdecl(Decl *decl)
 	array_for(decl->params, i) {
 		Decl *param = decl->params[i];
 		param->type = a_type(param->type, param->start, 0);
+		decl->type->paramtypes[i] = param->type;
+		
+		if(owned_buffer(param->type)) {
+			fatal_at(
+				param->start, "can not pass a %s by value, use a pointer",
+				owned_buffer(param->type)
+			);
+		}
 	}
 	
 	decl->type->returntype = a_type(decl->type->returntype, decl->start, 0);
 	
+	if(owned_buffer(decl->type->returntype)) {
+		fatal_at(
+			decl->start, "can not return a %s by value",
+			owned_buffer(decl->type->returntype)
+		);
+	}
+	
 	if(decl->body)
 		a_block(decl->body);
 	
@@ -728,6 +1189,226 @@ static void a_enumdecl(Decl *decl)
 	}
 }
 
+/*
+	Get the value of an integer expression that is known at compile time,
+	including lengths of fixed size arrays
+*/
+static bool const_int_value(Expr *expr, int64_t *value)
+{
+	int64_t left = 0;
+	int64_t right = 0;
+	
+	switch(expr->kind) {
+		case INT:
+		case BOOL:
+			*value = expr->value;
+			return true;
+		case LENGTH:
+			if(
+				expr->array->type->kind == ARRAY &&
+				expr->array->type->length >= 0
+			) {
+				*value = expr->array->type->length;
+				return true;
+			}
+			
+			return false;
+		case CAST:
+			return
+				is_integral_type(expr->type) &&
+				const_int_value(expr->subexpr, value);
+		case BINOP:
+			if(
+				!const_int_value(expr->left, &left) ||
+				!const_int_value(expr->right, &right)
+			) {
+				return false;
+			}
+			
+			if(expr->operator->kind == TK_PLUS) {
+				*value = left + right;
+				return true;
+			}
+			else if(expr->operator->kind == TK_MINUS) {
+				*value = left - right;
+				return true;
+			}
+			
+			return false;
+	}
+	
+	return false;
+}
+
+/*
+	What a range-for body does to the iterator and to the variable whose
+	length bounds the range
+*/
+typedef struct {
+	Decl *iter;
+	Decl *len_var;
+	int64_t lo;
+	int64_t hi;
+	bool hi_known;
+	bool iter_written;
+	bool len_var_written;
+	bool len_var_addressed;
+	bool has_calls;
+} RangeInfo;
+
+static bool is_var_of(Expr *expr, Decl *decl)
+{
+	return decl && expr->kind == VAR && expr->decl == decl;
+}
+
+static void scan_range_assign(Stmt *stmt, void *ctx)
+{
+	RangeInfo *info = ctx;
+	
+	if(stmt->kind != ASSIGN)
+		return;
+	
+	Expr *target = stmt->as_assign.target;
+	
+	if(is_var_of(target, info->iter))
+		info->iter_written = true;
+	
+	if(info->len_var) {
+		if(is_var_of(target, info->len_var)) {
+			info->len_var_written = true;
+		}
+		else if(
+			target->kind != VAR &&
+			target->type->kind == info->len_var->type->kind
+		) {
+			// might write to the variable through a pointer
+			info->len_var_written = true;
+		}
+	}
+}
+
+static void scan_range_expr(Expr *expr, void *ctx)
+{
+	RangeInfo *info = ctx;
+	
+	if(expr->kind == CALL) {
+		info->has_calls = true;
+	}
+	else if(expr->kind == DYNCALL && info->len_var) {
+		if(
+			is_var_of(expr->array, info->len_var) ||
+			expr->array->kind != VAR &&
+			expr->array->type->kind == info->len_var->type->kind
+		) {
+			info->len_var_written = true;
+		}
+	}
+	else if(expr->kind == PTR) {
+		if(is_var_of(expr->subexpr, info->iter))
+			info->iter_written = true;
+		
+		if(is_var_of(expr->subexpr, info->len_var))
+			info->len_var_addressed = true;
+	}
+}
+
+static void scan_addressed(Expr *expr, void *ctx)
+{
+	RangeInfo *info = ctx;
+	
+	if(expr->kind == PTR && is_var_of(expr->subexpr, info->len_var))
+		info->len_var_addressed = true;
+}
+
+static void elim_range_check(Expr *expr, void *ctx)
+{
+	RangeInfo *info = ctx;
+	
+	if(
+		expr->kind != SUBSCRIPT || !expr->needs_check ||
+		!is_var_of(expr->index, info->iter)
+	) {
+		return;
+	}
+	
+	Expr *array = expr->array;
+	bool in_range = false;
+	
+	if(array->type->kind == ARRAY) {
+		in_range = info->hi_known && info->hi < array->type->length;
+	}
+	else {
+		in_range = is_var_of(array, info->len_var);
+	}
+	
+	if(in_range) {
+		expr->needs_check = 0;
+		checks_emitted --;
+		checks_eliminated ++;
+	}
+}
+
+/*
+	Inside for i = lo .. hi where lo >= 0 and i is never written in the body,
+	subscripts with i need no check when hi is a constant below the length of
+	a fixed array, or when hi is v.length - k (k >= 1) for a variable v that
+	the body does not modify
+*/
+static void elim_range_checks(For *forstmt)
+{
+	RangeInfo info = {0};
+	info.iter = forstmt->iter;
+	
+	if(!const_int_value(forstmt->from, &info.lo) || info.lo < 0)
+		return;
+	
+	Expr *to = forstmt->to;
+	int64_t offset = 0;
+	
+	if(const_int_value(to, &info.hi)) {
+		info.hi_known = true;
+	}
+	else if(
+		to->kind == BINOP && to->operator->kind == TK_MINUS &&
+		to->left->kind == LENGTH && to->left->array->kind == VAR &&
+		const_int_value(to->right, &offset) && offset >= 1
+	) {
+		info.len_var = to->left->array->decl;
+	}
+	else {
+		return;
+	}
+	
+	walk_block(forstmt->body, scan_range_assign, scan_range_expr, &info);
+	
+	if(info.iter_written)
+		return;
+	
+	if(info.len_var && info.has_calls) {
+		Decl *funchost = forstmt->scope->funchost;
+		
+		if(info.len_var->scope->parent == 0) {
+			// globals might be modified by any called function
+			info.len_var_written = true;
+		}
+		else if(funchost) {
+			walk_block(funchost->body, 0, scan_addressed, &info);
+		}
+		else {
+			walk_block(cur_unit->block, 0, scan_addressed, &info);
+		}
+	}
+	
+	if(
+		info.len_var_written ||
+		info.has_calls && info.len_var_addressed
+	) {
+		info.len_var = 0;
+	}
+	
+	walk_block(forstmt->body, 0, elim_range_check, &info);
+}
+
 static void a_for(For *forstmt)
 {
 	a_expr(forstmt->from);
@@ -747,6 +1428,9 @@ static void a_for(For *forstmt)
 	
 	forstmt->iter->type = forstmt->from->type;
 	a_block(forstmt->body);
+	
+	if(options->bounds_check)
+		elim_range_checks(forstmt);
 }
 
 static void a_foreach(ForEach *foreach)
@@ -757,26 +1441,66 @@ static void a_foreach(ForEach *foreach)
 		foreach->array = new_deref_expr(foreach->array->start, foreach->array);
 	}
 	
-	if(foreach->array->type->kind != ARRAY) {
-		fatal_at(foreach->array->start, "expected iterable of type array");
+	Type *type = foreach->array->type;
+	Type *itemtype = type->itemtype;
+	
+	if(type->kind == STRING) {
+		if(foreach->byref) {
+			fatal_at(
+				foreach->iter->start, "can not iterate a string by reference"
+			);
+		}
+		
+		itemtype = type;
+	}
+	else if(
+		type->kind != ARRAY && type->kind != SLICE && type->kind != DYNARRAY
+	) {
+		fatal_at(
+			foreach->array->start,
+			"expected iterable of type array, slice or string"
+		);
 	}
 	
-	foreach->iter->type = foreach->array->type->itemtype;
+	if(foreach->byref) {
+		itemtype = new_ptr_type(itemtype);
+	}
+	else if(owned_buffer(itemtype)) {
+		fatal_at(
+			foreach->iter->start,
+			"can not copy a %s, iterate by reference instead",
+			owned_buffer(itemtype)
+		);
+	}
+	
+	foreach->iter->type = itemtype;
 	a_block(foreach->body);
 }
 
 static void a_assign(Assign *assign)
 {
+	Expr *target = assign->target;
+	
+	if(target->kind == VAR) {
+		Decl *decl = lookup(target->id);
+		
+		if(decl && decl->kind == VAR && decl->isconst)
+			fatal_at(target->start, "can not assign to constant %t", decl->id);
+	}
+	
 	a_expr(assign->target);
 	
 	if(!assign->target->islvalue)
 		fatal_at(assign->target->start, "left side is not assignable");
 	
+	is_in_map(assign->target, true);
 	a_expr(assign->expr);
 	
 	assign->expr = adjust_expr_to_type(
 		assign->expr, assign->target->type, false
 	);
+	
+	check_copyable(assign->expr);
 }
 
 static void a_return(Return *returnstmt)
@@ -787,6 +1511,48 @@ static void a_return(Return *returnstmt)
 		Expr *returnexpr = returnstmt->expr;
 		a_expr(returnexpr);
 		returnstmt->expr = adjust_expr_to_type(returnexpr, returntype, false);
+		check_copyable(returnstmt->expr);
+	}
+}
+
+static void a_delete(Delete *stmt)
+{
+	a_expr(stmt->expr);
+	Type *type = stmt->expr->type;
+	
+	if(stmt->allocator) {
+		stmt->allocator = a_allocator(stmt->allocator);
+		Type *pool_type = stmt->allocator->type;
+		
+		if(pool_type->kind == ARENA) {
+			fatal_at(
+				stmt->allocator->start,
+				"objects of an arena are deleted all at once, delete the arena"
+			);
+		}
+		
+		if(
+			type->kind != PTR ||
+			!type_equ(type->subtype, pool_type->itemtype)
+		) {
+			fatal_at(
+				stmt->expr->start, "pool holds objects of type  %y",
+				pool_type->itemtype
+			);
+		}
+	}
+	else if(type->kind == ARENA || type->kind == POOL || type->kind == MAP) {
+		if(!stmt->expr->islvalue) {
+			fatal_at(
+				stmt->expr->start,
+				"arena, pool or map must be a variable or member"
+			);
+		}
+		
+		is_in_map(stmt->expr, true);
+	}
+	else if(type->kind != PTR) {
+		fatal_at(stmt->expr->start, "expression to delete is not a pointer");
 	}
 }
 
@@ -835,7 +1601,7 @@ static void a_stmt(Stmt *stmt)
 			a_assign(&stmt->as_assign);
 			break;
 		case CALL:
-			a_call(stmt->as_call.call);
+			a_expr(stmt->as_call.call);
 			break;
 		case RETURN:
 			a_return(&stmt->as_return);
@@ -843,6 +1609,9 @@ static void a_stmt(Stmt *stmt)
 		case FOREIGN:
 			a_foreign(&stmt->as_foreign);
 			break;
+		case DELETE:
+			a_delete(&stmt->as_delete);
+			break;
 	}
 }
 
@@ -860,8 +1629,55 @@ static void a_block(Block *block)
 	scope = scope->parent;
 }
 
-void analyze(Unit *unit)
+static void scan_inline_calls(Expr *expr, void *ctx)
+{
+	Expr ***calls = ctx;
+	
+	if(
+		expr->kind == CALL && expr->callee->kind == VAR &&
+		expr->callee->decl->kind == FUNC && expr->callee->decl->isinline &&
+		!expr->callee->decl->imported
+	) {
+		array_push(*calls, expr);
+	}
+}
+
+/*
+	Inline functions that call each other in a cycle can not all be inlined
+*/
+static void check_inline_cycle(Decl *root, Decl *func, Decl ***seen)
 {
+	Expr **calls = 0;
+	walk_block(func->body, 0, scan_inline_calls, &calls);
+	
+	array_for(calls, i) {
+		Decl *callee = calls[i]->callee->decl;
+		bool is_seen = false;
+		
+		if(callee == root) {
+			fatal_at(
+				calls[i]->start, "inline function %t is called recursively",
+				root->id
+			);
+		}
+		
+		array_for(*seen, j) {
+			if((*seen)[j] == callee) is_seen = true;
+		}
+		
+		if(!is_seen) {
+			array_push(*seen, callee);
+			check_inline_cycle(root, callee, seen);
+		}
+	}
+}
+
+void analyze(Unit *unit, BuildOptions *_options)
+{
+	options = _options;
+	cur_unit = unit;
+	checks_emitted = 0;
+	checks_eliminated = 0;
 	src_end = unit->src + unit->src_len;
 	a_block(unit->block);
 	
@@ -872,6 +1688,22 @@ void analyze(Unit *unit)
 		printf(COL_YELLOW "repeat analyze\n" COL_RESET);
 		#endif
 		
-		analyze(unit);
+		analyze(unit, options);
+		return;
+	}
+	
+	array_for(unit->block->stmts, i) {
+		Decl *decl = &unit->block->stmts[i]->as_decl;
+		Decl **seen = 0;
+		
+		if(decl->kind == FUNC && decl->isinline && decl->body)
+			check_inline_cycle(decl, decl, &seen);
+	}
+	
+	if(options->bounds_check) {
+		printf(
+			"%s: %" PRId64 " bounds checks, %" PRId64 " eliminated\n",
+			unit->src_filename, checks_emitted, checks_eliminated
+		);
 	}
 }
@@ -3,6 +3,23 @@
 
 #include "build.h"
 
-void analyze(Unit *unit);
+void analyze(Unit *unit, BuildOptions *options);
+
+/*
+	Export the structures, unions and enums type is built from, so it can
+	appear in the unit header
+*/
+void make_type_exportable(Type *type);
+
+/*
+	Check if expr is an integer, bool, string or enum literal
+*/
+bool is_literal(Expr *expr);
+
+/*
+	Constant folding, expr must be analyzed and its operands literals
+*/
+void eval_integral_cast(Expr *expr, Type *type);
+void eval_binop(Expr *expr);
 
 #endif
@@ -4,6 +4,7 @@
 
 static uint8_t *text;
 static uint64_t text_size;
+static uint64_t text_cap;
 
 void *asm_get_text()
 {
@@ -19,36 +20,354 @@ void asm_start()
 {
 	text = 0;
 	text_size = 0;
+	text_cap = 0;
 }
 
-void *asm_uint8(uint8_t x)
+static uint8_t *asm_grow(uint64_t s)
 {
-	uint64_t s = sizeof(x);
-	text = realloc(text, text_size + x);
+	if(text_size + s > text_cap) {
+		while(text_size + s > text_cap)
+			text_cap = text_cap ? text_cap * 2 : 4096;
+		
+		text = realloc(text, text_cap);
+	}
+	
 	uint8_t *p = text + text_size;
-	memcpy(p, &x, s);
 	text_size += s;
 	return p;
 }
 
+void *asm_uint8(uint8_t x)
+{
+	uint8_t *p = asm_grow(sizeof(x));
+	memcpy(p, &x, sizeof(x));
+	return p;
+}
+
 void *asm_uint32(uint32_t x)
 {
-	uint64_t s = sizeof(x);
-	text = realloc(text, text_size + x);
-	uint8_t *p = text + text_size;
-	memcpy(p, &x, s);
-	text_size += s;
+	uint8_t *p = asm_grow(sizeof(x));
+	memcpy(p, &x, sizeof(x));
 	return p;
 }
 
+void *asm_uint64(uint64_t x)
+{
+	uint8_t *p = asm_grow(sizeof(x));
+	memcpy(p, &x, sizeof(x));
+	return p;
+}
+
+void asm_patch_uint32(uint64_t pos, uint32_t x)
+{
+	memcpy(text + pos, &x, sizeof(x));
+}
+
+/*
+	Point the rel32 operand at pos to target, both are text offsets
+*/
+void asm_patch_rel32(uint64_t pos, uint64_t target)
+{
+	asm_patch_uint32(pos, target - (pos + 4));
+}
+
+/*
+	REX prefix, needed for 64 bit operands, registers r8 and up and the low
+	bytes of rsp, rbp, rsi and rdi
+*/
+static void asm_rex(int w, Register reg, Register rm, int force)
+{
+	uint8_t rex = 0x40 | w << 3 | (reg >> 3) << 2 | rm >> 3;
+	if(rex != 0x40 || force) asm_uint8(rex);
+}
+
+static void asm_modrm_reg(Register reg, Register rm)
+{
+	asm_uint8(0xc0 | (reg & 7) << 3 | (rm & 7));
+}
+
+// [base + disp32]
+static void asm_modrm_mem(Register reg, Register base, int32_t disp)
+{
+	asm_uint8(0x80 | (reg & 7) << 3 | (base & 7));
+	if((base & 7) == RSP) asm_uint8(0x24);
+	asm_uint32(disp);
+}
+
 void asm_syscall()
 {
 	asm_uint8(0x0f);
 	asm_uint8(0x05);
 }
 
-void asm_mov_r32_i32(uint8_t r, uint32_t i)
+/*
+	Returns the text offset of the immediate, so absolute addresses can be
+	patched in once they are known
+*/
+uint64_t asm_mov_r32_i32(uint8_t r, uint32_t i)
 {
-	asm_uint8(0xb8 + r);
+	asm_rex(0, 0, r, 0);
+	asm_uint8(0xb8 + (r & 7));
+	uint64_t pos = text_size;
 	asm_uint32(i);
+	return pos;
+}
+
+void asm_mov_r64_i64(Register r, int64_t i)
+{
+	if(i == (int32_t)i) {
+		asm_rex(1, 0, r, 0);
+		asm_uint8(0xc7);
+		asm_modrm_reg(0, r);
+		asm_uint32(i);
+	}
+	else {
+		asm_rex(1, 0, r, 0);
+		asm_uint8(0xb8 + (r & 7));
+		asm_uint64(i);
+	}
+}
+
+void asm_mov_r64_r64(Register dst, Register src)
+{
+	asm_rex(1, src, dst, 0);
+	asm_uint8(0x89);
+	asm_modrm_reg(src, dst);
+}
+
+/*
+	Load size bytes into a full register, sign or zero extended
+*/
+void asm_load(Register dst, Register base, int32_t disp, int size, bool sign)
+{
+	if(size == 8) {
+		asm_rex(1, dst, base, 0);
+		asm_uint8(0x8b);
+	}
+	else if(size == 4 && sign) {
+		asm_rex(1, dst, base, 0);
+		asm_uint8(0x63);
+	}
+	else if(size == 4) {
+		// 32 bit moves clear the upper half
+		asm_rex(0, dst, base, 0);
+		asm_uint8(0x8b);
+	}
+	else {
+		asm_rex(1, dst, base, 0);
+		asm_uint8(0x0f);
+		
+		if(size == 2)
+			asm_uint8(sign ? 0xbf : 0xb7);
+		else
+			asm_uint8(sign ? 0xbe : 0xb6);
+	}
+	
+	asm_modrm_mem(dst, base, disp);
+}
+
+void asm_store(Register base, int32_t disp, Register src, int size)
+{
+	if(size == 2) asm_uint8(0x66);
+	asm_rex(size == 8, src, base, size == 1 && src >= RSP);
+	asm_uint8(size == 1 ? 0x88 : 0x89);
+	asm_modrm_mem(src, base, disp);
+}
+
+void asm_lea(Register dst, Register base, int32_t disp)
+{
+	asm_rex(1, dst, base, 0);
+	asm_uint8(0x8d);
+	asm_modrm_mem(dst, base, disp);
+}
+
+/*
+	Extend the low size bytes of r to the full register
+*/
+void asm_extend(Register r, int size, bool sign)
+{
+	if(size == 8) {
+		return;
+	}
+	else if(size == 4 && sign) {
+		asm_rex(1, r, r, 0);
+		asm_uint8(0x63);
+	}
+	else if(size == 4) {
+		asm_rex(0, r, r, 0);
+		asm_uint8(0x8b);
+	}
+	else {
+		asm_rex(1, r, r, 0);
+		asm_uint8(0x0f);
+		
+		if(size == 2)
+			asm_uint8(sign ? 0xbf : 0xb7);
+		else
+			asm_uint8(sign ? 0xbe : 0xb6);
+	}
+	
+	asm_modrm_reg(r, r);
+}
+
+void asm_alu_r64_r64(AluOp op, Register dst, Register src)
+{
+	asm_rex(1, src, dst, 0);
+	asm_uint8(op << 3 | 0x01);
+	asm_modrm_reg(src, dst);
+}
+
+void asm_alu_r64_i32(AluOp op, Register r, int32_t i)
+{
+	asm_rex(1, 0, r, 0);
+	asm_uint8(0x81);
+	asm_modrm_reg(op, r);
+	asm_uint32(i);
+}
+
+void asm_test_r64_r64(Register a, Register b)
+{
+	asm_rex(1, b, a, 0);
+	asm_uint8(0x85);
+	asm_modrm_reg(b, a);
+}
+
+void asm_imul_r64_r64(Register dst, Register src)
+{
+	asm_rex(1, dst, src, 0);
+	asm_uint8(0x0f);
+	asm_uint8(0xaf);
+	asm_modrm_reg(dst, src);
+}
+
+// sign extend rax into rdx
+void asm_cqo()
+{
+	asm_uint8(0x48);
+	asm_uint8(0x99);
+}
+
+// the 0xf7 group
+static void asm_unary_r64(int digit, Register r)
+{
+	asm_rex(1, 0, r, 0);
+	asm_uint8(0xf7);
+	asm_modrm_reg(digit, r);
+}
+
+void asm_idiv_r64(Register r)
+{
+	asm_unary_r64(7, r);
+}
+
+void asm_div_r64(Register r)
+{
+	asm_unary_r64(6, r);
+}
+
+void asm_neg_r64(Register r)
+{
+	asm_unary_r64(3, r);
+}
+
+void asm_not_r64(Register r)
+{
+	asm_unary_r64(2, r);
+}
+
+/*
+	Set r to 0 or 1, the upper bytes are cleared as well
+*/
+void asm_setcc(Cond cc, Register r)
+{
+	asm_rex(0, 0, r, r >= RSP);
+	asm_uint8(0x0f);
+	asm_uint8(0x90 + cc);
+	asm_modrm_reg(0, r);
+	asm_extend(r, 1, false);
+}
+
+void asm_push(Register r)
+{
+	asm_rex(0, 0, r, 0);
+	asm_uint8(0x50 + (r & 7));
+}
+
+void asm_pop(Register r)
+{
+	asm_rex(0, 0, r, 0);
+	asm_uint8(0x58 + (r & 7));
+}
+
+/*
+	Jumps and calls return the text offset of their rel32 operand, to be
+	patched with asm_patch_rel32 once the target is known
+*/
+uint64_t asm_jmp()
+{
+	asm_uint8(0xe9);
+	uint64_t pos = text_size;
+	asm_uint32(0);
+	return pos;
+}
+
+uint64_t asm_jcc(Cond cc)
+{
+	asm_uint8(0x0f);
+	asm_uint8(0x80 + cc);
+	uint64_t pos = text_size;
+	asm_uint32(0);
+	return pos;
+}
+
+uint64_t asm_call()
+{
+	asm_uint8(0xe8);
+	uint64_t pos = text_size;
+	asm_uint32(0);
+	return pos;
+}
+
+// call the address in r
+void asm_call_r64(Register r)
+{
+	asm_rex(0, 0, r, 0);
+	asm_uint8(0xff);
+	asm_modrm_reg(2, r);
+}
+
+void asm_jmp_to(uint64_t target)
+{
+	asm_patch_rel32(asm_jmp(), target);
+}
+
+void asm_jcc_to(Cond cc, uint64_t target)
+{
+	asm_patch_rel32(asm_jcc(cc), target);
+}
+
+void asm_ret()
+{
+	asm_uint8(0xc3);
+}
+
+// copy rcx bytes from rsi to rdi
+void asm_rep_movsb()
+{
+	asm_uint8(0xf3);
+	asm_uint8(0xa4);
+}
+
+// fill rcx bytes at rdi with al
+void asm_rep_stosb()
+{
+	asm_uint8(0xf3);
+	asm_uint8(0xaa);
+}
+
+// compare rcx bytes at rsi and rdi, stops at the first difference
+void asm_repe_cmpsb()
+{
+	asm_uint8(0xf3);
+	asm_uint8(0xa6);
 }
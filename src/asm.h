@@ -2,18 +2,67 @@
 #define ASM_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
 	EAX = 0, EBX = 3, ECX = 1, EDX = 2,
 	ESI = 6, EDI = 7, EBP = 5, ESP = 4,
+	
+	RAX = 0, RCX = 1, RDX = 2, RBX = 3,
+	RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+	R8 = 8, R9 = 9, R10 = 10, R11 = 11,
 } Register;
 
+// condition codes of jcc and setcc
+typedef enum {
+	CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5,
+	CC_BE = 0x6, CC_A = 0x7, CC_S = 0x8, CC_NS = 0x9,
+	CC_L = 0xc, CC_GE = 0xd, CC_LE = 0xe, CC_G = 0xf,
+} Cond;
+
+// the /digit of the 0x81 group and the 0x01 + 8 * digit register forms
+typedef enum {
+	ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6,
+	ALU_CMP = 7,
+} AluOp;
+
 void *asm_get_text();
 uint64_t asm_get_text_size();
 void asm_start();
 void *asm_uint8(uint8_t x);
 void *asm_uint32(uint32_t x);
+void *asm_uint64(uint64_t x);
+void asm_patch_uint32(uint64_t pos, uint32_t x);
+void asm_patch_rel32(uint64_t pos, uint64_t target);
 void asm_syscall();
-void asm_mov_r32_i32(uint8_t r, uint32_t i);
+uint64_t asm_mov_r32_i32(uint8_t r, uint32_t i);
+void asm_mov_r64_i64(Register r, int64_t i);
+void asm_mov_r64_r64(Register dst, Register src);
+void asm_load(Register dst, Register base, int32_t disp, int size, bool sign);
+void asm_store(Register base, int32_t disp, Register src, int size);
+void asm_lea(Register dst, Register base, int32_t disp);
+void asm_extend(Register r, int size, bool sign);
+void asm_alu_r64_r64(AluOp op, Register dst, Register src);
+void asm_alu_r64_i32(AluOp op, Register r, int32_t i);
+void asm_test_r64_r64(Register a, Register b);
+void asm_imul_r64_r64(Register dst, Register src);
+void asm_cqo();
+void asm_idiv_r64(Register r);
+void asm_div_r64(Register r);
+void asm_neg_r64(Register r);
+void asm_not_r64(Register r);
+void asm_setcc(Cond cc, Register r);
+void asm_push(Register r);
+void asm_pop(Register r);
+uint64_t asm_jmp();
+uint64_t asm_jcc(Cond cc);
+uint64_t asm_call();
+void asm_call_r64(Register r);
+void asm_jmp_to(uint64_t target);
+void asm_jcc_to(Cond cc, uint64_t target);
+void asm_ret();
+void asm_rep_movsb();
+void asm_rep_stosb();
+void asm_repe_cmpsb();
 
 #endif
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <assert.h>
+#include <inttypes.h>
 #include "ast.h"
 #include "array.h"
 #include "string.h"
@@ -15,6 +16,8 @@ Type *new_type(Kind kind)
 		if(primtypebuf[kind] == 0) {
 			Type *type = malloc(sizeof(Type));
 			type->kind = kind;
+			type->length_id = 0;
+			type->cgen_pass = 0;
 			primtypebuf[kind] = type;
 		}
 		
@@ -23,6 +26,8 @@ Type *new_type(Kind kind)
 	
 	Type *type = malloc(sizeof(Type));
 	type->kind = kind;
+	type->length_id = 0;
+	type->cgen_pass = 0;
 	return type;
 }
 
@@ -97,6 +102,28 @@ Type *new_slice_type(Type *itemtype)
 	return type;
 }
 
+Type *new_dynarray_type(Type *itemtype)
+{
+	Type *type = new_type(DYNARRAY);
+	type->itemtype = itemtype;
+	return type;
+}
+
+Type *new_pool_type(Type *itemtype)
+{
+	Type *type = new_type(POOL);
+	type->itemtype = itemtype;
+	return type;
+}
+
+Type *new_map_type(Type *keytype, Type *itemtype)
+{
+	Type *type = new_type(MAP);
+	type->keytype = keytype;
+	type->itemtype = itemtype;
+	return type;
+}
+
 Type *new_func_type(Type *returntype, Type **paramtypes)
 {
 	Type *type = new_type(FUNC);
@@ -145,6 +172,20 @@ int type_equ(Type *left, Type *right)
 			type_equ(left->itemtype, right->itemtype);
 	}
 	
+	if(left->kind == POOL && right->kind == POOL) {
+		return type_equ(left->itemtype, right->itemtype);
+	}
+	
+	if(left->kind == DYNARRAY && right->kind == DYNARRAY) {
+		return type_equ(left->itemtype, right->itemtype);
+	}
+	
+	if(left->kind == MAP && right->kind == MAP) {
+		return
+			type_equ(left->keytype, right->keytype) &&
+			type_equ(left->itemtype, right->itemtype);
+	}
+	
 	if(left->kind == FUNC && right->kind == FUNC) {
 		Type **lparamtypes = left->paramtypes;
 		Type **rparamtypes = right->paramtypes;
@@ -195,6 +236,11 @@ bool is_array_ptr_type(Type *type)
 	return type->kind == PTR && type->subtype->kind == ARRAY;
 }
 
+char *dynop_names[_DYNOP_COUNT] = {
+	"push", "pop", "reserve", "resize", "append", "finish", "has",
+	"remove"
+};
+
 Expr *new_expr(Kind kind, Token *start, Type *type, int isconst, int islvalue)
 {
 	Expr *expr = malloc(sizeof(Expr));
@@ -203,6 +249,8 @@ Expr *new_expr(Kind kind, Token *start, Type *type, int isconst, int islvalue)
 	expr->type = type;
 	expr->isconst = isconst;
 	expr->islvalue = islvalue;
+	expr->needs_check = 0;
+	expr->inserts = 0;
 	return expr;
 }
 
@@ -340,6 +388,15 @@ Expr *new_call_expr(Expr *callee, Expr **args)
 	return call;
 }
 
+Expr *new_dyncall_expr(Expr *array, DynOp dynop, Expr **args)
+{
+	Expr *expr = new_expr(DYNCALL, array->start, 0, 0, 0);
+	expr->array = array;
+	expr->args = args;
+	expr->dynop = dynop;
+	return expr;
+}
+
 Expr *new_binop_expr(Expr *left, Expr *right, Token *operator, OpLevel oplevel)
 {
 	Expr *expr = new_expr(
@@ -353,10 +410,12 @@ Expr *new_binop_expr(Expr *left, Expr *right, Token *operator, OpLevel oplevel)
 	return expr;
 }
 
-Expr *new_new_expr(Token *start, Type *obj_type)
+Expr *new_new_expr(Token *start, Type *obj_type, Expr *allocator)
 {
 	Type *type = new_ptr_type(obj_type);
-	return new_expr(NEW, start, type, 0, 0);
+	Expr *expr = new_expr(NEW, start, type, 0, 0);
+	expr->allocator = allocator;
+	return expr;
 }
 
 Expr *new_enum_item_expr(Token *start, Decl *enumdecl, EnumItem *item)
@@ -368,6 +427,71 @@ Expr *new_enum_item_expr(Token *start, Decl *enumdecl, EnumItem *item)
 	return expr;
 }
 
+/*
+	Deep copy of an analyzed expression tree; decls and types are shared
+*/
+Expr *clone_expr(Expr *expr)
+{
+	if(!expr) return 0;
+	
+	Expr *copy = malloc(sizeof(Expr));
+	*copy = *expr;
+	
+	switch(expr->kind) {
+		case PTR:
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			copy->subexpr = clone_expr(expr->subexpr);
+			break;
+		case DEREF:
+			copy->ptr = clone_expr(expr->ptr);
+			break;
+		case SUBSCRIPT:
+			copy->array = clone_expr(expr->array);
+			copy->index = clone_expr(expr->index);
+			break;
+		case LENGTH:
+			copy->array = clone_expr(expr->array);
+			break;
+		case BINOP:
+			copy->left = clone_expr(expr->left);
+			copy->right = clone_expr(expr->right);
+			break;
+		case ARRAY:
+			copy->items = 0;
+			
+			array_for(expr->items, i) {
+				array_push(copy->items, clone_expr(expr->items[i]));
+			}
+			break;
+		case CALL:
+			copy->callee = clone_expr(expr->callee);
+			copy->args = 0;
+			
+			array_for(expr->args, i) {
+				array_push(copy->args, clone_expr(expr->args[i]));
+			}
+			break;
+		case MEMBER:
+			copy->object = clone_expr(expr->object);
+			break;
+		case NEW:
+			copy->allocator = clone_expr(expr->allocator);
+			break;
+		case DYNCALL:
+			copy->array = clone_expr(expr->array);
+			copy->args = 0;
+			
+			array_for(expr->args, i) {
+				array_push(copy->args, clone_expr(expr->args[i]));
+			}
+			break;
+	}
+	
+	return copy;
+}
+
 #include <stdio.h>
 
 Decl *new_decl(
@@ -379,7 +503,7 @@ Decl *new_decl(
 	
 	char *public_id = string_concat("_", scope->unit_id, "_", 0);
 	string_append_token(public_id, id);
-		
+	
 	Decl *decl = &new_stmt(kind, start, scope)->as_decl;
 	decl->id = id;
 	decl->private_id = private_id;
@@ -390,6 +514,18 @@ Decl *new_decl(
 	decl->isproto = 0;
 	decl->cfunc = 0;
 	decl->deps_scanned = 0;
+	decl->isconst = 0;
+	decl->isinline = 0;
+	decl->inheader = 0;
+	decl->header_visible = 0;
+	decl->reachable = 0;
+	decl->ispure = 0;
+	decl->readsnone = 0;
+	decl->noreturn = 0;
+	decl->byref = 0;
+	decl->in_place = 0;
+	decl->onstack = 0;
+	decl->offset = 0;
 	decl->type = type;
 	return decl;
 }
@@ -450,6 +586,25 @@ Decl *new_union(
 	return decl;
 }
 
+/*
+	Create a compiler generated local variable named tmpN, which can not
+	collide with user identifiers
+*/
+Decl *new_temp_var(Scope *scope, Type *type, Expr *init)
+{
+	static int64_t counter = 0;
+	char buf[256] = {0};
+	int64_t len = sprintf(buf, "tmp%" PRId64, counter);
+	counter++;
+	char *start = malloc(len + 1);
+	strcpy(start, buf);
+	Token *id = create_id(start, len);
+	Decl *decl = new_var(id, scope, id, 0, 0, type, init);
+	decl->private_id = 0;
+	string_append_token(decl->private_id, id);
+	return decl;
+}
+
 Decl *clone_decl(Decl *decl)
 {
 	Decl *new_decl = malloc(sizeof(Decl));
@@ -457,6 +612,16 @@ Decl *clone_decl(Decl *decl)
 	return new_decl;
 }
 
+Decl *original_decl(Decl *decl)
+{
+	Decl *original = 0;
+	
+	if(decl->imported && !decl->cfunc)
+		original = lookup_flat_in(decl->id, decl->scope);
+	
+	return original ? original : decl;
+}
+
 Stmt *new_stmt(Kind kind, Token *start, Scope *scope)
 {
 	Stmt *stmt = malloc(sizeof(Stmt));
@@ -475,11 +640,13 @@ Import *new_import(Token *start, Scope *scope, Unit *unit, Decl **decls)
 	return import;
 }
 
-Foreign *new_foreign(Token *start, Scope *scope, char *name, Decl **decls)
-{
+Foreign *new_foreign(
+	Token *start, Scope *scope, char *name, Decl **decls, int isstatic
+) {
 	Foreign *import = &new_stmt(FOREIGN, start, scope)->as_foreign;
 	import->filename = name;
 	import->decls = decls;
+	import->isstatic = isstatic;
 	return import;
 }
 
@@ -497,6 +664,8 @@ While *new_while(Token *start, Scope *scope, Expr *cond, Block *body)
 	While *whilestmt = &new_stmt(WHILE, start, scope)->as_while;
 	whilestmt->cond = cond;
 	whilestmt->body = body;
+	whilestmt->invariants = 0;
+	whilestmt->entry_cond = 0;
 	return whilestmt;
 }
 
@@ -505,6 +674,7 @@ Assign *new_assign(Scope *scope, Expr *target, Expr *expr)
 	Assign *assign = &new_stmt(ASSIGN, target->start, scope)->as_assign;
 	assign->target = target;
 	assign->expr = expr;
+	assign->in_place = false;
 	return assign;
 }
 
@@ -530,10 +700,12 @@ Return *new_return(Token *start, Scope *scope, Expr *expr)
 	return returnstmt;
 }
 
-Delete *new_delete(Token *start, Scope *scope, Expr *expr)
-{
+Delete *new_delete(
+	Token *start, Scope *scope, Expr *expr, Expr *allocator
+) {
 	Delete *stmt = &new_stmt(DELETE, start, scope)->as_delete;
 	stmt->expr = expr;
+	stmt->allocator = allocator;
 	return stmt;
 }
 
@@ -545,16 +717,20 @@ For *new_for(
 	stmt->from = from;
 	stmt->to = to;
 	stmt->body = body;
+	stmt->invariants = 0;
 	return stmt;
 }
 
 ForEach *new_foreach(
-	Token *start, Scope *scope, Expr *array, Decl *iter, Block *body
+	Token *start, Scope *scope, Expr *array, Decl *iter, bool byref,
+	Block *body
 ) {
 	ForEach *stmt = &new_stmt(FOREACH, start, scope)->as_foreach;
 	stmt->array = array;
 	stmt->iter = iter;
 	stmt->body = body;
+	stmt->byref = byref;
+	stmt->invariants = 0;
 	return stmt;
 }
 
@@ -642,3 +818,126 @@ Block *new_block(Stmt **stmts, Scope *scope)
 	block->scope = scope;
 	return block;
 }
+
+void walk_expr(Expr *expr, ExprVisitor ev, void *ctx)
+{
+	if(!expr) return;
+	if(ev) ev(expr, ctx);
+	
+	switch(expr->kind) {
+		case PTR:
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			walk_expr(expr->subexpr, ev, ctx);
+			break;
+		case DEREF:
+			walk_expr(expr->ptr, ev, ctx);
+			break;
+		case SUBSCRIPT:
+			walk_expr(expr->array, ev, ctx);
+			walk_expr(expr->index, ev, ctx);
+			break;
+		case LENGTH:
+			walk_expr(expr->array, ev, ctx);
+			break;
+		case BINOP:
+			walk_expr(expr->left, ev, ctx);
+			walk_expr(expr->right, ev, ctx);
+			break;
+		case ARRAY:
+			array_for(expr->items, i) {
+				walk_expr(expr->items[i], ev, ctx);
+			}
+			break;
+		case CALL:
+			walk_expr(expr->callee, ev, ctx);
+			
+			array_for(expr->args, i) {
+				walk_expr(expr->args[i], ev, ctx);
+			}
+			break;
+		case MEMBER:
+			walk_expr(expr->object, ev, ctx);
+			break;
+		case NEW:
+			walk_expr(expr->allocator, ev, ctx);
+			break;
+		case DYNCALL:
+			walk_expr(expr->array, ev, ctx);
+			
+			array_for(expr->args, i) {
+				walk_expr(expr->args[i], ev, ctx);
+			}
+			break;
+	}
+}
+
+static void walk_invariants(Decl **invariants, ExprVisitor ev, void *ctx)
+{
+	array_for(invariants, i) {
+		walk_expr(invariants[i]->init, ev, ctx);
+	}
+}
+
+static void walk_stmt(Stmt *stmt, StmtVisitor sv, ExprVisitor ev, void *ctx)
+{
+	if(sv) sv(stmt, ctx);
+	
+	switch(stmt->kind) {
+		case PRINT:
+			walk_expr(stmt->as_print.expr, ev, ctx);
+			break;
+		case VAR:
+			walk_expr(stmt->as_decl.init, ev, ctx);
+			break;
+		case IF:
+			walk_expr(stmt->as_if.cond, ev, ctx);
+			walk_block(stmt->as_if.if_body, sv, ev, ctx);
+			walk_block(stmt->as_if.else_body, sv, ev, ctx);
+			break;
+		case WHILE:
+			walk_expr(stmt->as_while.entry_cond, ev, ctx);
+			walk_invariants(stmt->as_while.invariants, ev, ctx);
+			walk_expr(stmt->as_while.cond, ev, ctx);
+			walk_block(stmt->as_while.body, sv, ev, ctx);
+			break;
+		case ASSIGN:
+			walk_expr(stmt->as_assign.target, ev, ctx);
+			walk_expr(stmt->as_assign.expr, ev, ctx);
+			break;
+		case CALL:
+			walk_expr(stmt->as_call.call, ev, ctx);
+			break;
+		case RETURN:
+			walk_expr(stmt->as_return.expr, ev, ctx);
+			break;
+		case FOR:
+			walk_expr(stmt->as_for.from, ev, ctx);
+			walk_expr(stmt->as_for.to, ev, ctx);
+			walk_invariants(stmt->as_for.invariants, ev, ctx);
+			walk_block(stmt->as_for.body, sv, ev, ctx);
+			break;
+		case FOREACH:
+			walk_expr(stmt->as_foreach.array, ev, ctx);
+			walk_invariants(stmt->as_foreach.invariants, ev, ctx);
+			walk_block(stmt->as_foreach.body, sv, ev, ctx);
+			break;
+		case DELETE:
+			walk_expr(stmt->as_delete.expr, ev, ctx);
+			walk_expr(stmt->as_delete.allocator, ev, ctx);
+			break;
+	}
+}
+
+void walk_stmts(Stmt **stmts, StmtVisitor sv, ExprVisitor ev, void *ctx)
+{
+	array_for(stmts, i) {
+		walk_stmt(stmts[i], sv, ev, ctx);
+	}
+}
+
+void walk_block(Block *block, StmtVisitor sv, ExprVisitor ev, void *ctx)
+{
+	if(block) walk_stmts(block->stmts, sv, ev, ctx);
+}
@@ -55,6 +55,11 @@ typedef enum {
 	PTR,
 	ARRAY,
 	SLICE,
+	DYNARRAY,
+	ARENA,
+	POOL,
+	BUILDER,
+	MAP,
 	FUNC,
 	STRUCT,
 	ENUM,
@@ -73,6 +78,7 @@ typedef enum {
 	NEW,
 	NEGATION,
 	COMPLEMENT,
+	DYNCALL,
 	
 	// statements
 	PRINT,
@@ -95,6 +101,11 @@ typedef enum {
 	* primitive type
 	* ptr
 	* array
+	* slice
+	* growable array
+	* arena, pool
+	* string builder
+	* map
 	* func
 	* struct
 	* enum
@@ -106,7 +117,7 @@ struct Type {
 	
 	union {
 		Type *subtype; // ptr target type
-		Type *itemtype; // array/slice item type
+		Type *itemtype; // array/slice/dynarray/pool item type, map value type
 		Type *returntype; // func return type
 		Token *id; // named type
 	};
@@ -115,13 +126,24 @@ struct Type {
 		int64_t length; // array length
 		Decl *decl; // struct, enum, union
 		Type **paramtypes; // func
+		Type *keytype; // map
 	};
+	
+	Token *length_id; // array length named by a constant (before analyze)
+	
+	// memoized C spelling, valid for the cgen pass cgen_pass
+	int64_t cgen_pass;
+	char *c_prefix;
+	char *c_postfix;
 };
 
 Type *new_type(Kind kind);
 Type *new_ptr_type(Type *subtype);
 Type *new_array_type(int64_t length, Type *itemtype);
 Type *new_slice_type(Type *itemtype);
+Type *new_dynarray_type(Type *itemtype);
+Type *new_pool_type(Type *itemtype);
+Type *new_map_type(Type *keytype, Type *itemtype);
 Type *new_func_type(Type *returntype, Type **paramtypes);
 Type *new_struct_type(Decl *decl);
 Type *new_enum_type(Decl *decl);
@@ -149,12 +171,30 @@ typedef enum {
 	_OPLEVEL_COUNT,
 } OpLevel;
 
+// methods of growable arrays, string builders and maps
+typedef enum {
+	DYN_PUSH,
+	DYN_POP,
+	DYN_RESERVE,
+	DYN_RESIZE,
+	DYN_APPEND,
+	DYN_FINISH,
+	DYN_HAS,
+	DYN_REMOVE,
+	
+	_DYNOP_COUNT,
+} DynOp;
+
+extern char *dynop_names[_DYNOP_COUNT];
+
 struct Expr {
 	Kind kind;
 	Token *start;
 	Type *type;
-	int isconst : 1;
+	unsigned isconst : 1;
 	int islvalue : 1;
+	unsigned needs_check : 1; // subscript: emit a runtime bounds check
+	unsigned inserts : 1; // map subscript: add the key when it is missing
 	
 	union {
 		int64_t value; // int, bool
@@ -163,10 +203,11 @@ struct Expr {
 		Decl *member; // member
 		Expr *subexpr; // ptr, cast, negation
 		Expr *ptr; // deref
-		Expr *array; // subscript, length
+		Expr *array; // subscript, length, dyncall
 		Expr *callee; // call
 		Expr *left; // binop
 		Expr **items; // array
+		Expr *allocator; // new (0 for malloc)
 	};
 	
 	union {
@@ -175,13 +216,14 @@ struct Expr {
 		Expr *right; // binop
 		Expr *index; // subscript
 		Expr *object; // member
-		Expr **args; // call
+		Expr **args; // call, dyncall
 		EnumItem *item; // enum
 	};
 	
 	union {
 		Token *operator; // binop
 		Token *member_id; // member (before analyze)
+		DynOp dynop; // dyncall
 	};
 	
 	OpLevel oplevel; // binop
@@ -201,9 +243,11 @@ Expr *new_member_expr(Expr *object, Token *member_id);
 Expr *new_deref_expr(Token *start, Expr *ptr);
 Expr *new_ptr_expr(Token *start, Expr *subexpr);
 Expr *new_call_expr(Expr *callee, Expr **args);
+Expr *new_dyncall_expr(Expr *array, DynOp dynop, Expr **args);
 Expr *new_binop_expr(Expr *left, Expr *right, Token *operator, OpLevel oplevel);
-Expr *new_new_expr(Token *start, Type *obj_type);
+Expr *new_new_expr(Token *start, Type *obj_type, Expr *allocator);
 Expr *new_enum_item_expr(Token *start, Decl *enumdecl, EnumItem *item);
+Expr *clone_expr(Expr *expr);
 
 /*
 	Statment Head
@@ -238,6 +282,18 @@ struct Decl {
 	uint8_t isproto;
 	uint8_t cfunc;
 	uint8_t deps_scanned;
+	uint8_t isconst; // var: declared with const, reads are replaced by init
+	uint8_t isinline; // func: declared with inline
+	uint8_t inheader; // func: defined static inline in the unit header
+	uint8_t header_visible; // func, var: used by a function in the header
+	uint8_t reachable; // func, global var: used by the program
+	uint8_t ispure; // func: no side effects, set by optimize
+	uint8_t readsnone; // func: pure and reads no memory but its own
+	uint8_t noreturn; // func: never returns, set by optimize
+	uint8_t byref; // param: points to the caller's object, set by optimize
+	uint8_t in_place; // var: init is a call constructing its result in var
+	uint8_t onstack; // var: lives in a stack frame, set by the native backend
+	int64_t offset; // native backend: frame, data or text offset
 	
 	Decl **deps; // func: variables used from outer scope
 	Scope *func_scope; // func
@@ -282,8 +338,15 @@ Decl *new_union(
 	Token *start, Scope *scope, Token *id, int exported, Decl **members
 );
 
+Decl *new_temp_var(Scope *scope, Type *type, Expr *init);
 Decl *clone_decl(Decl *decl);
 
+/*
+	Imported declarations are copies, this finds the declaration in the
+	imported unit
+*/
+Decl *original_decl(Decl *decl);
+
 /*
 	Stmt
 */
@@ -298,6 +361,7 @@ struct Foreign {
 	STMT_HEAD
 	char *filename;
 	Decl **decls;
+	uint8_t isstatic; // linked with -l instead of loaded with dlopen
 };
 
 struct If {
@@ -311,12 +375,15 @@ struct While {
 	STMT_HEAD
 	Expr *cond;
 	Block *body;
+	Decl **invariants; // hoisted out of the loop, set by optimize
+	Expr *entry_cond; // cond as it was before hoisting
 };
 
 struct Assign {
 	STMT_HEAD
 	Expr *target;
 	Expr *expr;
+	bool in_place; // expr is a call constructing its result in target
 };
 
 struct Call {
@@ -340,6 +407,7 @@ struct For {
 	Expr *from;
 	Expr *to;
 	Block *body;
+	Decl **invariants; // hoisted out of the loop, set by optimize
 };
 
 struct ForEach {
@@ -347,11 +415,14 @@ struct ForEach {
 	Expr *array;
 	Decl *iter;
 	Block *body;
+	bool byref; // iter points to the items instead of copying them
+	Decl **invariants; // hoisted out of the loop, set by optimize
 };
 
 struct Delete {
 	STMT_HEAD
 	Expr *expr;
+	Expr *allocator; // pool the object goes back to, 0 for free
 };
 
 struct Stmt {
@@ -374,21 +445,26 @@ struct Stmt {
 
 Stmt *new_stmt(Kind kind, Token *start, Scope *scope);
 Import *new_import(Token *start, Scope *scope, Unit *unit, Decl **decls);
-Foreign *new_foreign(Token *start, Scope *scope, char *name, Decl **decls);
+Foreign *new_foreign(
+	Token *start, Scope *scope, char *name, Decl **decls, int isstatic
+);
 If *new_if(Token *start, Expr *cond, Block *if_body, Block *else_body);
 While *new_while(Token *start, Scope *scope, Expr *cond, Block *body);
 Assign *new_assign(Scope *scope, Expr *target, Expr *expr);
 Call *new_call(Scope *scope, Expr *call);
 Print *new_print(Token *start, Scope *scope, Expr *expr);
 Return *new_return(Token *start, Scope *scope, Expr *expr);
-Delete *new_delete(Token *start, Scope *scope, Expr *expr);
+Delete *new_delete(
+	Token *start, Scope *scope, Expr *expr, Expr *allocator
+);
 
 For *new_for(
 	Token *start, Scope *scope, Decl *iter, Expr *from, Expr *to, Block *body
 );
 
 ForEach *new_foreach(
-	Token *start, Scope *scope, Expr *array, Decl *iter, Block *body
+	Token *start, Scope *scope, Expr *array, Decl *iter, bool byref,
+	Block *body
 );
 
 struct Scope {
@@ -417,4 +493,18 @@ struct Block {
 
 Block *new_block(Stmt **stmts, Scope *scope);
 
+/*
+	Walk
+	
+	visits statements and expressions of an analyzed tree in pre-order; the
+	bodies of function declarations are not entered
+*/
+
+typedef void (*StmtVisitor)(Stmt *stmt, void *ctx);
+typedef void (*ExprVisitor)(Expr *expr, void *ctx);
+
+void walk_expr(Expr *expr, ExprVisitor ev, void *ctx);
+void walk_stmts(Stmt **stmts, StmtVisitor sv, ExprVisitor ev, void *ctx);
+void walk_block(Block *block, StmtVisitor sv, ExprVisitor ev, void *ctx);
+
 #endif
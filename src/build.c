@@ -11,7 +11,9 @@
 #include "build.h"
 #include "print.h"
 #include "analyze.h"
+#include "optimize.h"
 #include "cgen.h"
+#include "native.h"
 #include "string.h"
 #include "../build/runtime.h.res"
 #include "../build/runtime.c.res"
@@ -95,17 +97,46 @@ static int run_cmd(char *cmd)
 	return system(cmd);
 }
 
-static void compile_c(char *cfile, char *ofile, int ismain)
+static int run_cmd_with_input(char *cmd, char *input, int64_t input_len)
+{
+	#ifdef JA_DEBUG
+	printf(COL_YELLOW "[run]:" COL_RESET " %s\n", cmd);
+	#endif
+	fflush(stdout);
+	FILE *fs = popen(cmd, "w");
+	if(!fs) return -1;
+	fwrite(input, 1, input_len, fs);
+	return pclose(fs);
+}
+
+static void compile_c(Unit *unit)
 {
 	char *cmd = string_concat(
-		ismain
+		unit->ismain
 			? "gcc -D JA_ISMAIN -c -std=c17 -pedantic-errors -o "
 			: "gcc -c -std=c17 -pedantic-errors -o ",
-		ofile, " ", cfile, 0
+		unit->obj_filename, 0
 	);
 	
-	int res = run_cmd(cmd);
-	if(res) error("could not compile %s", cfile);
+	int res = 0;
+	
+	if(options.debug_info)
+		string_append(cmd, " -g");
+	
+	if(options.system_malloc)
+		string_append(cmd, " -D JA_SYSTEM_MALLOC");
+	
+	if(options.pipe_c && !options.keep_c) {
+		string_append(cmd, " -pipe -x c -");
+		res = run_cmd_with_input(cmd, unit->c_code, unit->c_code_len);
+	}
+	else {
+		string_append(cmd, " ");
+		string_append(cmd, unit->c_filename);
+		res = run_cmd(cmd);
+	}
+	
+	if(res) error("could not compile %s", unit->src_filename);
 }
 
 static int dir_exists(char *dirname)
@@ -182,34 +213,50 @@ static Unit *build_unit(char *filename, int ismain)
 		printf(COL_YELLOW "=== analyzing ===" COL_RESET "\n");
 	#endif
 	
-	analyze(unit);
+	analyze(unit, &options);
 	
 	#ifdef JA_DEBUG
 		printf(COL_YELLOW "[OK]" COL_RESET "\n");
+		printf(COL_YELLOW "=== optimizing ===" COL_RESET "\n");
 	#endif
 	
+	optimize(unit, &options);
+	
 	if(options.show_ast)
 		print_ast(unit->block);
 	
+	cur_unit_dirname = old_unit_dirname;
+	return unit;
+}
+
+static void gen_unit(Unit *unit)
+{
 	#ifdef JA_DEBUG
-	printf(COL_YELLOW "=== generating code ===" COL_RESET "\n");
+	printf(
+		COL_YELLOW "=== generating code for %s ===" COL_RESET "\n",
+		unit->src_filename
+	);
 	#endif
-	gen(unit);
+	
+	gen(unit, !options.pipe_c || options.keep_c, options.debug_info);
 	#ifdef JA_DEBUG
-	print_c_code(unit->c_filename);
+	print_c_code(unit->c_code, unit->c_code_len);
 	#endif
-	
+}
+
+static void compile_unit(Unit *unit)
+{
 	unit->obj_filename = string_concat(cache_dir, "/", unit->unit_id, 0);
 	string_append(unit->obj_filename, ".o");
 	
-	compile_c(unit->c_filename, unit->obj_filename, ismain);
+	compile_c(unit);
 	
 	#ifdef JA_DEBUG
-	printf(COL_YELLOW "=== compiled unit %s ===" COL_RESET "\n", filename);
+	printf(
+		COL_YELLOW "=== compiled unit %s ===" COL_RESET "\n",
+		unit->src_filename
+	);
 	#endif
-	
-	cur_unit_dirname = old_unit_dirname;
-	return unit;
 }
 
 Unit *import(char *filename)
@@ -224,11 +271,19 @@ Unit *import(char *filename)
 	return build_unit(real_filename, 0);
 }
 
-void write_cache_file(char *name, char *text)
+/*
+	Resources are embedded line by line, a single string literal would grow
+	past the length C compilers are required to support
+*/
+void write_cache_file(char *name, char **lines)
 {
 	char *path = string_concat(cache_dir, "/", name, 0);
 	FILE *fs = fopen(path, "wb");
-	fwrite(text, 1, strlen(text), fs);
+	
+	for(int64_t i = 0; lines[i]; i++) {
+		fwrite(lines[i], 1, strlen(lines[i]), fs);
+	}
+	
 	fclose(fs);
 }
 
@@ -245,22 +300,58 @@ Project *build(BuildOptions _options)
 		mkdir(cache_dir, 0755);
 	}
 	
-	write_cache_file("runtime.h", RUNTIME_H_RES);
-	write_cache_file("runtime.c", RUNTIME_C_RES);
+	if(!options.native) {
+		write_cache_file("runtime.h", (char*[])RUNTIME_H_RES);
+		write_cache_file("runtime.c", (char*[])RUNTIME_C_RES);
+	}
 	
 	char *real_main_filename = realpath(options.main_filename, NULL);
 	Unit *main_unit = build_unit(real_main_filename, 1);
 	
 	#ifdef JA_DEBUG
-	printf(COL_YELLOW "=== linking ===" COL_RESET "\n");
+	printf(COL_YELLOW "=== eliminating dead code ===" COL_RESET "\n");
 	#endif
 	
+	eliminate_dead_code(project->units);
+	
+	if(options.jit) {
+		printf(COL_YELLOW "=== done ===" COL_RESET "\n");
+		return project;
+	}
+	
 	if(!options.outfilename) {
 		options.outfilename = string_concat(
 			cache_dir, "/", main_unit->unit_id, 0
 		);
 	}
 	
+	project->exe_filename = options.outfilename;
+	
+	if(options.native) {
+		#ifdef JA_DEBUG
+		printf(COL_YELLOW "=== generating native code ===" COL_RESET "\n");
+		#endif
+		
+		if(gen_native(project->units, options.outfilename))
+			error("could not write %s", options.outfilename);
+		
+		printf(COL_YELLOW "=== done ===" COL_RESET "\n");
+		return project;
+	}
+	
+	// headers of all units must exist before any unit is compiled
+	array_for(project->units, i) {
+		gen_unit(project->units[i]);
+	}
+	
+	array_for(project->units, i) {
+		compile_unit(project->units[i]);
+	}
+	
+	#ifdef JA_DEBUG
+	printf(COL_YELLOW "=== linking ===" COL_RESET "\n");
+	#endif
+	
 	char *cmd = string_concat(
 		"gcc -o ", options.outfilename, " ", cache_dir, "/runtime.c", 0
 	);
@@ -271,12 +362,29 @@ Project *build(BuildOptions _options)
 		string_append(cmd, unit->obj_filename);
 	}
 	
+	if(options.debug_info)
+		string_append(cmd, " -g");
+	
+	if(options.system_malloc)
+		string_append(cmd, " -D JA_SYSTEM_MALLOC");
+	
+	// libraries of static foreign imports, by file name
+	array_for(project->units, i) {
+		Foreign **foreigns = project->units[i]->block->scope->foreigns;
+		
+		array_for(foreigns, j) {
+			if(foreigns[j]->isstatic) {
+				string_append(cmd, " -l:");
+				string_append(cmd, foreigns[j]->filename);
+			}
+		}
+	}
+	
 	string_append(cmd, " -ldl");
 	
 	int res = run_cmd(cmd);
 	if(res) error("could not link the object files");
 	
-	project->exe_filename = options.outfilename;
 	printf(COL_YELLOW "=== done ===" COL_RESET "\n");
 	return project;
 }
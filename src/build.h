@@ -12,6 +12,8 @@ typedef struct Unit {
 	char *h_filename;
 	char *c_filename;
 	char *c_main_filename;
+	char *c_code;
+	int64_t c_code_len;
 	char *src;
 	int64_t src_len;
 	Token *tokens;
@@ -29,6 +31,14 @@ typedef struct {
 	char *outfilename;
 	bool show_tokens;
 	bool show_ast;
+	bool pipe_c; // pipe generated C into gcc instead of writing .c files
+	bool keep_c; // write .c files even when piping
+	bool bounds_check; // runtime bounds checks on subscripts
+	bool inline_calls; // substitute small functions at their call sites
+	bool debug_info; // compile with -g, map C lines to ja lines
+	bool native; // generate machine code directly instead of C
+	bool jit; // native code run in memory, no files written
+	bool system_malloc; // new and delete call malloc and free directly
 } BuildOptions;
 
 Project *build(BuildOptions options);
@@ -1,4 +1,8 @@
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <stdarg.h>
 #include <inttypes.h>
 #include "ast.h"
@@ -7,9 +11,15 @@
 #include "string.h"
 
 static Unit *cur_unit;
-static FILE *ofs;
+static char *out;
+static int64_t out_len;
+static int64_t out_cap;
 static int64_t level;
 static int in_header;
+static int64_t pass;
+static bool line_directives;
+static int64_t counted_len; // output counted by output_line
+static int64_t counted_lines;
 
 static void gen_vardecls(Decl **decls);
 static void gen_vardecl_stmt(Decl *decl);
@@ -19,11 +29,147 @@ int is_in_header()
 	return in_header;
 }
 
+/*
+	Exported declarations and those referred to by functions defined in the
+	unit header go by their public names
+*/
+bool is_public(Decl *decl)
+{
+	return decl->exported || decl->header_visible;
+}
+
 Unit *get_cur_unit()
 {
 	return cur_unit;
 }
 
+int64_t get_pass()
+{
+	return pass;
+}
+
+int64_t get_output_len()
+{
+	return out_len;
+}
+
+/*
+	Remove everything written since output position from and return it as a
+	new null terminated string
+*/
+char *cut_output(int64_t from)
+{
+	int64_t len = out_len - from;
+	char *res = malloc(len + 1);
+	memcpy(res, out + from, len);
+	res[len] = 0;
+	out_len = from;
+	
+	if(counted_len > from) {
+		counted_len = 0;
+		counted_lines = 0;
+	}
+	
+	return res;
+}
+
+void write_raw(char *str, int64_t len)
+{
+	if(out_len + len > out_cap) {
+		while(out_len + len > out_cap) {
+			out_cap = out_cap ? out_cap * 2 : 4096;
+		}
+		
+		out = realloc(out, out_cap);
+	}
+	
+	memcpy(out + out_len, str, len);
+	out_len += len;
+}
+
+static void begin_output(int header)
+{
+	out_len = 0;
+	level = 0;
+	in_header = header;
+	counted_len = 0;
+	counted_lines = 0;
+	pass ++;
+}
+
+/*
+	Get the number of the line that the next write starts on
+*/
+static int64_t output_line()
+{
+	for(; counted_len < out_len; counted_len ++) {
+		if(out[counted_len] == '\n') counted_lines ++;
+	}
+	
+	return counted_lines + 1;
+}
+
+/*
+	Attribute the following C code to the ja source line of token
+*/
+void gen_line(Token *token)
+{
+	if(!line_directives || !token) return;
+	
+	char buf[32];
+	sprintf(buf, "%" PRId64, token->line);
+	write("#line %s \"%s\"\n", buf, cur_unit->src_filename);
+}
+
+/*
+	Attribute the following C code to its own lines again
+*/
+static void gen_output_line()
+{
+	if(!line_directives) return;
+	
+	char buf[32];
+	sprintf(buf, "%" PRId64, output_line() + 1);
+	
+	write(
+		"#line %s \"%s\"\n", buf,
+		in_header ? cur_unit->h_filename : cur_unit->c_filename
+	);
+}
+
+/*
+	Write the output to filename with a single write, but only if the file
+	does not already have the exact same content. This keeps the mtimes of
+	unchanged C files and headers intact.
+*/
+static void flush_output(char *filename)
+{
+	FILE *fs = fopen(filename, "rb");
+	
+	if(fs) {
+		fseek(fs, 0, SEEK_END);
+		int64_t old_len = ftell(fs);
+		int same = 0;
+		
+		if(old_len == out_len) {
+			rewind(fs);
+			char *old = malloc(old_len + 1);
+			same =
+				fread(old, 1, old_len, fs) == old_len &&
+				memcmp(old, out, out_len) == 0;
+			
+			free(old);
+		}
+		
+		fclose(fs);
+		if(same) return;
+	}
+	
+	fs = fopen(filename, "wb");
+	fwrite(out, 1, out_len, fs);
+	fclose(fs);
+}
+
 void gen_mainfuncname(Unit *unit)
 {
 	write("_%s_main", unit->unit_id);
@@ -58,7 +204,7 @@ static void gen_mainfunchead(Unit *unit)
 		%Y - complete Type*
 		%e - Expr*
 		%E - init Expr*
-		%S - a char* string followed by a int64_t length
+		%S - a char* string followed by a int64_t length, escaped for C
 		%I - ja_ identifier Token*
 		%X - _<unit-id>_ prefixed Token*
 		%i - signed 64 bit integer
@@ -68,83 +214,108 @@ void write(char *msg, ...)
 {
 	va_list args;
 	va_start(args, msg);
+	char buf[32];
 	
 	while(*msg) {
+		if(*msg != '%') {
+			// literal run up to the next format specifier
+			int64_t run = strcspn(msg, "%");
+			write_raw(msg, run);
+			msg += run;
+			continue;
+		}
+		
+		msg++;
+		
 		if(*msg == '%') {
 			msg++;
-			if(*msg == '%') {
-				msg++;
-				fputc('%', ofs);
-			}
-			else if(*msg == '>') {
-				msg++;
-				for(int64_t i=0; i<level; i++) write(INDENT);
-			}
-			else if(*msg == 'c') {
-				msg++;
-				fprintf(ofs, "%c", va_arg(args, int));
-			}
-			else if(*msg == 's') {
-				msg++;
-				fprintf(ofs, "%s", va_arg(args, char*));
-			}
-			else if(*msg == 't') {
-				msg++;
-				Token *token = va_arg(args, Token*);
-				fwrite(token->start, 1, token->length, ofs);
-			}
-			else if(*msg == 'y') {
-				msg++;
-				Type *type = va_arg(args, Type*);
-				gen_type(type);
-			}
-			else if(*msg == 'z') {
-				msg++;
-				Type *type = va_arg(args, Type*);
-				gen_type_postfix(type);
-			}
-			else if(*msg == 'Y') {
-				msg++;
-				Type *type = va_arg(args, Type*);
-				gen_type(type);
-				gen_type_postfix(type);
-			}
-			else if(*msg == 'e') {
-				msg++;
-				Expr *expr = va_arg(args, Expr*);
-				gen_expr(expr);
-			}
-			else if(*msg == 'E') {
-				msg++;
-				Expr *expr = va_arg(args, Expr*);
-				gen_init_expr(expr);
-			}
-			else if(*msg == 'S') {
-				msg++;
-				char *string = va_arg(args, char*);
-				int64_t length = va_arg(args, int64_t);
-				fwrite(string, 1, length, ofs);
-			}
-			else if(*msg == 'I') {
-				msg++;
-				write("ja_%t", va_arg(args, Token*));
-			}
-			else if(*msg == 'X') {
-				msg++;
-				write("_%s_%t", cur_unit->unit_id, va_arg(args, Token*));
-			}
-			else if(*msg == 'i') {
-				msg++;
-				fprintf(ofs, "%" PRId64 "L", va_arg(args, int64_t));
-			}
-			else if(*msg == 'u') {
-				msg++;
-				fprintf(ofs, "%" PRIu64 "UL", va_arg(args, uint64_t));
+			write_raw("%", 1);
+		}
+		else if(*msg == '>') {
+			msg++;
+			for(int64_t i=0; i<level; i++) write_raw(INDENT, strlen(INDENT));
+		}
+		else if(*msg == 'c') {
+			msg++;
+			buf[0] = va_arg(args, int);
+			write_raw(buf, 1);
+		}
+		else if(*msg == 's') {
+			msg++;
+			char *str = va_arg(args, char*);
+			write_raw(str, strlen(str));
+		}
+		else if(*msg == 't') {
+			msg++;
+			Token *token = va_arg(args, Token*);
+			write_raw(token->start, token->length);
+		}
+		else if(*msg == 'y') {
+			msg++;
+			Type *type = va_arg(args, Type*);
+			gen_type(type);
+		}
+		else if(*msg == 'z') {
+			msg++;
+			Type *type = va_arg(args, Type*);
+			gen_type_postfix(type);
+		}
+		else if(*msg == 'Y') {
+			msg++;
+			Type *type = va_arg(args, Type*);
+			gen_type(type);
+			gen_type_postfix(type);
+		}
+		else if(*msg == 'e') {
+			msg++;
+			Expr *expr = va_arg(args, Expr*);
+			gen_expr(expr);
+		}
+		else if(*msg == 'E') {
+			msg++;
+			Expr *expr = va_arg(args, Expr*);
+			gen_init_expr(expr);
+		}
+		else if(*msg == 'S') {
+			msg++;
+			char *string = va_arg(args, char*);
+			int64_t length = va_arg(args, int64_t);
+			
+			for(int64_t i = 0; i < length; i ++) {
+				unsigned char c = string[i];
+				
+				if(isprint(c) && c != '"' && c != '\\' && c != '?') {
+					write_raw(string + i, 1);
+				}
+				else {
+					sprintf(buf, "\\%03o", c);
+					write_raw(buf, 4);
+				}
 			}
 		}
-		else {
-			fputc(*msg, ofs);
+		else if(*msg == 'I') {
+			msg++;
+			Token *token = va_arg(args, Token*);
+			write_raw("ja_", 3);
+			write_raw(token->start, token->length);
+		}
+		else if(*msg == 'X') {
+			msg++;
+			Token *token = va_arg(args, Token*);
+			write_raw("_", 1);
+			write_raw(cur_unit->unit_id, strlen(cur_unit->unit_id));
+			write_raw("_", 1);
+			write_raw(token->start, token->length);
+		}
+		else if(*msg == 'i') {
+			msg++;
+			int64_t len = sprintf(buf, "%" PRId64 "L", va_arg(args, int64_t));
+			write_raw(buf, len);
+		}
+		else if(*msg == 'u') {
 			msg++;
+			int64_t len = sprintf(buf, "%" PRIu64 "UL", va_arg(args, uint64_t));
+			write_raw(buf, len);
 		}
 	}
 	
@@ -184,12 +355,29 @@ static void gen_params(Decl **params)
 		if(type->kind == ARRAY) {
 			write("%y (*ap_%t)%z", type, param->id, type);
 		}
+		else if(param->byref) {
+			write("%y *ap_%t%z", type, param->id, type);
+		}
 		else {
 			write("%y %s%z", type, param->private_id, type);
 		}
 	}
 }
 
+// the parameters as arguments, for forwarding calls
+static void gen_param_names(Decl **params)
+{
+	array_for(params, i) {
+		Decl *param = params[i];
+		if(i > 0) write(", ");
+		
+		if(param->type->kind == ARRAY || param->byref)
+			write("ap_%t", param->id);
+		else
+			write("%s", param->private_id);
+	}
+}
+
 static void gen_array_param_decls(Decl **params)
 {
 	level ++;
@@ -198,7 +386,7 @@ static void gen_array_param_decls(Decl **params)
 		Decl *param = params[i];
 		Type *type = param->type;
 		
-		if(type->kind == ARRAY) {
+		if(type->kind == ARRAY && !param->byref) {
 			write("%>%y %s%z;\n", type, param->private_id, type);
 			
 			write(
@@ -218,30 +406,57 @@ static void gen_returntypedecl(Decl *decl)
 	Type *returntype = decl->type->returntype;
 	
 	if(returntype->kind == ARRAY) {
-		write("%>typedef struct { %y a%z; } ", returntype, returntype);
+		write("%>typedef %y ", returntype);
 		
 		if(in_header)
-			write("rt_%s;\n", decl->public_id);
+			write("rt_%s", decl->public_id);
 		else
-			write("rt_%s;\n", decl->private_id);
+			write("rt_%s", decl->private_id);
+		
+		write("%z;\n", returntype);
 	}
 }
 
+/*
+	Tell the C compiler what optimize found out about the function
+*/
+/*
+	A void function can be pure too, callers that call it stay pure, but gcc
+	warns about the attribute on it
+*/
+static void gen_func_attributes(Decl *decl)
+{
+	bool hasvalue = decl->type->returntype->kind != NONE;
+	
+	if(hasvalue && decl->readsnone)
+		write("__attribute__((const)) ");
+	else if(hasvalue && decl->ispure)
+		write("__attribute__((pure)) ");
+	
+	if(decl->noreturn)
+		write("__attribute__((noreturn, cold)) ");
+}
+
 static void gen_funchead(Decl *decl)
 {
 	Type *returntype = decl->type->returntype;
 	
-	if(!decl->exported)
+	if(decl->isinline && (!is_public(decl) || decl->inheader))
+		write("%>static inline __attribute__((always_inline)) ");
+	else if(decl->inheader)
+		write("%>static inline ");
+	else if(!is_public(decl))
 		write("%>static ");
 	else
 		write("%>");
 	
+	gen_func_attributes(decl);
+	
 	if(returntype->kind == ARRAY) {
-		if(in_header)
-			write("rt_%s %s(", decl->public_id, decl->public_id);
-		else
-			write("rt_%s %s(", decl->private_id, decl->private_id);
-		
+		// the caller passes the destination for the result and gets it back
+		char *id = in_header ? decl->public_id : decl->private_id;
+		write("rt_%s *%s(rt_%s *sret", id, id, id);
+		if(decl->params) write(", ");
 		gen_params(decl->params);
 		write(")");
 	}
@@ -255,11 +470,23 @@ static void gen_funchead(Decl *decl)
 		write(")%z", returntype);
 	}
 }
-	
+
+/*
+	Locals of functions defined in the header are generated as in C files
+*/
+static int is_header_decl(Decl *decl)
+{
+	return in_header && !decl->scope->parent;
+}
+
 void gen_vardecl_init(Decl *decl, int struct_inst_member)
 {
-	if(in_header || decl->scope->structhost && !struct_inst_member)
+	if(
+		is_header_decl(decl) ||
+		decl->scope->structhost && !struct_inst_member
+	) {
 		return;
+	}
 	
 	if(decl->init) {
 		if(
@@ -286,7 +513,10 @@ void gen_vardecl_init(Decl *decl, int struct_inst_member)
 	}
 	else if(
 		decl->type->kind == ARRAY || decl->type->kind == UNION ||
-		decl->type->kind == STRING || decl->type->kind == SLICE
+		decl->type->kind == STRING || decl->type->kind == SLICE ||
+		decl->type->kind == DYNARRAY || decl->type->kind == ARENA ||
+		decl->type->kind == POOL || decl->type->kind == BUILDER ||
+		decl->type->kind == MAP
 	) {
 		write(" = {0}");
 	}
@@ -390,10 +620,10 @@ static void gen_structdecl(Decl *decl)
 
 static void gen_funcproto(Decl *decl)
 {
-	if(decl->imported)
+	if(decl->imported || decl->builtin || !decl->reachable)
 		return;
 	
-	if(!in_header && decl->exported) {
+	if(!in_header && is_public(decl)) {
 		gen_export_alias(decl);
 		Type *returntype = decl->type->returntype;
 		
@@ -403,7 +633,7 @@ static void gen_funcproto(Decl *decl)
 		return;
 	}
 	
-	if(in_header && !decl->exported)
+	if(in_header && !is_public(decl))
 		return;
 	
 	gen_returntypedecl(decl);
@@ -413,36 +643,47 @@ static void gen_funcproto(Decl *decl)
 
 static void gen_funcdecl(Decl *decl)
 {
-	if(decl->imported)
+	if(
+		decl->imported || decl->builtin || !decl->reachable ||
+		decl->inheader != in_header
+	) {
 		return;
+	}
 	
+	gen_line(decl->start);
 	gen_funchead(decl);
 	write(" {\n");
 	gen_array_param_decls(decl->params);
 	gen_block(decl->body);
+	
+	// foreign exit functions are not known to the C compiler as noreturn
+	if(decl->noreturn)
+		write("%>" INDENT "__builtin_unreachable();\n");
+	
 	write("%>}\n");
+	gen_output_line();
 }
 
 void gen_vardecl(Decl *decl)
 {
-	if(decl->imported)
+	if(decl->imported || !decl->scope->parent && !decl->reachable)
 		return;
 	
-	if(in_header && !decl->exported && !decl->scope->structhost)
+	if(is_header_decl(decl) && !is_public(decl))
 		return;
 	
-	if(!in_header && decl->exported)
+	if(!in_header && is_public(decl))
 		gen_export_alias(decl);
 	
 	write("%>");
 	
-	if(in_header && decl->exported)
+	if(in_header && is_public(decl))
 		write("extern ");
 	
-	if(!decl->exported && !decl->scope->parent)
+	if(!is_public(decl) && !decl->scope->parent)
 		write("static ");
 	
-	if(decl->exported && in_header)
+	if(is_public(decl) && in_header)
 		write("%y %s%z", decl->type, decl->public_id, decl->type);
 	else
 		write("%y %s%z", decl->type, decl->private_id, decl->type);
@@ -470,7 +711,7 @@ static void gen_structdecls(Decl **decls)
 			gen_structdecl_typedef(decls[i]);
 		}
 	}
-
+	
 	array_for(decls, i) {
 		if(decls[i]->kind == STRUCT || decls[i]->kind == UNION) {
 			gen_structdecl(decls[i]);
@@ -518,6 +759,56 @@ static void gen_imports(Import **imports)
 	}
 }
 
+/*
+	Static foreign symbols are bound by the linker, asm labels keep their C
+	names apart from the prototypes of the system headers
+*/
+static void gen_foreign_static_decl(Decl *decl)
+{
+	if(decl->kind == FUNC) {
+		Type *returntype = decl->type->returntype;
+		write("extern %y %s(", returntype, decl->private_id);
+		gen_params(decl->params);
+		write(")%z __asm__(\"%t\");\n", returntype, decl->id);
+	}
+	else if(decl->kind == VAR) {
+		write(
+			"extern char jaforeign_%t __asm__(\"%t\");\n", decl->id, decl->id
+		);
+	}
+}
+
+/*
+	Dynamic foreign functions start out pointing to a trampoline, which binds
+	the symbol on the first call and replaces itself
+*/
+static void gen_foreign_lazy_decl(Foreign *import, Decl *decl)
+{
+	Type *returntype = decl->type->returntype;
+	
+	write("static %y jalazy_%t(", returntype, decl->id);
+	gen_params(decl->params);
+	write(")%z;\n", returntype);
+	
+	write("static %y (*%s)(", returntype, decl->private_id);
+	gen_params(decl->params);
+	write(")%z = jalazy_%t;\n", returntype, decl->id);
+	
+	write("static %y jalazy_%t(", returntype, decl->id);
+	gen_params(decl->params);
+	
+	write(
+		")%z {\n"
+		INDENT "*(void**)&%s = jaforeign_bind(\"%s\", \"%t\");\n"
+		INDENT "%s%s(",
+		returntype, decl->private_id, import->filename, decl->id,
+		returntype->kind == NONE ? "" : "return ", decl->private_id
+	);
+	
+	gen_param_names(decl->params);
+	write(");\n}\n");
+}
+
 static void gen_foreign_decls(Foreign **imports)
 {
 	array_for(imports, i) {
@@ -527,54 +818,39 @@ static void gen_foreign_decls(Foreign **imports)
 		array_for(decls, j) {
 			Decl *decl = decls[j];
 			
-			if(decl->kind == FUNC) {
-				Type *returntype = decl->type->returntype;
-				write("static %y (*%s)(", returntype, decl->private_id);
-				gen_params(decl->params);
-				write(")%z;\n", returntype);
+			if(import->isstatic) {
+				gen_foreign_static_decl(decl);
+			}
+			else if(decl->kind == FUNC) {
+				gen_foreign_lazy_decl(import, decl);
 			}
 		}
 	}
 }
 
+// foreign functions bind themselves on their first call, variables here
 static void gen_foreign_imports(Foreign **imports)
 {
-	write(INDENT "void *lib = 0;\n");
-	
 	array_for(imports, i) {
 		Foreign *import = imports[i];
 		Decl **decls = import->decls;
 		
-		write(
-			INDENT "lib = dlopen(\"%s\", RTLD_LAZY);\n"
-			INDENT "if(lib == 0) "
-			"fprintf(stderr, \"error: could not load library %s\\n\");\n"
-			, import->filename
-			, import->filename
-		);
-		
 		array_for(decls, j) {
 			Decl *decl = decls[j];
+			if(decl->kind != VAR) continue;
 			
-			if(decl->kind == FUNC) {
+			if(import->isstatic) {
 				write(
-					INDENT "*(void**)&%s = dlsym(lib, \"%t\");\n"
-					,decl->private_id, decl->id
+					INDENT "%s = (void*)&jaforeign_%t;\n",
+					decl->private_id, decl->id
 				);
 			}
-			else if(decl->kind == VAR) {
+			else {
 				write(
-					INDENT "%s = dlsym(lib, \"%t\");\n",
-					decl->private_id, decl->id
+					INDENT "%s = jaforeign_bind(\"%s\", \"%t\");\n",
+					decl->private_id, import->filename, decl->id
 				);
 			}
-			
-			write(
-				INDENT "if(%s == 0) "
-				"fprintf(stderr, \"error: could not load symbol %t\\n\");\n"
-				, decl->private_id
-				, decl->id
-			);
 		}
 	}
 }
@@ -583,9 +859,7 @@ static void gen_foreign_imports(Foreign **imports)
 
 static void gen_h()
 {
-	ofs = fopen(cur_unit->h_filename, "wb");
-	level = 0;
-	in_header = 1;
+	begin_output(1);
 	
 	write(
 		"#ifndef _%s_H\n"
@@ -613,16 +887,17 @@ static void gen_h()
 	write("\n// exported variables\n");
 	gen_vardecls(decls);
 	
+	write("\n// inline functions\n");
+	gen_funcdecls(decls);
+	
 	write("\n#endif\n");
 	
-	fclose(ofs);
+	flush_output(cur_unit->h_filename);
 }
 
-static void gen_c()
+static void gen_c(bool write_c_file)
 {
-	ofs = fopen(cur_unit->c_filename, "wb");
-	level = 0;
-	in_header = 0;
+	begin_output(0);
 	
 	write("#include \"%s\"\n", cur_unit->h_filename);
 	
@@ -674,6 +949,7 @@ static void gen_c()
 	gen_foreign_imports(unit_scope->foreigns);
 	level --;
 	gen_block(cur_unit->block);
+	gen_output_line();
 	
 	write(
 		INDENT "return 0;\n"
@@ -684,6 +960,7 @@ static void gen_c()
 		write(
 			"\n#ifdef JA_ISMAIN\n"
 			"int main(int argc, char **argv) {\n"
+			INDENT "atexit(jaflush);\n"
 			INDENT "return ",
 			cur_unit->h_filename
 		);
@@ -697,14 +974,19 @@ static void gen_c()
 		);
 	}
 	
-	fclose(ofs);
+	if(write_c_file)
+		flush_output(cur_unit->c_filename);
+	
+	cur_unit->c_code_len = out_len;
+	cur_unit->c_code = cut_output(0);
 }
 
 // --- //
 
-void gen(Unit *unit)
+void gen(Unit *unit, bool write_c_file, bool debug_info)
 {
 	cur_unit = unit;
+	line_directives = debug_info;
 	gen_h();
-	gen_c();
+	gen_c(write_c_file);
 }
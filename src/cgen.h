@@ -1,9 +1,14 @@
 #ifndef CGEN_H
 #define CGEN_H
 
+#include <stdbool.h>
 #include "parse.h"
 #include "build.h"
 
-void gen(Unit *unit);
+/*
+	With debug_info, the generated code is mapped to the ja source lines by
+	#line directives
+*/
+void gen(Unit *unit, bool write_c_file, bool debug_info);
 
 #endif
@@ -1,3 +1,5 @@
+#include <stdio.h>
+#include <inttypes.h>
 #include "cgen_internal.h"
 #include "array.h"
 
@@ -27,6 +29,9 @@ static void gen_cast(Expr *expr)
 			srctype->subtype->length, srcexpr
 		);
 	}
+	else if(type->kind == SLICE && srctype->kind == DYNARRAY) {
+		write("jadynarray_view(%e)", srcexpr);
+	}
 	else {
 		write("((%Y)%e)", type, srcexpr);
 	}
@@ -39,61 +44,228 @@ static void gen_string(Expr *expr)
 	);
 }
 
+static void gen_check_location(Expr *expr)
+{
+	char line[32];
+	sprintf(line, "%" PRId64, expr->start ? expr->start->line : 0);
+	write("\"%s:%s\"", get_cur_unit()->src_filename, line);
+}
+
+/*
+	Keys and values are stored inline in the table, the runtime learns their
+	sizes and alignments from the layout
+*/
+static void gen_map_layout(Type *type)
+{
+	Type *keytype = type->keytype;
+	Type *itemtype = type->itemtype;
+	
+	write(
+		"(&(jamap_layout){sizeof(%Y), _Alignof(%Y), sizeof(%Y), _Alignof(%Y), ",
+		keytype, keytype, itemtype, itemtype
+	);
+	
+	write(keytype->kind == STRING ? "jatrue})" : "jafalse})");
+}
+
+/*
+	The key gets an address with a one item compound literal
+*/
+static void gen_map_key(Expr *map, Expr *key)
+{
+	write("&%e, ", map);
+	gen_map_layout(map->type);
+	write(", (%Y[1]){%e}", map->type->keytype, key);
+}
+
+/*
+	Reads of missing keys point to a zero value instead of adding the key
+*/
+static void gen_map_item(Expr *expr)
+{
+	Expr *map = expr->array;
+	Type *itemtype = map->type->itemtype;
+	
+	if(expr->inserts) {
+		write("(*(%y(*)%z)jamap_insert(", itemtype, itemtype);
+		gen_map_key(map, expr->index);
+		write("))");
+	}
+	else {
+		write("(*(%y(*)%z)jamap_get(", itemtype, itemtype);
+		gen_map_key(map, expr->index);
+		write(", &(%Y){0}))", itemtype);
+	}
+}
+
 static void gen_subscript(Expr *expr)
 {
-	if(expr->subexpr->type->kind == STRING) {
+	if(expr->subexpr->type->kind == MAP) {
+		gen_map_item(expr);
+	}
+	else if(expr->subexpr->type->kind == STRING) {
 		Expr *string = expr->subexpr;
 		Expr *index = expr->index;
 		
-		write(
-			"((jastring){1L, %e.string + %e})",
-			string, index
-		);
+		if(expr->needs_check) {
+			write("jastring_item(%e, %e, ", string, index);
+			gen_check_location(expr);
+			write(")");
+		}
+		else {
+			write(
+				"((jastring){1L, %e.string + %e})",
+				string, index
+			);
+		}
 	}
-	else if(expr->subexpr->type->kind == SLICE) {
+	else if(
+		expr->subexpr->type->kind == SLICE ||
+		expr->subexpr->type->kind == DYNARRAY
+	) {
 		Expr *slice = expr->array;
 		Type *itemtype = slice->type->itemtype;
 		Expr *index = expr->index;
 		
+		if(expr->needs_check) {
+			write("(*(%y(*)%z)jaslice_item(", itemtype, itemtype);
+			
+			if(slice->type->kind == DYNARRAY)
+				write("jadynarray_view(%e)", slice);
+			else
+				gen_expr(slice);
+			
+			write(", %e, sizeof(%Y), ", index, itemtype);
+			
+			gen_check_location(expr);
+			write("))");
+		}
+		else {
+			write(
+				"((%y(*)%z)(%e).items)[%e]",
+				itemtype, itemtype, slice, index
+			);
+		}
+	}
+	else if(expr->needs_check) {
 		write(
-			"((%y(*)%z)(%e).items)[%e]",
-			itemtype, itemtype, slice, index
+			"(%e[jabounds(%e, %i, ",
+			expr->subexpr, expr->index, expr->subexpr->type->length
 		);
+		
+		gen_check_location(expr);
+		write(")])");
 	}
 	else {
 		write("(%e[%e])", expr->subexpr, expr->index);
 	}
 }
 
-static void gen_binop(Expr *expr)
+/*
+	Check if expr can be written out more than once without evaluating
+	anything twice
+*/
+static bool is_simple(Expr *expr)
+{
+	switch(expr->kind) {
+		case INT:
+		case BOOL:
+		case STRING:
+		case CSTRING:
+		case ENUM:
+		case VAR:
+			return true;
+	}
+	
+	return false;
+}
+
+static void gen_logic_op(Expr *expr)
 {
 	Expr *left = expr->left;
-	Expr *right = expr->right;
-	Token *op = expr->operator;
+	Type *type = expr->type;
+	bool bound = !is_simple(left);
 	
-	if(left->type->kind == STRING && op->kind == TK_EQUALS) {
+	// the left operand is both tested and yielded, so evaluate it only once
+	if(bound) {
+		Decl *tmp = new_temp_var(get_cur_unit()->block->scope, type, left);
+		
 		write(
-			"(%e.length == %e.length && "
-			"memcmp(%e.string, %e.string, %e.length) == 0)",
-			expr->left, expr->right,
-			expr->left, expr->right, expr->left
+			"(__extension__ ({%y %s%z = %e; ",
+			type, tmp->private_id, type, left
 		);
+		
+		left = new_var_expr(tmp->start, tmp);
 	}
-	else if(op->kind == TK_AND) {
-		if(expr->type->kind == STRING) {
-			write("(%e.length == 0 ? %e : %e)", left, left, right);
-		}
-		else {
-			write("(!(%e) ? %e : %e)", left, left, right);
-		}
+	
+	if(type->kind == STRING)
+		write("(%e.length == 0 ? ", left);
+	else
+		write("(!(%e) ? ", left);
+	
+	if(expr->operator->kind == TK_AND)
+		write("%e : %e)", left, expr->right);
+	else
+		write("%e : %e)", expr->right, left);
+	
+	if(bound)
+		write("; }))");
+}
+
+static bool is_concat(Expr *expr)
+{
+	return
+		expr->kind == BINOP && expr->type->kind == STRING &&
+		expr->operator->kind == TK_PLUS;
+}
+
+static int64_t count_concat_parts(Expr *expr)
+{
+	if(is_concat(expr))
+		return count_concat_parts(expr->left) + count_concat_parts(expr->right);
+	
+	return 1;
+}
+
+static void gen_concat_parts(Expr *expr)
+{
+	if(is_concat(expr)) {
+		gen_concat_parts(expr->left);
+		write(", ");
+		gen_concat_parts(expr->right);
 	}
-	else if(op->kind == TK_OR) {
-		if(expr->type->kind == STRING) {
-			write("(%e.length != 0 ? %e : %e)", left, right, left);
-		}
-		else {
-			write("(%e ? %e : %e)", left, right, left);
-		}
+	else {
+		gen_expr(expr);
+	}
+}
+
+/*
+	A whole chain a + b + c is one call, which sums up the lengths and
+	allocates the result once instead of once per operator
+*/
+static void gen_concat(Expr *expr)
+{
+	write("jastring_concat(%i, (jastring[]){", count_concat_parts(expr));
+	gen_concat_parts(expr);
+	write("})");
+}
+
+static void gen_binop(Expr *expr)
+{
+	Token *op = expr->operator;
+	
+	if(expr->left->type->kind == STRING && op->kind == TK_EQUALS) {
+		write("jastring_equ(%e, %e)", expr->left, expr->right);
+	}
+	else if(is_concat(expr)) {
+		gen_concat(expr);
+	}
+	else if(op->kind == TK_AND || op->kind == TK_OR) {
+		gen_logic_op(expr);
+	}
+	else if(op->kind == TK_DSLASH) {
+		// integer division, // would start a comment in C
+		write("(%e / %e)", expr->left, expr->right);
 	}
 	else {
 		write("(%e %s %e)", expr->left, expr->operator->punct, expr->right);
@@ -108,16 +280,21 @@ static void gen_exprs(Expr **exprs)
 	}
 }
 
-static void gen_args(Expr **exprs)
+static void gen_args(Expr **exprs, Decl **params)
 {
 	array_for(exprs, i) {
 		if(i > 0) write(", ");
 		Expr *expr = exprs[i];
 		Type *type = expr->type;
+		bool byref = params && params[i]->byref;
 		
-		if(type->kind == ARRAY) {
+		if(type->kind == ARRAY || byref && expr->islvalue) {
 			write("(&%e)", expr);
 		}
+		else if(byref) {
+			// a one item compound literal gives an rvalue an address
+			write("((%Y[1]){%e})", type, expr);
+		}
 		else {
 			gen_expr(expr);
 		}
@@ -131,17 +308,55 @@ static void gen_array(Expr *expr)
 	write("})");
 }
 
-static void gen_call(Expr *expr)
+static Decl **get_callee_params(Expr *callee)
+{
+	if(callee->kind == VAR && callee->decl->kind == FUNC)
+		return callee->decl->params;
+	
+	return 0;
+}
+
+/*
+	Call a function returning an array with dest as the slot its result is
+	constructed in, or with the current function's own slot if dest is 0
+*/
+void gen_call_into(Expr *expr, Expr *dest)
 {
-	write("(%e(", expr->callee);
-	gen_args(expr->args);
+	if(dest)
+		write("%e(&%e", expr->callee, dest);
+	else
+		write("%e(sret", expr->callee);
+	
+	if(expr->args) write(", ");
+	gen_args(expr->args, get_callee_params(expr->callee));
 	write(")");
+}
+
+static void gen_call(Expr *expr)
+{
+	Expr *callee = expr->callee;
+	Type *returntype = callee->type->returntype;
+	
+	// foreign functions might write to stdout on their own
+	int foreign = callee->kind == VAR && callee->decl->cfunc;
 	
-	if(expr->callee->type->returntype->kind == ARRAY) {
-		write(".a");
+	if(foreign)
+		write("(japrint_sync(), ");
+	
+	if(returntype->kind == ARRAY) {
+		// no destination known, a compound literal serves as result slot
+		write("(*%e(&(%Y){0}", callee, returntype);
+		if(expr->args) write(", ");
+	}
+	else {
+		write("(%e(", callee);
 	}
 	
-	write(")");
+	gen_args(expr->args, get_callee_params(callee));
+	write("))");
+	
+	if(foreign)
+		write(")");
 }
 
 static void gen_member(Expr *expr)
@@ -184,14 +399,141 @@ void gen_length(Expr *expr)
 			write("%i", type->length);
 		}
 	}
-	else if(type->kind == SLICE || type->kind == STRING) {
+	else if(
+		type->kind == SLICE || type->kind == DYNARRAY ||
+		type->kind == STRING || type->kind == BUILDER || type->kind == MAP
+	) {
 		write("(%e).length", array);
 	}
 }
 
+static void gen_builder_call(Expr *expr)
+{
+	Expr *builder = expr->array;
+	Expr *arg = expr->args ? expr->args[0] : 0;
+	
+	switch(expr->dynop) {
+		case DYN_PUSH:
+			write("jabuilder_push(&%e, %e)", builder, arg);
+			break;
+		case DYN_RESERVE:
+			write("jadynarray_reserve(&%e, %e, 1, ", builder, arg);
+			gen_check_location(expr);
+			write(")");
+			break;
+		case DYN_APPEND:
+			if(arg->type->kind == STRING)
+				write("jabuilder_append(&%e, %e)", builder, arg);
+			else if(arg->type->kind == UINT64)
+				write("jabuilder_append_uint(&%e, %e)", builder, arg);
+			else
+				write("jabuilder_append_int(&%e, %e)", builder, arg);
+			break;
+		case DYN_FINISH:
+			write("jabuilder_finish(&%e)", builder);
+			break;
+	}
+}
+
+static void gen_map_call(Expr *expr)
+{
+	if(expr->dynop == DYN_HAS) {
+		write("(jamap_find(");
+		gen_map_key(expr->array, expr->args[0]);
+		write(") != 0)");
+	}
+	else {
+		write("jamap_remove(");
+		gen_map_key(expr->array, expr->args[0]);
+		write(")");
+	}
+}
+
+/*
+	Growable array operations take the array by address; pushed items get one
+	with a compound literal, they are evaluated before the buffer can move
+*/
+static void gen_dyncall(Expr *expr)
+{
+	Expr *array = expr->array;
+	Type *itemtype = array->type->itemtype;
+	Expr *arg = expr->args ? expr->args[0] : 0;
+	
+	if(array->type->kind == BUILDER) {
+		gen_builder_call(expr);
+		return;
+	}
+	
+	if(array->type->kind == MAP) {
+		gen_map_call(expr);
+		return;
+	}
+	
+	switch(expr->dynop) {
+		case DYN_PUSH:
+			if(itemtype->kind == ARRAY)
+				write("jadynarray_append(&%e, %e, 1, ", array, arg);
+			else
+				write(
+					"jadynarray_append(&%e, (%Y[1]){%e}, 1, ",
+					array, itemtype, arg
+				);
+			
+			write("sizeof(%Y))", itemtype);
+			break;
+		case DYN_POP:
+			write(
+				"(*(%y(*)%z)jadynarray_pop(&%e, sizeof(%Y), ",
+				itemtype, itemtype, array, itemtype
+			);
+			
+			gen_check_location(expr);
+			write("))");
+			break;
+		case DYN_RESERVE:
+		case DYN_RESIZE:
+			write(
+				expr->dynop == DYN_RESERVE ?
+					"jadynarray_reserve(&%e, %e, sizeof(%Y), " :
+					"jadynarray_resize(&%e, %e, sizeof(%Y), ",
+				array, arg, itemtype
+			);
+			
+			gen_check_location(expr);
+			write(")");
+			break;
+		case DYN_APPEND:
+			if(arg->type->kind == ARRAY) {
+				write(
+					"jadynarray_append(&%e, %e, %i, sizeof(%Y))",
+					array, arg, arg->type->length, itemtype
+				);
+			}
+			else {
+				write(
+					"jadynarray_append_slice(&%e, %e, sizeof(%Y))",
+					array, arg, itemtype
+				);
+			}
+			
+			break;
+	}
+}
+
 void gen_new(Expr *expr)
 {
-	write("(malloc(sizeof(%Y)))", expr->type->subtype);
+	Expr *allocator = expr->allocator;
+	Type *type = expr->type->subtype;
+	
+	if(!allocator) {
+		write("(ja_alloc(sizeof(%Y)))", type);
+	}
+	else if(allocator->type->kind == ARENA) {
+		write("(jaarena_alloc(&%e, sizeof(%Y)))", allocator, type);
+	}
+	else {
+		write("(japool_alloc(&%e, sizeof(%Y)))", allocator, type);
+	}
 }
 
 void gen_enum_item(Expr *expr)
@@ -218,7 +560,13 @@ void gen_expr(Expr *expr)
 {
 	switch(expr->kind) {
 		case INT:
-			write("%i", expr->value);
+			// C has no literal for INT64_MIN
+			if(expr->type->kind == UINT64)
+				write("%u", expr->value);
+			else if(expr->value == INT64_MIN)
+				write("(-9223372036854775807L - 1)");
+			else
+				write("%i", expr->value);
 			break;
 		case BOOL:
 			write(expr->value ? "jatrue" : "jafalse");
@@ -227,7 +575,12 @@ void gen_expr(Expr *expr)
 			gen_string(expr);
 			break;
 		case VAR:
-			write("%s", expr->decl->private_id);
+			if(expr->decl->kind == VAR && expr->decl->byref)
+				write("(*ap_%t)", expr->decl->id);
+			else if(is_in_header() && is_public(expr->decl))
+				write("%s", expr->decl->public_id);
+			else
+				write("%s", expr->decl->private_id);
 			break;
 		case PTR:
 			write("(&%e)", expr->subexpr);
@@ -268,5 +621,8 @@ void gen_expr(Expr *expr)
 		case COMPLEMENT:
 			write("(~%e)", expr->subexpr);
 			break;
+		case DYNCALL:
+			gen_dyncall(expr);
+			break;
 	}
 }
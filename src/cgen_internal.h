@@ -8,7 +8,12 @@
 #define COL_RESET   "\x1b[0m"
 
 void write(char *msg, ...);
+void write_raw(char *str, int64_t len);
+int64_t get_output_len();
+char *cut_output(int64_t from);
+int64_t get_pass();
 int is_in_header();
+bool is_public(Decl *decl);
 void inc_level();
 void dec_level();
 Unit *get_cur_unit();
@@ -16,10 +21,12 @@ void gen_type_postfix(Type *dtype);
 void gen_type(Type *dtype);
 void gen_init_expr(Expr *expr);
 void gen_expr(Expr *expr);
+void gen_call_into(Expr *expr, Expr *dest);
 void gen_stmt(Stmt *stmt, int noindent);
 void gen_stmts(Stmt **stmts);
 void gen_block(Block *block);
 void gen_vardecl(Decl *decl);
 void gen_mainfuncname(Unit *unit);
+void gen_line(Token *token);
 
 #endif
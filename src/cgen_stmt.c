@@ -3,23 +3,67 @@
 #include "array.h"
 #include "string.h"
 
-static Decl *gen_temp_var(Scope *scope, Type *type, Expr *init)
+static bool inserts_into_map(Expr *expr)
 {
-	static int64_t counter = 0;
-	char buf[256] = {0};
-	int64_t len = sprintf(buf, "tmp%lu", counter);
-	counter++;
-	char *start = malloc(len + 1);
-	strcpy(start, buf);
-	Token *id = create_id(start, len);
-	Decl *decl = new_var(id, scope, id, 0, 0, type, init);
-	decl->private_id = 0;
-	string_append_token(decl->private_id, id);
-	return decl;
+	while(expr->kind == MEMBER || expr->kind == SUBSCRIPT) {
+		if(expr->kind == SUBSCRIPT && expr->inserts) return true;
+		
+		expr = expr->kind == MEMBER ? expr->object : expr->array;
+	}
+	
+	return false;
+}
+
+static void find_map_hazard(Expr *expr, void *ctx)
+{
+	bool *found = ctx;
+	
+	if(
+		expr->kind == CALL || expr->kind == DYNCALL || expr->kind == NEW ||
+		(expr->kind == SUBSCRIPT && expr->array->type->kind == MAP)
+	) {
+		*found = true;
+	}
+}
+
+static void gen_assign(Expr *target, Expr *expr);
+
+/*
+	C may look up the slot of a map item before or after computing the
+	value, but the value may insert into the same map and move its items, or
+	be read from an item that the lookup moves. Such a value goes into a
+	temporary first
+*/
+static bool gen_map_assign(Expr *target, Expr *expr)
+{
+	bool found = false;
+	
+	if(!inserts_into_map(target))
+		return false;
+	
+	walk_expr(expr, find_map_hazard, &found);
+	
+	if(!found)
+		return false;
+	
+	Type *type = expr->type;
+	Decl *tmp = new_temp_var(get_cur_unit()->block->scope, type, expr);
+	Expr *tmp_var = new_var_expr(tmp->start, tmp);
+	write("%>{\n");
+	inc_level();
+	write("%>%y %s%z;\n", type, tmp->private_id, type);
+	gen_assign(tmp_var, expr);
+	gen_assign(target, tmp_var);
+	dec_level();
+	write("%>}\n");
+	return true;
 }
 
 static void gen_assign(Expr *target, Expr *expr)
 {
+	if(gen_map_assign(target, expr))
+		return;
+	
 	if(target->type->kind == ARRAY) {
 		if(expr->kind == ARRAY) {
 			array_for(expr->items, i) {
@@ -42,12 +86,19 @@ static void gen_assign(Expr *target, Expr *expr)
 	}
 }
 
+static void gen_call_in_place(Expr *target, Expr *call)
+{
+	write("%>");
+	gen_call_into(call, target);
+	write(";\n");
+}
+
 static void gen_print(Scope *scope, Expr *expr, int repr)
 {
 	if(expr->type->kind == PTR) {
 		write(
 			"%>if(%e) {\n"
-			INDENT "%>printf(\">\");\n"
+			INDENT "%>japrint_raw(\">\", 1);\n"
 			, expr
 		);
 		
@@ -58,110 +109,96 @@ static void gen_print(Scope *scope, Expr *expr, int repr)
 		write(
 			"%>}\n"
 			"%>else {\n"
-			INDENT "%>printf(\"null\");\n"
+			INDENT "%>japrint_raw(\"null\", 4);\n"
 			"%>}\n"
 		);
 		return;
 	}
 	
 	if(expr->type->kind == STRING) {
-		if(repr) write("%>printf(\"\\\"\");\n");
+		if(repr) write("%>japrint_raw(\"\\\"\", 1);\n");
 		
 		if(expr->kind == STRING) {
 			write(
-				"%>fwrite(\"%S\", 1, %i, stdout);\n",
+				"%>japrint_raw(\"%S\", %i);\n",
 				expr->string, expr->length, expr->length
 			);
 		}
 		else {
-			write(
-				"%>fwrite(%e.string, 1, %e.length, stdout);\n",
-				expr, expr
-			);
+			write("%>japrint_string(%e);\n", expr);
 		}
 		
-		if(repr) write("%>printf(\"\\\"\");\n");
+		if(repr) write("%>japrint_raw(\"\\\"\", 1);\n");
 		return;
 	}
 	else if(expr->type->kind == ARRAY) {
-		write("%>printf(\"[\");\n");
+		write("%>japrint_raw(\"[\", 1);\n");
 		
 		if(expr->kind == ARRAY) {
 			array_for(expr->items, i) {
-				if(i > 0) write("%>printf(\", \");\n");
+				if(i > 0) write("%>japrint_raw(\", \", 2);\n");
 				Expr *item = expr->items[i];
 				gen_print(scope, item, 1);
 			}
 		}
 		else if(expr->type->length >= 0) {
 			Type *type = expr->type;
-			Decl *val_tmp = gen_temp_var(scope, type, expr);
+			Decl *val_tmp = new_temp_var(scope, type, expr);
 			Expr *val_tmp_var = new_var_expr(val_tmp->start, val_tmp);
 			write("%>%y %s%z;\n", type, val_tmp->private_id, type);
-			gen_assign(val_tmp_var, expr);
+			
+			if(expr->kind == CALL)
+				gen_call_in_place(val_tmp_var, expr);
+			else
+				gen_assign(val_tmp_var, expr);
 			
 			for(int64_t i=0; i < type->length; i++) {
-				if(i > 0) write("%>printf(\", \");\n");
+				if(i > 0) write("%>japrint_raw(\", \", 2);\n");
 				Expr *index = new_int_expr(val_tmp_var->start, i);
 				Expr *item = new_subscript_expr(val_tmp_var, index);
 				gen_print(scope, item, 1);
 			}
 		}
 		
-		write("%>printf(\"]\");\n");
+		write("%>japrint_raw(\"]\", 1);\n");
 		return;
 	}
 	
-	write("%>printf(");
-	
 	switch(expr->type->kind) {
 		case INT8:
-			write("\"%%\" PRId8");
-			break;
 		case INT16:
-			write("\"%%\" PRId16");
-			break;
 		case INT32:
-			write("\"%%\" PRId32");
-			break;
 		case INT64:
-			write("\"%%\" PRId64");
+			write("%>japrint_int(%e);\n", expr);
 			break;
 		case UINT8:
-			write("\"%%\" PRIu8");
-			break;
 		case UINT16:
-			write("\"%%\" PRIu16");
-			break;
 		case UINT32:
-			write("\"%%\" PRIu32");
-			break;
 		case UINT64:
-			write("\"%%\" PRIu64");
+			write("%>japrint_uint(%e);\n", expr);
 			break;
 		case BOOL:
-			write("\"%%s\"");
+			write("%>japrint_bool(%e);\n", expr);
 			break;
 		case PTR:
-			write("\"%%p\"");
+			write("%>japrint_ptr(%e);\n", expr);
 			break;
 	}
-	
-	write(", ");
-	
-	if(expr->type->kind == PTR)
-		write("(void*)");
-	
-	gen_expr(expr);
-	
-	if(expr->type->kind == BOOL)
-		write(" ? \"true\" : \"false\"");
-	
-	write(");\n");
 }
 
 static void gen_if(If *ifstmt)
 {
+	if(ifstmt->cond->kind == BOOL) {
+		// constant condition, only the branch taken is left
+		Block *body =
+			ifstmt->cond->value ? ifstmt->if_body : ifstmt->else_body;
+		
+		write("{\n");
+		gen_block(body);
+		write("%>}\n");
+		return;
+	}
+	
 	write("if(%e) {\n", ifstmt->cond);
 	gen_block(ifstmt->if_body);
 	write("%>}\n");
@@ -188,23 +225,24 @@ static void gen_return(Return *returnstmt)
 		Type *type = result->type;
 		
 		if(type->kind == ARRAY) {
-			Token *funcid = returnstmt->scope->funchost->id;
-			
-			if(result->kind == ARRAY) {
-				write("%>return (rt_%I){.a = %E};\n", funcid, result);
+			if(result->kind == CALL) {
+				// construct the result directly in our own slot
+				write("%>return ");
+				gen_call_into(result, 0);
+				write(";\n");
 			}
 			else {
-				write("%>{\n");
-				inc_level();
-				write("%>rt_%I result;\n", funcid);
+				if(result->kind == ARRAY) {
+					write(
+						"%>memcpy(sret, (%Y)%E, sizeof(*sret));\n",
+						type, result
+					);
+				}
+				else {
+					write("%>memcpy(sret, %e, sizeof(*sret));\n", result);
+				}
 				
-				write(
-					"%>memcpy(&result, %e, sizeof(rt_%I));\n", result, funcid
-				);
-				
-				write("%>return result;\n");
-				dec_level();
-				write("%>}\n");
+				write("%>return sret;\n");
 			}
 		}
 		else {
@@ -223,7 +261,10 @@ static void gen_vardecl_stmt(Decl *decl)
 		gen_vardecl(decl);
 		Expr *init = decl->init;
 
-		if(init && init->isconst == 0 && init->type->kind == ARRAY) {
+		if(decl->in_place) {
+			gen_call_in_place(new_var_expr(decl->start, decl), init);
+		}
+		else if(init && init->isconst == 0 && init->type->kind == ARRAY) {
 			gen_assign(new_var_expr(decl->start, decl), init);
 		}
 	}
@@ -239,6 +280,33 @@ static void gen_vardecl_stmt(Decl *decl)
 	}
 }
 
+static void gen_invariants(Decl **invariants)
+{
+	array_for(invariants, i) {
+		gen_vardecl(invariants[i]);
+	}
+}
+
+static void gen_while(While *stmt)
+{
+	if(stmt->invariants) {
+		// the hoisted invariants are only valid once cond held
+		write("%>if(%e) {\n", stmt->entry_cond);
+		inc_level();
+		gen_invariants(stmt->invariants);
+		write("%>do {\n");
+		gen_block(stmt->body);
+		write("%>} while(%e);\n", stmt->cond);
+		dec_level();
+		write("%>}\n");
+	}
+	else {
+		write("%>while(%e) {\n", stmt->cond);
+		gen_block(stmt->body);
+		write("%>}\n");
+	}
+}
+
 static void gen_for(For *stmt)
 {
 	Decl *iter = stmt->iter;
@@ -246,65 +314,183 @@ static void gen_for(For *stmt)
 	Expr *to = stmt->to;
 	Type *itertype = iter->type;
 	
-	write(
-		"%>for("
-			"%y %s%z = %e; "
-			"%s <= %e; "
-			"%s ++) {\n",
-		itertype, iter->private_id, itertype, from,
-		iter->private_id, to,
-		iter->private_id
-	);
+	// the upper bound is evaluated once, before the first iteration
+	if(!to->isconst) {
+		Decl *end = new_temp_var(stmt->body->scope, to->type, to);
+		gen_vardecl(end);
+		to = new_var_expr(end->start, end);
+	}
+	
+	if(stmt->invariants) {
+		write("%>{\n");
+		inc_level();
+		
+		write(
+			"%>%y %s%z = %e;\n",
+			itertype, iter->private_id, itertype, from
+		);
+		
+		write("%>if(%s <= %e) {\n", iter->private_id, to);
+		inc_level();
+		gen_invariants(stmt->invariants);
+		
+		write(
+			"%>for(; %s <= %e; %s ++) {\n",
+			iter->private_id, to, iter->private_id
+		);
+	}
+	else {
+		write(
+			"%>for("
+				"%y %s%z = %e; "
+				"%s <= %e; "
+				"%s ++) {\n",
+			itertype, iter->private_id, itertype, from,
+			iter->private_id, to,
+			iter->private_id
+		);
+	}
 	
 	gen_block(stmt->body);
 	write("%>}\n");
+	
+	if(stmt->invariants) {
+		dec_level();
+		write("%>}\n");
+		dec_level();
+		write("%>}\n");
+	}
 }
 
+/*
+	Lower for-in to a pointer walking from the first to one past the last
+	item; the iterable is evaluated and its length read only once
+*/
 static void gen_foreach(ForEach *foreach)
 {
 	Decl *iter = foreach->iter;
 	Expr *array = foreach->array;
 	Type *type = array->type;
-	Type *itemtype = type->itemtype;
+	Type *itemtype = foreach->byref ? iter->type->subtype : iter->type;
+	Type *cursortype = foreach->byref ? iter->type : new_ptr_type(itemtype);
+	Scope *scope = foreach->body->scope;
+	
+	if(type->kind == STRING)
+		cursortype = new_type(CSTRING);
 	
-	write("%>for(int64_t it_%t = 0; it_%t < ", iter->id, iter->id);
+	write("%>{\n");
+	inc_level();
 	
-	if(type->length == -1 && array->kind == DEREF) {
+	// legacy dynamic arrays are slices behind the deref
+	if(type->kind == ARRAY && type->length == -1 && array->kind == DEREF) {
 		array = array->ptr;
-		write("%e.length; ", array);
-		write("it_%t ++) {\n", iter->id);
-		
+	}
+	
+	if(
+		array->kind != VAR &&
+		(type->kind != ARRAY || array->kind == CALL)
+	) {
+		Decl *tmp = new_temp_var(scope, array->type, array);
+		gen_vardecl_stmt(tmp);
+		array = new_var_expr(tmp->start, tmp);
+	}
+	
+	write("%>%y it_%t%z = ", cursortype, iter->id, cursortype);
+	
+	if(type->kind == STRING) {
+		write("%e.string;\n", array);
+		write("%>%y end_%t%z = ", cursortype, iter->id, cursortype);
+		write("it_%t + %e.length;\n", iter->id, array);
+	}
+	else if(type->kind == ARRAY && type->length >= 0) {
+		write("%e;\n", array);
+		write("%>%y end_%t%z = ", cursortype, iter->id, cursortype);
+		write("it_%t + %i;\n", iter->id, type->length);
+	}
+	else {
+		write("(%y(*)%z)%e.items;\n", itemtype, itemtype, array);
+		write("%>%y end_%t%z = ", cursortype, iter->id, cursortype);
+		write("it_%t + %e.length;\n", iter->id, array);
+	}
+	
+	if(foreach->invariants) {
+		write("%>if(it_%t < end_%t) {\n", iter->id, iter->id);
+		inc_level();
+		gen_invariants(foreach->invariants);
+	}
+	
+	write(
+		"%>for(; it_%t < end_%t; it_%t ++) {\n",
+		iter->id, iter->id, iter->id
+	);
+	
+	if(type->kind == STRING) {
 		write(
-			INDENT "%>%y %s%z = ((%y(*)%z)%e.items)[it_%t];\n",
+			INDENT "%>jastring %s = {1, it_%t};\n",
+			iter->private_id, iter->id
+		);
+	}
+	else if(foreach->byref) {
+		write(
+			INDENT "%>%y %s%z = it_%t;\n",
+			iter->type, iter->private_id, iter->type, iter->id
+		);
+	}
+	else if(itemtype->kind == ARRAY) {
+		write(
+			INDENT "%>%y %s%z;\n"
+			INDENT "%>memcpy(%s, *it_%t, sizeof(%s));\n",
 			itemtype, iter->private_id, itemtype,
-			itemtype, itemtype, array, iter->id
+			iter->private_id, iter->id, iter->private_id
 		);
 	}
 	else {
-		write("%i; ", type->length);
-		write("it_%t ++) {\n", iter->id);
-		
 		write(
-			INDENT "%>%y %s%z = %e[it_%t];\n",
-			itemtype, iter->private_id, itemtype, array, iter->id
+			INDENT "%>%y %s%z = *it_%t;\n",
+			itemtype, iter->private_id, itemtype, iter->id
 		);
 	}
 	
 	gen_block(foreach->body);
 	write("%>}\n");
+	
+	if(foreach->invariants) {
+		dec_level();
+		write("%>}\n");
+	}
+	
+	dec_level();
+	write("%>}\n");
 }
 
 static void gen_delete(Delete *stmt)
 {
-	write("%>free(%e);\n", stmt->expr);
+	Kind kind = stmt->expr->type->kind;
+	
+	if(stmt->allocator)
+		write("%>japool_free(&%e, %e);\n", stmt->allocator, stmt->expr);
+	else if(kind == ARENA)
+		write("%>jaarena_reset(&%e);\n", stmt->expr);
+	else if(kind == POOL)
+		write("%>japool_reset(&%e);\n", stmt->expr);
+	else if(kind == MAP)
+		write("%>jamap_clear(&%e);\n", stmt->expr);
+	else
+		write(
+			"%>ja_free(%e, sizeof(%Y));\n",
+			stmt->expr, stmt->expr->type->subtype
+		);
 }
 
 void gen_stmt(Stmt *stmt, int noindent)
 {
+	// a directive must start its own line, not follow an else
+	if(noindent == 0) gen_line(stmt->start);
+	
 	switch(stmt->kind) {
 		case PRINT:
 			gen_print(stmt->scope, stmt->as_print.expr, 0);
-			write("%>printf(\"\\n\");\n");
+			write("%>japrint_newline();\n");
 			break;
 		case VAR:
 			gen_vardecl_stmt(&stmt->as_decl);
@@ -314,12 +500,17 @@ void gen_stmt(Stmt *stmt, int noindent)
 			gen_if(&stmt->as_if);
 			break;
 		case WHILE:
-			write("%>while(%e) {\n", stmt->as_while.cond);
-			gen_block(stmt->as_while.body);
-			write("%>}\n");
+			gen_while(&stmt->as_while);
 			break;
 		case ASSIGN:
-			gen_assign(stmt->as_assign.target, stmt->as_assign.expr);
+			if(stmt->as_assign.in_place) {
+				gen_call_in_place(
+					stmt->as_assign.target, stmt->as_assign.expr
+				);
+			}
+			else {
+				gen_assign(stmt->as_assign.target, stmt->as_assign.expr);
+			}
 			break;
 		case CALL:
 			write("%>%e;\n", stmt->as_call.call);
@@ -1,5 +1,8 @@
+#include <stdlib.h>
 #include "cgen_internal.h"
 
+static void memoize_type(Type *type);
+
 static void gen_struct_or_enum_type(Type *type)
 {
 	if(type->decl->exported && is_in_header()) {
@@ -23,7 +26,7 @@ static void gen_ptr_type(Type *type)
 	write("*");
 }
 
-void gen_type_postfix(Type *type)
+static void gen_type_postfix_uncached(Type *type)
 {
 	switch(type->kind) {
 		case PTR:
@@ -41,13 +44,8 @@ void gen_type_postfix(Type *type)
 	}
 }
 
-void gen_type(Type *type)
+static void gen_type_uncached(Type *type)
 {
-	if(!type) {
-		write("/* nulltype */");
-		return;
-	}
-	
 	switch(type->kind) {
 		case NONE:
 			write("void");
@@ -88,6 +86,21 @@ void gen_type(Type *type)
 		case SLICE:
 			write("jaslice");
 			break;
+		case DYNARRAY:
+			write("jadynarray");
+			break;
+		case ARENA:
+			write("jaarena");
+			break;
+		case POOL:
+			write("japool");
+			break;
+		case BUILDER:
+			write("jabuilder");
+			break;
+		case MAP:
+			write("jamap");
+			break;
 		case STRUCT:
 			gen_struct_or_enum_type(type);
 			break;
@@ -109,3 +122,46 @@ void gen_type(Type *type)
 			break;
 	}
 }
+
+/*
+	The spelling of a type depends on the unit and on whether the header or
+	the C file is generated, so it is only reused within the same cgen pass
+*/
+static void memoize_type(Type *type)
+{
+	int64_t start = get_output_len();
+	gen_type_uncached(type);
+	char *prefix = cut_output(start);
+	gen_type_postfix_uncached(type);
+	char *postfix = cut_output(start);
+	
+	if(type->cgen_pass) {
+		free(type->c_prefix);
+		free(type->c_postfix);
+	}
+	
+	type->c_prefix = prefix;
+	type->c_postfix = postfix;
+	type->cgen_pass = get_pass();
+}
+
+void gen_type_postfix(Type *type)
+{
+	if(type->cgen_pass != get_pass())
+		memoize_type(type);
+	
+	write_raw(type->c_postfix, strlen(type->c_postfix));
+}
+
+void gen_type(Type *type)
+{
+	if(!type) {
+		write("/* nulltype */");
+		return;
+	}
+	
+	if(type->cgen_pass != get_pass())
+		memoize_type(type);
+	
+	write_raw(type->c_prefix, strlen(type->c_prefix));
+}
@@ -0,0 +1,811 @@
+#include <string.h>
+#include "ctfe.h"
+#include "analyze.h"
+#include "array.h"
+
+/*
+	Compile time function execution
+	
+	An interpreter over the analyzed tree. It knows integral values, enum
+	items, strings and fixed size arrays of those. Anything else it meets,
+	like prints, pointers, writes to variables outside of the evaluated
+	functions or an index out of range, makes the evaluation fail, and the
+	call is left to run time. The steps taken and the array items allocated
+	are bounded, so a long running or endless call can not stall the build.
+*/
+
+#define MAX_STEPS 1000000
+#define MAX_ITEMS 1000000
+#define MAX_DEPTH 256
+
+typedef struct Value {
+	int64_t num; // integral value, enum item value or string length
+	
+	union {
+		EnumItem *item; // enum
+		char *string; // string
+		struct Value *items; // fixed size array
+	};
+} Value;
+
+typedef struct {
+	Decl *decl;
+	Value value;
+} Slot;
+
+typedef enum {
+	EX_NEXT,
+	EX_BREAK,
+	EX_CONTINUE,
+	EX_RETURN,
+	EX_FAIL,
+} Exit;
+
+static Slot *slots; // locals of all active calls
+static uint64_t frame_base; // index of the first slot of the current call
+static Slot *globals; // unwritten outer variables read so far
+static Value **allocations;
+static Value result; // set by return
+static int64_t steps;
+static int64_t items_count;
+static int64_t depth;
+static UnwrittenCheck unwritten;
+
+static bool eval(Expr *expr, Value *out);
+static Exit exec_stmts(Stmt **stmts);
+
+static bool is_value_type(Type *type)
+{
+	if(is_integral_type(type) || type->kind == ENUM || type->kind == STRING)
+		return true;
+	
+	if(type->kind == ARRAY)
+		return type->length >= 0 && is_value_type(type->itemtype);
+	
+	return false;
+}
+
+static bool is_truthy(Value *value)
+{
+	// strings are true when not empty, num holds their length
+	return value->num != 0;
+}
+
+static Value *alloc_items(int64_t length)
+{
+	items_count += length;
+	
+	if(items_count > MAX_ITEMS)
+		return 0;
+	
+	Value *items = malloc(length * sizeof(Value));
+	array_push(allocations, items);
+	return items;
+}
+
+static bool zero_value(Type *type, Value *out)
+{
+	*out = (Value){0};
+	
+	if(!is_value_type(type))
+		return false;
+	
+	if(type->kind == STRING) {
+		out->string = "";
+	}
+	else if(type->kind == ENUM) {
+		array_for(type->decl->items, i) {
+			if(type->decl->items[i]->val->value == 0)
+				out->item = type->decl->items[i];
+		}
+		
+		return out->item != 0;
+	}
+	else if(type->kind == ARRAY) {
+		out->items = alloc_items(type->length);
+		if(!out->items) return false;
+		
+		for(int64_t i = 0; i < type->length; i ++) {
+			if(!zero_value(type->itemtype, &out->items[i]))
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+static bool copy_value(Value *value, Type *type, Value *out)
+{
+	*out = *value;
+	
+	if(type->kind == ARRAY) {
+		out->items = alloc_items(type->length);
+		if(!out->items) return false;
+		
+		for(int64_t i = 0; i < type->length; i ++) {
+			if(!copy_value(&value->items[i], type->itemtype, &out->items[i]))
+				return false;
+		}
+	}
+	
+	return true;
+}
+
+/*
+	Overwrite dest keeping the storage of its arrays, like a memcpy would
+*/
+static void store_value(Value *dest, Value *value, Type *type)
+{
+	if(type->kind == ARRAY) {
+		for(int64_t i = 0; i < type->length; i ++) {
+			store_value(&dest->items[i], &value->items[i], type->itemtype);
+		}
+	}
+	else {
+		*dest = *value;
+	}
+}
+
+static bool from_literal(Expr *expr, Type *type, Value *out)
+{
+	*out = (Value){0};
+	
+	if(!is_value_type(type))
+		return false;
+	
+	switch(expr->kind) {
+		case INT:
+		case BOOL:
+			out->num = expr->value;
+			return true;
+		case ENUM:
+			out->item = expr->item;
+			out->num = expr->item->val->value;
+			return true;
+		case STRING:
+			out->string = expr->string;
+			out->num = expr->length;
+			return true;
+		case ARRAY:
+			if(
+				type->kind != ARRAY ||
+				type->length != array_length(expr->items)
+			) {
+				return false;
+			}
+			
+			out->items = alloc_items(type->length);
+			if(!out->items) return false;
+			
+			array_for(expr->items, i) {
+				if(!from_literal(expr->items[i], type->itemtype, &out->items[i]))
+					return false;
+			}
+			
+			return true;
+	}
+	
+	return false;
+}
+
+static Expr *to_literal(Value *value, Type *type, Token *start)
+{
+	Expr *expr = 0;
+	Expr **items = 0;
+	
+	switch(type->kind) {
+		case BOOL:
+			return new_bool_expr(start, value->num);
+		case ENUM:
+			return new_enum_item_expr(start, type->decl, value->item);
+		case STRING:
+			return new_string_expr(start, value->string, value->num);
+		case ARRAY:
+			for(int64_t i = 0; i < type->length; i ++) {
+				array_push(
+					items, to_literal(&value->items[i], type->itemtype, start)
+				);
+			}
+			
+			expr = new_array_expr(start, items, 1);
+			expr->type = type;
+			return expr;
+	}
+	
+	expr = new_int_expr(start, value->num);
+	expr->type = type;
+	return expr;
+}
+
+static Slot *find_slot(Slot *list, uint64_t base, Decl *decl)
+{
+	for(uint64_t i = array_length(list); i > base; i --) {
+		if(list[i - 1].decl == decl)
+			return &list[i - 1];
+	}
+	
+	return 0;
+}
+
+static bool set_local(Decl *decl, Value *value)
+{
+	Slot *slot = find_slot(slots, frame_base, decl);
+	
+	if(!is_value_type(decl->type))
+		return false;
+	
+	if(slot)
+		slot->value = *value;
+	else
+		array_push(slots, ((Slot){decl, *value}));
+	
+	return true;
+}
+
+static bool is_ref_expr(Expr *expr)
+{
+	if(expr->kind == VAR)
+		return expr->decl->kind == VAR;
+	
+	return
+		expr->kind == SUBSCRIPT && expr->array->type->kind == ARRAY &&
+		is_ref_expr(expr->array);
+}
+
+/*
+	Get the storage of a variable or an item of it. Indexes are evaluated
+	before the variable is looked up, as the lookup might move slots. With
+	for_write set, only locals of the current call are found.
+*/
+static Value *eval_ref(Expr *expr, bool for_write)
+{
+	if(expr->kind == SUBSCRIPT) {
+		Value index;
+		Type *type = expr->array->type;
+		
+		if(type->kind != ARRAY || type->length < 0)
+			return 0;
+		
+		if(!eval(expr->index, &index))
+			return 0;
+		
+		if(index.num < 0 || index.num >= type->length)
+			return 0;
+		
+		Value *array = eval_ref(expr->array, for_write);
+		return array ? &array->items[index.num] : 0;
+	}
+	
+	if(expr->kind != VAR || expr->decl->kind != VAR)
+		return 0;
+	
+	Decl *decl = expr->decl;
+	Slot *slot = find_slot(slots, frame_base, decl);
+	
+	if(slot)
+		return &slot->value;
+	
+	if(for_write)
+		return 0;
+	
+	slot = find_slot(globals, 0, decl);
+	
+	if(slot)
+		return &slot->value;
+	
+	Value value;
+	
+	if(
+		!unwritten(decl) || !decl->init ||
+		!from_literal(decl->init, decl->type, &value)
+	) {
+		return 0;
+	}
+	
+	array_push(globals, ((Slot){decl, value}));
+	return &array_last(globals)->value;
+}
+
+static bool eval_call(Expr *expr, Value *out)
+{
+	Expr *callee = expr->callee;
+	
+	if(callee->kind != VAR || callee->decl->kind != FUNC)
+		return false;
+	
+	Decl *func = callee->decl;
+	
+	if(
+		!func->body || func->imported || func->isproto || func->cfunc ||
+		depth >= MAX_DEPTH
+	) {
+		return false;
+	}
+	
+	Value *args = alloc_items(array_length(expr->args));
+	if(!args) return false;
+	
+	array_for(expr->args, i) {
+		if(!eval(expr->args[i], &args[i]))
+			return false;
+	}
+	
+	uint64_t caller_base = frame_base;
+	frame_base = array_length(slots);
+	
+	array_for(func->params, i) {
+		if(!set_local(func->params[i], &args[i]))
+			return false;
+	}
+	
+	depth ++;
+	Exit exit = exec_stmts(func->body->stmts);
+	depth --;
+	array_resize(slots, frame_base);
+	frame_base = caller_base;
+	
+	if(func->type->returntype->kind == NONE)
+		return exit == EX_NEXT || exit == EX_RETURN;
+	
+	*out = result;
+	return exit == EX_RETURN;
+}
+
+static bool eval_binary(Expr *expr, Value *out)
+{
+	Value left;
+	Value right;
+	Type *ltype = expr->left->type;
+	TokenKind op = expr->operator->kind;
+	
+	if(!eval(expr->left, &left))
+		return false;
+	
+	if(op == TK_AND || op == TK_OR) {
+		if(is_truthy(&left) == (op == TK_OR)) {
+			*out = left;
+			return true;
+		}
+		
+		return eval(expr->right, out);
+	}
+	
+	if(!eval(expr->right, &right))
+		return false;
+	
+	*out = (Value){0};
+	uint64_t l = left.num;
+	uint64_t r = right.num;
+	
+	if(ltype->kind == STRING && op == TK_PLUS) {
+		items_count += left.num + right.num;
+		
+		if(items_count > MAX_ITEMS)
+			return false;
+		
+		char *string = malloc(left.num + right.num + 1);
+		memcpy(string, left.string, left.num);
+		memcpy(string + left.num, right.string, right.num);
+		string[left.num + right.num] = 0;
+		out->string = string;
+		out->num = left.num + right.num;
+		return true;
+	}
+	
+	if(ltype->kind == STRING || ltype->kind == ENUM) {
+		if(op != TK_EQUALS)
+			return false;
+		
+		out->num = left.num == right.num && (
+			ltype->kind == ENUM ||
+			memcmp(left.string, right.string, left.num) == 0
+		);
+		
+		return true;
+	}
+	
+	// unsigned 64 bit values keep their bits in num
+	bool is_unsigned = ltype->kind == UINT64;
+	
+	switch(op) {
+		case TK_PLUS:
+			out->num = l + r;
+			break;
+		case TK_MINUS:
+			out->num = l - r;
+			break;
+		case TK_MUL:
+			out->num = l * r;
+			break;
+		case TK_DSLASH:
+		case TK_MOD:
+			if(
+				right.num == 0 ||
+				right.num == -1 && left.num == INT64_MIN
+			) {
+				return false;
+			}
+			
+			if(op == TK_DSLASH)
+				out->num = left.num / right.num;
+			else
+				out->num = left.num % right.num;
+			break;
+		case TK_AMP:
+			out->num = l & r;
+			break;
+		case TK_PIPE:
+			out->num = l | r;
+			break;
+		case TK_XOR:
+			out->num = l ^ r;
+			break;
+		case TK_EQUALS:
+			out->num = l == r;
+			break;
+		case TK_NEQUALS:
+			out->num = l != r;
+			break;
+		case TK_LOWER:
+			out->num = is_unsigned ? l < r : left.num < right.num;
+			break;
+		case TK_GREATER:
+			out->num = is_unsigned ? l > r : left.num > right.num;
+			break;
+		case TK_LEQUALS:
+			out->num = is_unsigned ? l <= r : left.num <= right.num;
+			break;
+		case TK_GEQUALS:
+			out->num = is_unsigned ? l >= r : left.num >= right.num;
+			break;
+		default:
+			return false;
+	}
+	
+	return true;
+}
+
+static bool eval_subscript(Expr *expr, Value *out)
+{
+	Type *type = expr->array->type;
+	Value array;
+	Value index;
+	
+	if(type->kind == STRING) {
+		if(!eval(expr->array, &array) || !eval(expr->index, &index))
+			return false;
+		
+		if(index.num < 0 || index.num >= array.num)
+			return false;
+		
+		out->string = array.string + index.num;
+		out->num = 1;
+		return true;
+	}
+	
+	if(is_ref_expr(expr)) {
+		Value *item = eval_ref(expr, false);
+		return item && copy_value(item, expr->type, out);
+	}
+	
+	if(type->kind != ARRAY || type->length < 0)
+		return false;
+	
+	if(!eval(expr->index, &index) || !eval(expr->array, &array))
+		return false;
+	
+	if(index.num < 0 || index.num >= type->length)
+		return false;
+	
+	*out = array.items[index.num];
+	return true;
+}
+
+static bool eval(Expr *expr, Value *out)
+{
+	Value *ref = 0;
+	Value value;
+	Expr cast = {0};
+	
+	if(++ steps > MAX_STEPS)
+		return false;
+	
+	*out = (Value){0};
+	
+	switch(expr->kind) {
+		case INT:
+		case BOOL:
+		case ENUM:
+		case STRING:
+		case ARRAY:
+			if(expr->kind != ARRAY)
+				return from_literal(expr, expr->type, out);
+			
+			if(!is_value_type(expr->type))
+				return false;
+			
+			out->items = alloc_items(expr->type->length);
+			if(!out->items) return false;
+			
+			array_for(expr->items, i) {
+				if(!eval(expr->items[i], &out->items[i]))
+					return false;
+			}
+			
+			return true;
+		case VAR:
+			ref = eval_ref(expr, false);
+			return ref && copy_value(ref, expr->type, out);
+		case SUBSCRIPT:
+			return eval_subscript(expr, out);
+		case LENGTH:
+			if(expr->array->type->kind == ARRAY) {
+				out->num = expr->array->type->length;
+				return out->num >= 0;
+			}
+			
+			if(expr->array->type->kind != STRING)
+				return false;
+			
+			return eval(expr->array, out);
+		case BINOP:
+			return eval_binary(expr, out);
+		case CAST:
+			if(
+				!is_integral_type(expr->type) ||
+				!is_integral_type(expr->subexpr->type) ||
+				!eval(expr->subexpr, &value)
+			) {
+				return false;
+			}
+			
+			cast.kind = INT;
+			cast.value = value.num;
+			eval_integral_cast(&cast, expr->type);
+			out->num = cast.value;
+			return true;
+		case NEGATION:
+		case COMPLEMENT:
+			if(!eval(expr->subexpr, &value))
+				return false;
+			
+			if(expr->kind == NEGATION)
+				out->num = -(uint64_t)value.num;
+			else
+				out->num = ~value.num;
+			
+			// C keeps unsigned int operands unsigned
+			if(expr->subexpr->type->kind == UINT32)
+				out->num = (uint32_t)out->num;
+			
+			return true;
+		case CALL:
+			return eval_call(expr, out);
+	}
+	
+	return false;
+}
+
+static Exit exec_loop_body(Block *body)
+{
+	Exit exit = exec_stmts(body->stmts);
+	
+	if(exit == EX_CONTINUE)
+		return EX_NEXT;
+	
+	return exit;
+}
+
+static Exit exec_for(For *forstmt)
+{
+	Value from;
+	Value to;
+	Decl *iter = forstmt->iter;
+	bool is_unsigned = iter->type->kind == UINT64;
+	
+	if(!eval(forstmt->from, &from) || !eval(forstmt->to, &to))
+		return EX_FAIL;
+	
+	if(!set_local(iter, &from))
+		return EX_FAIL;
+	
+	while(true) {
+		Slot *slot = find_slot(slots, frame_base, iter);
+		
+		if(
+			is_unsigned ?
+			(uint64_t)slot->value.num > (uint64_t)to.num :
+			slot->value.num > to.num
+		) {
+			break;
+		}
+		
+		Exit exit = exec_loop_body(forstmt->body);
+		if(exit == EX_BREAK) break;
+		if(exit != EX_NEXT) return exit;
+		
+		if(++ steps > MAX_STEPS)
+			return EX_FAIL;
+		
+		slot = find_slot(slots, frame_base, iter);
+		slot->value.num ++;
+	}
+	
+	return EX_NEXT;
+}
+
+static Exit exec_foreach(ForEach *foreach)
+{
+	Type *type = foreach->array->type;
+	Value array;
+	Value *items = 0;
+	
+	if(foreach->byref)
+		return EX_FAIL;
+	
+	if(type->kind == STRING) {
+		if(!eval(foreach->array, &array))
+			return EX_FAIL;
+		
+		for(int64_t i = 0; i < array.num; i ++) {
+			Value item = {.num = 1, .string = array.string + i};
+			
+			if(!set_local(foreach->iter, &item))
+				return EX_FAIL;
+			
+			Exit exit = exec_loop_body(foreach->body);
+			if(exit == EX_BREAK) break;
+			if(exit != EX_NEXT) return exit;
+		}
+		
+		return EX_NEXT;
+	}
+	
+	if(type->kind != ARRAY || type->length < 0)
+		return EX_FAIL;
+	
+	// the loop walks the storage of a variable, seeing writes to it
+	if(is_ref_expr(foreach->array)) {
+		Value *ref = eval_ref(foreach->array, false);
+		if(!ref) return EX_FAIL;
+		items = ref->items;
+	}
+	else if(eval(foreach->array, &array)) {
+		items = array.items;
+	}
+	else {
+		return EX_FAIL;
+	}
+	
+	for(int64_t i = 0; i < type->length; i ++) {
+		Value item;
+		
+		if(
+			!copy_value(&items[i], type->itemtype, &item) ||
+			!set_local(foreach->iter, &item)
+		) {
+			return EX_FAIL;
+		}
+		
+		Exit exit = exec_loop_body(foreach->body);
+		if(exit == EX_BREAK) break;
+		if(exit != EX_NEXT) return exit;
+	}
+	
+	return EX_NEXT;
+}
+
+static Exit exec_stmt(Stmt *stmt)
+{
+	Value value;
+	Value *ref = 0;
+	Exit exit = EX_NEXT;
+	
+	if(++ steps > MAX_STEPS)
+		return EX_FAIL;
+	
+	switch(stmt->kind) {
+		case VAR:
+			if(stmt->as_decl.init) {
+				if(!eval(stmt->as_decl.init, &value))
+					return EX_FAIL;
+			}
+			else if(!zero_value(stmt->as_decl.type, &value)) {
+				return EX_FAIL;
+			}
+			
+			return set_local(&stmt->as_decl, &value) ? EX_NEXT : EX_FAIL;
+		case ASSIGN:
+			if(!eval(stmt->as_assign.expr, &value))
+				return EX_FAIL;
+			
+			ref = eval_ref(stmt->as_assign.target, true);
+			if(!ref) return EX_FAIL;
+			
+			store_value(ref, &value, stmt->as_assign.target->type);
+			return EX_NEXT;
+		case CALL:
+			return eval(stmt->as_call.call, &value) ? EX_NEXT : EX_FAIL;
+		case IF:
+			if(!eval(stmt->as_if.cond, &value))
+				return EX_FAIL;
+			
+			if(is_truthy(&value))
+				return exec_stmts(stmt->as_if.if_body->stmts);
+			
+			if(stmt->as_if.else_body)
+				return exec_stmts(stmt->as_if.else_body->stmts);
+			
+			return EX_NEXT;
+		case WHILE:
+			while(true) {
+				if(!eval(stmt->as_while.cond, &value))
+					return EX_FAIL;
+				
+				if(!is_truthy(&value))
+					break;
+				
+				exit = exec_loop_body(stmt->as_while.body);
+				if(exit == EX_BREAK) break;
+				if(exit != EX_NEXT) return exit;
+			}
+			
+			return EX_NEXT;
+		case FOR:
+			return exec_for(&stmt->as_for);
+		case FOREACH:
+			return exec_foreach(&stmt->as_foreach);
+		case RETURN:
+			if(stmt->as_return.expr) {
+				if(!eval(stmt->as_return.expr, &value))
+					return EX_FAIL;
+				
+				result = value;
+			}
+			
+			return EX_RETURN;
+		case BREAK:
+			return EX_BREAK;
+		case CONTINUE:
+			return EX_CONTINUE;
+	}
+	
+	return EX_FAIL;
+}
+
+static Exit exec_stmts(Stmt **stmts)
+{
+	array_for(stmts, i) {
+		Exit exit = exec_stmt(stmts[i]);
+		if(exit != EX_NEXT) return exit;
+	}
+	
+	return EX_NEXT;
+}
+
+Expr *ctfe_call(Expr *call, UnwrittenCheck is_unwritten)
+{
+	Expr *literal = 0;
+	Value value;
+	
+	if(!is_value_type(call->type))
+		return 0;
+	
+	unwritten = is_unwritten;
+	steps = 0;
+	items_count = 0;
+	depth = 0;
+	frame_base = 0;
+	array_resize(slots, 0);
+	array_resize(globals, 0);
+	
+	if(eval_call(call, &value))
+		literal = to_literal(&value, call->type, call->start);
+	
+	array_for(allocations, i) {
+		free(allocations[i]);
+	}
+	
+	array_resize(allocations, 0);
+	return literal;
+}
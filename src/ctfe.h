@@ -0,0 +1,21 @@
+#ifndef CTFE_H
+#define CTFE_H
+
+#include <stdbool.h>
+#include "ast.h"
+
+/*
+	Tells if a variable outside of the evaluated functions keeps the value of
+	its initializer for the whole run of the program
+*/
+typedef bool (*UnwrittenCheck)(Decl *decl);
+
+/*
+	Evaluate a call of a function declared in the current unit with literal
+	arguments at compile time. Returns a literal expression holding the
+	result, or 0 if the call can not be evaluated: the function has side
+	effects, uses pointers, slices or structures, traps or takes too long.
+*/
+Expr *ctfe_call(Expr *call, UnwrittenCheck is_unwritten);
+
+#endif
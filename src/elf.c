@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <sys/stat.h>
 #include "elf.h"
 
 static uint64_t round_up_pot(uint64_t v)
@@ -76,30 +77,43 @@ Elf *new_elf()
 	elf->phdr_data.filesz = 0;
 	elf->phdr_data.memsz = 0;
 	elf->phdr_data.align = PAGE_SIZE;
+	return elf;
 }
 
-void *elf_set_text(Elf *elf, void *text, uint64_t size)
+void elf_set_text(Elf *elf, void *text, uint64_t size)
 {
 	elf->text = text;
 	elf->phdr_text.filesz = size;
 	elf->phdr_text.memsz = size;
 }
 
-void *elf_set_rodata(Elf *elf, void *rodata, uint64_t size)
+void elf_set_rodata(Elf *elf, void *rodata, uint64_t size)
 {
 	elf->rodata = rodata;
 	elf->phdr_rodata.filesz = size;
 	elf->phdr_rodata.memsz = size;
 }
 
-void *elf_set_data(Elf *elf, void *data, uint64_t size)
+void elf_set_data(Elf *elf, void *data, uint64_t size)
 {
 	elf->data = data;
 	elf->phdr_data.filesz = size;
 	elf->phdr_data.memsz = size;
 }
 
-void *elf_save(Elf *elf, char *filename)
+/*
+	Zeroed memory following data, it takes no space in the file
+*/
+void elf_set_bss(Elf *elf, uint64_t size)
+{
+	elf->phdr_data.memsz = elf->phdr_data.filesz + size;
+}
+
+/*
+	Place rodata and data on the pages after text, their addresses are known
+	from then on
+*/
+void elf_layout(Elf *elf)
 {
 	elf->phdr_rodata.offset = elf->phdr_text.offset + elf->phdr_text.filesz;
 	elf->phdr_rodata.offset = align_up_page(elf->phdr_rodata.offset);
@@ -110,8 +124,14 @@ void *elf_save(Elf *elf, char *filename)
 	elf->phdr_data.offset = align_up_page(elf->phdr_data.offset);
 	elf->phdr_data.vaddr = BASE_ADDR + elf->phdr_data.offset;
 	elf->phdr_data.paddr = elf->phdr_data.vaddr;
+}
+
+int elf_save(Elf *elf, char *filename)
+{
+	elf_layout(elf);
 	
 	FILE *fs = fopen(filename, "wb");
+	if(!fs) return -1;
 	fwrite(&elf->hdr, 1, sizeof(elf->hdr), fs);
 	fwrite(&elf->phdr_text, 1, sizeof(elf->phdr_text), fs);
 	fwrite(&elf->phdr_rodata, 1, sizeof(elf->phdr_rodata), fs);
@@ -123,4 +143,5 @@ void *elf_save(Elf *elf, char *filename)
 	for(uint64_t i = ftell(fs); i < elf->phdr_data.offset; i++) fputc(0, fs);
 	fwrite(elf->data, 1, elf->phdr_data.filesz, fs);
 	fclose(fs);
+	return chmod(filename, 0755);
 }
@@ -96,9 +96,11 @@ typedef struct {
 } Elf;
 
 Elf *new_elf();
-void *elf_set_text(Elf *elf, void *text, uint64_t size);
-void *elf_set_rodata(Elf *elf, void *rodata, uint64_t size);
-void *elf_set_data(Elf *elf, void *data, uint64_t size);
-void *elf_save(Elf *elf, char *filename);
+void elf_set_text(Elf *elf, void *text, uint64_t size);
+void elf_set_rodata(Elf *elf, void *rodata, uint64_t size);
+void elf_set_data(Elf *elf, void *data, uint64_t size);
+void elf_set_bss(Elf *elf, uint64_t size);
+void elf_layout(Elf *elf);
+int elf_save(Elf *elf, char *filename);
 
 #endif
@@ -185,7 +185,11 @@ Token *lex(char *src, int64_t src_len)
 			char *start_linep = linep;
 			pos ++;
 			char *str_start = pos;
-			while(pos < src_end && *pos != '"') pos ++;
+			
+			while(pos < src_end && *pos != '"') {
+				if(*pos == '\\' && pos + 1 < src_end) pos ++;
+				pos ++;
+			}
 			
 			if(pos == src_end) {
 				print_error(
@@ -196,9 +200,53 @@ Token *lex(char *src, int64_t src_len)
 				exit(EXIT_FAILURE);
 			}
 			
-			int64_t length = pos - str_start;
-			char *buf = malloc(length + 1);
-			memcpy(buf, str_start, length);
+			char *buf = malloc(pos - str_start + 1);
+			int64_t length = 0;
+			
+			// escapes are decoded here, the backends only see the bytes
+			for(char *p = str_start; p < pos; p ++) {
+				if(*p != '\\') {
+					buf[length ++] = *p;
+					continue;
+				}
+				
+				p ++;
+				
+				switch(*p) {
+					case 'n':
+						buf[length ++] = '\n';
+						break;
+					case 't':
+						buf[length ++] = '\t';
+						break;
+					case 'r':
+						buf[length ++] = '\r';
+						break;
+					case '0':
+						buf[length ++] = '\0';
+						break;
+					case '\\':
+					case '"':
+					case '\'':
+						buf[length ++] = *p;
+						break;
+					case 'x':
+						if(p + 2 < pos && isxdigit(p[1]) && isxdigit(p[2])) {
+							buf[length ++] = hex2int(p[1]) << 4 | hex2int(p[2]);
+							p += 2;
+							break;
+						}
+						// fallthrough
+					default:
+						print_error(
+							line, linep, src_end, p - 1,
+							"unknown escape sequence"
+						);
+						
+						exit(EXIT_FAILURE);
+				}
+			}
+			
 			buf[length] = 0;
 			pos ++;
 			emit(TK_STRING);
@@ -5,9 +5,12 @@
 #include <string.h>
 
 #define KEYWORDS(_) \
+	_(arena) \
 	_(as) \
 	_(bool) \
 	_(break) \
+	_(builder) \
+	_(const) \
 	_(continue) \
 	_(cstring) \
 	_(delete) \
@@ -22,14 +25,18 @@
 	_(if) \
 	_(import) \
 	_(in) \
+	_(inline) \
 	_(int) \
 	_(int8) \
 	_(int16) \
 	_(int32) \
 	_(int64) \
+	_(map) \
 	_(new) \
+	_(pool) \
 	_(print) \
 	_(ptr) \
+	_(static) \
 	_(string) \
 	_(struct) \
 	_(return) \
@@ -5,13 +5,9 @@
 #include <dlfcn.h>
 #include "print.h"
 #include "build.h"
+#include "native.h"
 #include "string.h"
 
-/*
-#include "asm.h"
-#include "elf.h"
-*/
-
 #define COL_YELLOW  "\x1b[38;2;255;255;0m"
 #define COL_RESET   "\x1b[0m"
 
@@ -41,6 +37,33 @@ static void parse_args(int argc, char **argv)
 		else if(strcmp(argv[i], "-sa") == 0) {
 			build_options.show_ast = true;
 		}
+		else if(strcmp(argv[i], "-pipe") == 0) {
+			build_options.pipe_c = true;
+		}
+		else if(strcmp(argv[i], "-kc") == 0) {
+			build_options.keep_c = true;
+		}
+		else if(strcmp(argv[i], "-bc") == 0) {
+			build_options.bounds_check = true;
+		}
+		else if(strcmp(argv[i], "-inl") == 0) {
+			build_options.inline_calls = true;
+		}
+		else if(strcmp(argv[i], "-g") == 0) {
+			build_options.debug_info = true;
+		}
+		else if(strcmp(argv[i], "--backend=native") == 0) {
+			build_options.native = true;
+		}
+		else if(strcmp(argv[i], "--backend=c") == 0) {
+			build_options.native = false;
+		}
+		else if(strcmp(argv[i], "--jit") == 0) {
+			build_options.jit = true;
+		}
+		else if(strcmp(argv[i], "-malloc") == 0) {
+			build_options.system_malloc = true;
+		}
 		else if(compile_only && build_options.outfilename == 0) {
 			build_options.outfilename = argv[i];
 		}
@@ -55,22 +78,18 @@ static void parse_args(int argc, char **argv)
 	if(compile_only && build_options.outfilename == 0)
 		error("no output filename");
 	
+	if(compile_only && build_options.jit)
+		error("--jit runs the program in memory and can not be used with -c");
+	
+	if(build_options.jit)
+		build_options.native = true;
+	
 	if(build_options.main_filename == 0)
 		error("no input file");
 }
 
 int main(int argc, char *argv[])
 {
-	/*
-	Elf *elf = new_elf();
-	asm_start();
-	asm_mov_r32_i32(0, 60);
-	asm_mov_r32_i32(7, 1);
-	asm_syscall();
-	elf_set_text(elf, asm_get_text(), asm_get_text_size());
-	elf_save(elf, "test");
-	*/
-	
 	#ifdef JA_DEBUG
 	build_options.show_tokens = true;
 	build_options.show_ast = true;
@@ -79,6 +98,12 @@ int main(int argc, char *argv[])
 	parse_args(argc, argv);
 	Project *project = build(build_options);
 	
+	if(build_options.jit) {
+		int status = jit_native(project->units, prog_argc, prog_argv);
+		if(status < 0) error("could not map memory for the program");
+		return status;
+	}
+	
 	if(!compile_only) {
 		char *cmd = 0;
 		string_append(cmd, project->exe_filename);
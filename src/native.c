@@ -0,0 +1,2038 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+#include "native.h"
+#include "asm.h"
+#include "elf.h"
+#include "array.h"
+#include "string.h"
+#include "parse_internal.h"
+
+/*
+	Native backend
+	
+	Every expression leaves its value in rax, or the address of its value
+	if the value is a string, slice, array, struct or union. Intermediate
+	results are pushed, locals and temporaries have their own slot in the
+	stack frame. Arguments are pushed from right to left as 64 bit words,
+	aggregates by address: the caller passes a copy unless the parameter is
+	byref. Aggregate results are written to a slot whose address is pushed
+	last. Printing goes through a few routines emitted before the program,
+	the memory for new is a reserved region that is never given back.
+	
+	The same code can run in memory instead of being written to a file. The
+	entry point is then called like a C function and returns the exit
+	status, and foreign functions and variables are looked up with dlsym
+	before the program starts and called with the C calling convention.
+*/
+
+#define PRINT_BUF_SIZE 65536
+#define HEAP_SIZE 0x1000000000
+
+#define SYS_WRITE 1
+#define SYS_MMAP 9
+#define SYS_IOCTL 16
+#define SYS_EXIT_GROUP 231
+#define TCGETS 0x5401
+#define PROT_RW 0x3
+#define MAP_HEAP 0x4022 // private, anonymous, noreserve
+
+typedef enum {
+	SEG_TEXT,
+	SEG_RODATA,
+	SEG_DATA,
+	SEG_BSS,
+} Segment;
+
+/*
+	The absolute address of offset in seg, to be written to pos in text as
+	imm32 or in data as 64 bit word once the segments are placed
+*/
+typedef struct {
+	Segment where;
+	uint64_t pos;
+	Segment seg;
+	uint64_t offset;
+} Fixup;
+
+/*
+	The rel32 of a call at pos to a routine that might not be placed yet
+*/
+typedef struct {
+	uint64_t pos;
+	int64_t *target;
+} CallFixup;
+
+typedef struct {
+	uint64_t *breaks;
+	uint64_t *continues;
+} Loop;
+
+static Unit **units;
+static Unit *cur_unit;
+static bool jit;
+static uint8_t *rodata;
+static uint8_t *data;
+static Fixup *fixups;
+static CallFixup *call_fixups;
+static int64_t *unit_mains;
+static uint64_t *unit_flags;
+
+// runtime state in data and bss
+static uint64_t print_len;
+static uint64_t print_linebuf;
+static uint64_t print_fd;
+static uint64_t heap_next;
+static uint64_t print_buf;
+static uint64_t jit_rsp;
+static uint64_t jit_fflush;
+
+// runtime routines
+static uint64_t rt_write;
+static uint64_t rt_flush;
+static uint64_t rt_print_uint;
+static uint64_t rt_print_int;
+static uint64_t rt_print_bool;
+static uint64_t rt_newline;
+static uint64_t rt_bounds_fail;
+static uint64_t rt_exit;
+
+// function being generated
+static int64_t frame_size;
+static uint64_t frame_patch;
+static uint64_t *returns;
+static Loop *loops;
+
+static void n_expr(Expr *expr);
+static void n_addr(Expr *expr);
+static void n_block(Block *block);
+
+static void unsupported(Token *at, char *what)
+{
+	if(at) {
+		fatal_at(at, "%s not supported by the native backend", what);
+	}
+	
+	print_error(0, 0, 0, 0, "%s not supported by the native backend", what);
+	exit(EXIT_FAILURE);
+}
+
+static uint64_t here()
+{
+	return asm_get_text_size();
+}
+
+static int64_t align_up(int64_t value, int64_t align)
+{
+	return (value + align - 1) / align * align;
+}
+
+/*
+	Types, laid out as the C compiler would
+*/
+
+static bool is_aggregate(Type *type)
+{
+	switch(type->kind) {
+		case STRING:
+		case SLICE:
+		case DYNARRAY:
+		case ARENA:
+		case POOL:
+		case BUILDER:
+		case MAP:
+		case ARRAY:
+		case STRUCT:
+		case UNION:
+			return true;
+	}
+	
+	return false;
+}
+
+static bool is_signed(Type *type)
+{
+	switch(type->kind) {
+		case INT8:
+		case INT16:
+		case INT32:
+		case INT64:
+		case ENUM:
+			return true;
+	}
+	
+	return false;
+}
+
+static int64_t type_size(Type *type);
+
+static int64_t type_align(Type *type)
+{
+	if(type->kind == ARRAY) {
+		return type_align(type->itemtype);
+	}
+	else if(type->kind == STRUCT || type->kind == UNION) {
+		Decl **members = type->decl->members;
+		int64_t align = 1;
+		
+		array_for(members, i) {
+			int64_t member_align = type_align(members[i]->type);
+			if(member_align > align) align = member_align;
+		}
+		
+		return align;
+	}
+	else if(
+		type->kind == STRING || type->kind == SLICE ||
+		type->kind == DYNARRAY || type->kind == ARENA ||
+		type->kind == POOL || type->kind == BUILDER || type->kind == MAP
+	) {
+		return 8;
+	}
+	
+	return type_size(type);
+}
+
+static int64_t type_size(Type *type)
+{
+	switch(type->kind) {
+		case INT8:
+		case UINT8:
+		case BOOL:
+			return 1;
+		case INT16:
+		case UINT16:
+			return 2;
+		case INT32:
+		case UINT32:
+		case ENUM:
+			return 4;
+		case INT64:
+		case UINT64:
+		case CSTRING:
+		case PTR:
+		case FUNC:
+			return 8;
+		case STRING:
+		case SLICE:
+			return 16;
+		case DYNARRAY:
+		case BUILDER:
+			return 24;
+		case ARENA:
+			return 32;
+		case POOL:
+		case MAP:
+			return 40;
+		case ARRAY:
+			return type->length * type_size(type->itemtype);
+	}
+	
+	if(type->kind == STRUCT || type->kind == UNION) {
+		Decl **members = type->decl->members;
+		int64_t size = 0;
+		
+		array_for(members, i) {
+			Type *member_type = members[i]->type;
+			int64_t member_size = type_size(member_type);
+			
+			if(type->kind == UNION) {
+				if(member_size > size) size = member_size;
+			}
+			else {
+				size = align_up(size, type_align(member_type)) + member_size;
+			}
+		}
+		
+		return align_up(size, type_align(type));
+	}
+	
+	return 0;
+}
+
+static int64_t member_offset(Decl *decl, Decl *member)
+{
+	Decl **members = decl->members;
+	int64_t offset = 0;
+	
+	if(decl->kind == UNION)
+		return 0;
+	
+	array_for(members, i) {
+		offset = align_up(offset, type_align(members[i]->type));
+		if(members[i] == member) break;
+		offset += type_size(members[i]->type);
+	}
+	
+	return offset;
+}
+
+/*
+	Segments
+*/
+
+static uint64_t put_zeros(uint8_t **segment, int64_t size, int64_t align)
+{
+	uint64_t length = array_length(*segment);
+	uint64_t offset = align_up(length, align);
+	array_resize(*segment, offset + size);
+	memset(*segment + length, 0, offset + size - length);
+	return offset;
+}
+
+// zero terminated, so it serves as cstring too
+static uint64_t put_string(char *string, int64_t length)
+{
+	uint64_t offset = put_zeros(&rodata, length + 1, 1);
+	memcpy(rodata + offset, string, length);
+	return offset;
+}
+
+static void put_fixup(Segment where, uint64_t pos, Segment seg, uint64_t offset)
+{
+	Fixup fixup = {where, pos, seg, offset};
+	array_push(fixups, fixup);
+}
+
+static void put_static(uint64_t offset, Expr *init)
+{
+	Type *type = init->type;
+	int64_t value = init->value;
+	
+	switch(init->kind) {
+		case ENUM:
+			value = init->item->val->value;
+			// fallthrough
+		case INT:
+		case BOOL:
+			memcpy(data + offset, &value, type_size(type));
+			break;
+		case STRING:
+			memcpy(data + offset, &init->length, 8);
+			
+			put_fixup(
+				SEG_DATA, offset + 8,
+				SEG_RODATA, put_string(init->string, init->length)
+			);
+			break;
+		case CSTRING:
+			put_fixup(
+				SEG_DATA, offset,
+				SEG_RODATA, put_string(init->string, strlen(init->string))
+			);
+			break;
+		case ARRAY:
+			array_for(init->items, i) {
+				put_static(
+					offset + i * type_size(type->itemtype), init->items[i]
+				);
+			}
+			break;
+		default:
+			unsupported(init->start, "initializer");
+	}
+}
+
+// struct members get their initializers, anything else stays zero
+static void put_static_default(uint64_t offset, Type *type)
+{
+	if(type->kind != STRUCT)
+		return;
+	
+	Decl *decl = type->decl;
+	
+	array_for(decl->members, i) {
+		Decl *member = decl->members[i];
+		uint64_t member_pos = offset + member_offset(decl, member);
+		
+		if(member->init)
+			put_static(member_pos, member->init);
+		else
+			put_static_default(member_pos, member->type);
+	}
+}
+
+static void put_globals(Unit *unit)
+{
+	Decl **decls = unit->block->scope->decls;
+	
+	array_for(decls, i) {
+		Decl *decl = decls[i];
+		
+		if(decl->kind != VAR || decl->imported || !decl->reachable)
+			continue;
+		
+		decl->onstack = 0;
+		decl->offset = put_zeros(&data, type_size(decl->type), 8);
+		
+		if(decl->init && decl->init->isconst)
+			put_static(decl->offset, decl->init);
+		else if(!decl->init)
+			put_static_default(decl->offset, decl->type);
+	}
+}
+
+// foreign functions have no code here, only a slot for their address
+static void put_foreigns(Unit *unit)
+{
+	Foreign **foreigns = unit->block->scope->foreigns;
+	
+	array_for(foreigns, i) {
+		Decl **decls = foreigns[i]->decls;
+		
+		array_for(decls, j) {
+			Decl *decl = decls[j];
+			
+			if(decl->kind == FUNC && decl->reachable) {
+				decl->onstack = 0;
+				decl->offset = put_zeros(&data, 8, 8);
+			}
+		}
+	}
+}
+
+/*
+	Code helpers
+*/
+
+// load the absolute address of offset in seg
+static void n_abs(Register r, Segment seg, uint64_t offset)
+{
+	put_fixup(SEG_TEXT, asm_mov_r32_i32(r, 0), seg, offset);
+}
+
+static void n_call_to(uint64_t target)
+{
+	asm_patch_rel32(asm_call(), target);
+}
+
+static void n_call_later(int64_t *target)
+{
+	CallFixup fixup = {asm_call(), target};
+	array_push(call_fixups, fixup);
+}
+
+static int32_t n_slot(int64_t size)
+{
+	frame_size = align_up(frame_size + size, 8);
+	return -frame_size;
+}
+
+static void n_write_raw(char *string, int64_t length)
+{
+	n_abs(RSI, SEG_RODATA, put_string(string, length));
+	asm_mov_r64_i64(RDX, length);
+	n_call_to(rt_write);
+}
+
+// copy the value at rax to rdi
+static void n_copy(int64_t size)
+{
+	asm_mov_r64_r64(RSI, RAX);
+	asm_mov_r64_i64(RCX, size);
+	asm_rep_movsb();
+}
+
+// replace an address in rax by the value there, unless it is an aggregate
+static void n_load(Type *type)
+{
+	if(!is_aggregate(type))
+		asm_load(RAX, RAX, 0, type_size(type), is_signed(type));
+}
+
+// store the value in rax to the address in rdi
+static void n_store(Type *type)
+{
+	if(is_aggregate(type))
+		n_copy(type_size(type));
+	else
+		asm_store(RDI, 0, RAX, type_size(type));
+}
+
+static bool is_indirect(Decl *decl)
+{
+	return decl->isparam && (decl->byref || is_aggregate(decl->type));
+}
+
+static void n_var_addr(Register r, Decl *decl)
+{
+	decl = original_decl(decl);
+	
+	if(!decl->onstack)
+		n_abs(r, SEG_DATA, decl->offset);
+	else if(is_indirect(decl))
+		asm_load(r, RBP, decl->offset, 8, false);
+	else
+		asm_lea(r, RBP, decl->offset);
+}
+
+static void n_local(Decl *decl)
+{
+	decl->onstack = 1;
+	decl->offset = n_slot(type_size(decl->type));
+}
+
+// store the member initializers of a zeroed struct at [rsp]
+static void n_struct_defaults(Type *type, int64_t offset)
+{
+	if(type->kind != STRUCT)
+		return;
+	
+	Decl *decl = type->decl;
+	
+	array_for(decl->members, i) {
+		Decl *member = decl->members[i];
+		int64_t member_pos = offset + member_offset(decl, member);
+		
+		if(member->init) {
+			n_expr(member->init);
+			asm_load(RDI, RSP, 0, 8, false);
+			asm_alu_r64_i32(ALU_ADD, RDI, member_pos);
+			n_store(member->type);
+		}
+		else {
+			n_struct_defaults(member->type, member_pos);
+		}
+	}
+}
+
+// default value at the address in rdi
+static void n_default(Type *type)
+{
+	asm_push(RDI);
+	asm_mov_r64_i64(RAX, 0);
+	asm_mov_r64_i64(RCX, type_size(type));
+	asm_rep_stosb();
+	n_struct_defaults(type, 0);
+	asm_pop(RDI);
+}
+
+static void n_init(Decl *decl)
+{
+	if(decl->init) {
+		n_expr(decl->init);
+		asm_lea(RDI, RBP, decl->offset);
+		n_store(decl->type);
+	}
+	else {
+		asm_lea(RDI, RBP, decl->offset);
+		n_default(decl->type);
+	}
+}
+
+/*
+	Trap if the index in rax is not below the length in rcx
+*/
+static void n_check(Expr *expr)
+{
+	char line[32];
+	sprintf(line, ":%" PRId64, expr->start ? expr->start->line : 0);
+	char *where = string_concat(cur_unit->src_filename, line, 0);
+	int64_t length = strlen(where);
+	
+	asm_alu_r64_r64(ALU_CMP, RAX, RCX);
+	uint64_t ok = asm_jcc(CC_B);
+	n_abs(RSI, SEG_RODATA, put_string(where, length));
+	asm_mov_r64_i64(RDX, length);
+	n_call_to(rt_bounds_fail);
+	asm_patch_rel32(ok, here());
+}
+
+/*
+	Expressions
+*/
+
+static void n_string(char *string, int64_t length)
+{
+	int32_t slot = n_slot(16);
+	asm_mov_r64_i64(RAX, length);
+	asm_store(RBP, slot, RAX, 8);
+	n_abs(RAX, SEG_RODATA, put_string(string, length));
+	asm_store(RBP, slot + 8, RAX, 8);
+	asm_lea(RAX, RBP, slot);
+}
+
+static void n_cast(Expr *expr)
+{
+	Type *type = expr->type;
+	Expr *srcexpr = expr->subexpr;
+	Type *srctype = srcexpr->type;
+	n_expr(srcexpr);
+	
+	if(type->kind == BOOL && !is_aggregate(srctype)) {
+		asm_test_r64_r64(RAX, RAX);
+		asm_setcc(CC_NE, RAX);
+	}
+	else if(srctype->kind == STRING && type->kind == CSTRING) {
+		asm_load(RAX, RAX, 8, 8, false);
+	}
+	else if(type->kind == SLICE && is_array_ptr_type(srctype)) {
+		int32_t slot = n_slot(16);
+		asm_store(RBP, slot + 8, RAX, 8);
+		asm_mov_r64_i64(RAX, srctype->subtype->length);
+		asm_store(RBP, slot, RAX, 8);
+		asm_lea(RAX, RBP, slot);
+	}
+	else if(type->kind == SLICE && srctype->kind == DYNARRAY) {
+		// a growable array starts like a slice, its address serves as one
+	}
+	else if(is_integral_type(srctype) && is_integral_type(type)) {
+		asm_extend(RAX, type_size(type), is_signed(type));
+	}
+	else if(srctype->kind != PTR || type->kind != PTR) {
+		unsupported(expr->start, "cast");
+	}
+}
+
+/*
+	Address of an array or slice item
+*/
+static void n_item_addr(Expr *expr)
+{
+	Expr *array = expr->array;
+	Type *type = array->type;
+	
+	if(type->kind == ARRAY && type->length < 0)
+		unsupported(expr->start, "dynamic array");
+	
+	if(type->kind == MAP)
+		unsupported(expr->start, "maps");
+	
+	if(type->kind == SLICE || type->kind == DYNARRAY) {
+		n_expr(array);
+		asm_load(RCX, RAX, 0, 8, false);
+		asm_load(RAX, RAX, 8, 8, false);
+	}
+	else {
+		n_addr(array);
+		asm_mov_r64_i64(RCX, type->length);
+	}
+	
+	asm_push(RAX);
+	asm_push(RCX);
+	n_expr(expr->index);
+	asm_pop(RCX);
+	if(expr->needs_check) n_check(expr);
+	asm_mov_r64_i64(RCX, type_size(type->itemtype));
+	asm_imul_r64_r64(RAX, RCX);
+	asm_pop(RCX);
+	asm_alu_r64_r64(ALU_ADD, RAX, RCX);
+}
+
+// a subscripted string is the string of the one char
+static void n_string_item(Expr *expr)
+{
+	n_expr(expr->array);
+	asm_push(RAX);
+	n_expr(expr->index);
+	asm_pop(RDX);
+	
+	if(expr->needs_check) {
+		asm_load(RCX, RDX, 0, 8, false);
+		n_check(expr);
+	}
+	
+	asm_load(RDX, RDX, 8, 8, false);
+	asm_alu_r64_r64(ALU_ADD, RDX, RAX);
+	int32_t slot = n_slot(16);
+	asm_store(RBP, slot + 8, RDX, 8);
+	asm_mov_r64_i64(RAX, 1);
+	asm_store(RBP, slot, RAX, 8);
+	asm_lea(RAX, RBP, slot);
+}
+
+static void n_member_addr(Expr *expr)
+{
+	Expr *object = expr->object;
+	n_addr(object);
+	
+	asm_alu_r64_i32(
+		ALU_ADD, RAX, member_offset(object->type->decl, expr->member)
+	);
+}
+
+// set the flags for the truth of the value in rax
+static void n_test(Expr *expr)
+{
+	Type *type = expr->type;
+	
+	if(type->kind == STRING) {
+		asm_load(RCX, RAX, 0, 8, false);
+		asm_test_r64_r64(RCX, RCX);
+	}
+	else if(is_aggregate(type)) {
+		unsupported(expr->start, "truth value of this type");
+	}
+	else {
+		asm_test_r64_r64(RAX, RAX);
+	}
+}
+
+// the left operand is yielded when it decides the result
+static void n_logic_op(Expr *expr)
+{
+	n_expr(expr->left);
+	n_test(expr->left);
+	uint64_t done = asm_jcc(expr->operator->kind == TK_AND ? CC_E : CC_NE);
+	n_expr(expr->right);
+	asm_patch_rel32(done, here());
+}
+
+// compare the strings at rdi and rax
+static void n_string_equ()
+{
+	asm_mov_r64_r64(RSI, RAX);
+	asm_load(RCX, RDI, 0, 8, false);
+	asm_load(RDX, RSI, 0, 8, false);
+	asm_alu_r64_r64(ALU_CMP, RCX, RDX);
+	uint64_t differ = asm_jcc(CC_NE);
+	asm_load(RSI, RSI, 8, 8, false);
+	asm_load(RDI, RDI, 8, 8, false);
+	asm_repe_cmpsb();
+	asm_patch_rel32(differ, here());
+	asm_setcc(CC_E, RAX);
+}
+
+static Cond compare_cond(TokenKind op, bool isunsigned)
+{
+	switch(op) {
+		case TK_EQUALS:
+			return CC_E;
+		case TK_NEQUALS:
+			return CC_NE;
+		case TK_LOWER:
+			return isunsigned ? CC_B : CC_L;
+		case TK_GREATER:
+			return isunsigned ? CC_A : CC_G;
+		case TK_LEQUALS:
+			return isunsigned ? CC_BE : CC_LE;
+	}
+	
+	return isunsigned ? CC_AE : CC_GE;
+}
+
+static void n_binop(Expr *expr)
+{
+	TokenKind op = expr->operator->kind;
+	Type *ltype = expr->left->type;
+	
+	if(op == TK_AND || op == TK_OR) {
+		n_logic_op(expr);
+		return;
+	}
+	
+	if(ltype->kind == STRING && op == TK_PLUS)
+		unsupported(expr->start, "string concatenation");
+	
+	n_expr(expr->left);
+	asm_push(RAX);
+	n_expr(expr->right);
+	
+	if(ltype->kind == STRING) {
+		asm_pop(RDI);
+		n_string_equ();
+		return;
+	}
+	
+	asm_mov_r64_r64(RCX, RAX);
+	asm_pop(RAX);
+	
+	switch(op) {
+		case TK_PLUS:
+			asm_alu_r64_r64(ALU_ADD, RAX, RCX);
+			break;
+		case TK_MINUS:
+			asm_alu_r64_r64(ALU_SUB, RAX, RCX);
+			break;
+		case TK_PIPE:
+			asm_alu_r64_r64(ALU_OR, RAX, RCX);
+			break;
+		case TK_XOR:
+			asm_alu_r64_r64(ALU_XOR, RAX, RCX);
+			break;
+		case TK_AMP:
+			asm_alu_r64_r64(ALU_AND, RAX, RCX);
+			break;
+		case TK_MUL:
+			asm_imul_r64_r64(RAX, RCX);
+			break;
+		case TK_DSLASH:
+			asm_cqo();
+			asm_idiv_r64(RCX);
+			break;
+		case TK_MOD:
+			asm_cqo();
+			asm_idiv_r64(RCX);
+			asm_mov_r64_r64(RAX, RDX);
+			break;
+		default:
+			asm_alu_r64_r64(ALU_CMP, RAX, RCX);
+			asm_setcc(compare_cond(op, ltype->kind == UINT64), RAX);
+	}
+}
+
+static void n_array(Expr *expr)
+{
+	Type *itemtype = expr->type->itemtype;
+	int64_t itemsize = type_size(itemtype);
+	int32_t slot = n_slot(type_size(expr->type));
+	
+	array_for(expr->items, i) {
+		n_expr(expr->items[i]);
+		asm_lea(RDI, RBP, slot + i * itemsize);
+		n_store(itemtype);
+	}
+	
+	asm_lea(RAX, RBP, slot);
+}
+
+// values the callee can not write to without them being copied
+static bool is_fresh(Expr *expr)
+{
+	switch(expr->kind) {
+		case STRING:
+		case ARRAY:
+		case CALL:
+		case CAST:
+			return true;
+		case SUBSCRIPT:
+			return expr->array->type->kind == STRING;
+	}
+	
+	return false;
+}
+
+static void n_arg(Expr *arg, Decl *param)
+{
+	Type *type = arg->type;
+	
+	if(!is_indirect(param)) {
+		n_expr(arg);
+		return;
+	}
+	
+	if(param->byref && arg->islvalue) {
+		n_addr(arg);
+		return;
+	}
+	
+	n_expr(arg);
+	
+	if(is_aggregate(type) && (param->byref || is_fresh(arg)))
+		return;
+	
+	// the callee gets its own copy
+	int32_t slot = n_slot(type_size(type));
+	asm_lea(RDI, RBP, slot);
+	n_store(type);
+	asm_lea(RAX, RBP, slot);
+}
+
+/*
+	Integer and pointer arguments go in registers, the stack is aligned for
+	the call and kept in rbx, which the callee preserves
+*/
+static void n_foreign_call(Expr *expr, Decl *func)
+{
+	static Register regs[] = {RDI, RSI, RDX, RCX, R8, R9};
+	Type *returntype = expr->callee->type->returntype;
+	Expr **args = expr->args;
+	int64_t count = array_length(args);
+	
+	if(!jit)
+		unsupported(expr->start, "calling foreign functions");
+	
+	if(count > 6)
+		unsupported(expr->start, "more than 6 foreign arguments");
+	
+	if(is_aggregate(returntype))
+		unsupported(expr->start, "foreign aggregate results");
+	
+	for(int64_t i = count - 1; i >= 0; i--) {
+		if(is_aggregate(args[i]->type))
+			unsupported(args[i]->start, "foreign aggregate arguments");
+		
+		n_expr(args[i]);
+		asm_push(RAX);
+	}
+	
+	// the callee might write to stdout on its own
+	n_call_to(rt_flush);
+	
+	for(int64_t i = 0; i < count; i++) {
+		asm_pop(regs[i]);
+	}
+	
+	n_abs(R11, SEG_DATA, func->offset);
+	asm_load(R11, R11, 0, 8, false);
+	asm_mov_r64_i64(RAX, 0);
+	asm_mov_r64_r64(RBX, RSP);
+	asm_alu_r64_i32(ALU_AND, RSP, -16);
+	asm_call_r64(R11);
+	
+	// and its stdio output has to come before the next print
+	asm_push(RAX);
+	asm_push(RAX);
+	n_abs(R11, SEG_DATA, jit_fflush);
+	asm_load(R11, R11, 0, 8, false);
+	asm_mov_r64_i64(RDI, 0);
+	asm_mov_r64_i64(RAX, 0);
+	asm_call_r64(R11);
+	asm_pop(RAX);
+	asm_mov_r64_r64(RSP, RBX);
+	
+	if(returntype->kind != NONE)
+		asm_extend(RAX, type_size(returntype), is_signed(returntype));
+}
+
+static void n_call(Expr *expr)
+{
+	Expr *callee = expr->callee;
+	
+	if(callee->kind != VAR || callee->decl->kind != FUNC)
+		unsupported(expr->start, "calling function values");
+	
+	Decl *func = original_decl(callee->decl);
+	
+	if(func->builtin) {
+		n_call_to(rt_flush);
+		return;
+	}
+	
+	if(func->cfunc) {
+		n_foreign_call(expr, func);
+		return;
+	}
+	
+	Type *returntype = callee->type->returntype;
+	Expr **args = expr->args;
+	int64_t words = array_length(args);
+	int32_t result = 0;
+	
+	if(is_aggregate(returntype))
+		result = n_slot(type_size(returntype));
+	
+	for(int64_t i = words - 1; i >= 0; i--) {
+		n_arg(args[i], func->params[i]);
+		asm_push(RAX);
+	}
+	
+	if(is_aggregate(returntype)) {
+		asm_lea(RAX, RBP, result);
+		asm_push(RAX);
+		words ++;
+	}
+	
+	n_call_later(&func->offset);
+	if(words) asm_alu_r64_i32(ALU_ADD, RSP, words * 8);
+}
+
+static void n_length(Expr *expr)
+{
+	Expr *array = expr->array;
+	Type *type = array->type;
+	
+	if(type->kind == ARRAY) {
+		if(type->length < 0)
+			unsupported(expr->start, "dynamic array");
+		
+		asm_mov_r64_i64(RAX, type->length);
+	}
+	else {
+		n_expr(array);
+		asm_load(RAX, RAX, 0, 8, false);
+	}
+}
+
+/*
+	Arenas and pools draw from the same heap, which never gives memory back
+*/
+static void n_new(Expr *expr)
+{
+	if(expr->allocator) n_expr(expr->allocator);
+	int64_t size = align_up(type_size(expr->type->subtype), 16);
+	if(size == 0) size = 16;
+	n_abs(R8, SEG_DATA, heap_next);
+	asm_load(RAX, R8, 0, 8, false);
+	asm_mov_r64_r64(RCX, RAX);
+	asm_alu_r64_i32(ALU_ADD, RCX, size);
+	asm_store(R8, 0, RCX, 8);
+}
+
+static void n_expr(Expr *expr)
+{
+	Type *type = expr->type;
+	
+	switch(expr->kind) {
+		case INT:
+		case BOOL:
+			asm_mov_r64_i64(RAX, expr->value);
+			break;
+		case ENUM:
+			asm_mov_r64_i64(RAX, expr->item->val->value);
+			break;
+		case STRING:
+			n_string(expr->string, expr->length);
+			break;
+		case CSTRING:
+			n_abs(
+				RAX, SEG_RODATA,
+				put_string(expr->string, strlen(expr->string))
+			);
+			break;
+		case VAR:
+			if(expr->decl->kind == FUNC)
+				unsupported(expr->start, "function value");
+			
+			n_var_addr(RAX, expr->decl);
+			n_load(type);
+			break;
+		case PTR:
+			n_addr(expr->subexpr);
+			break;
+		case DEREF:
+			n_expr(expr->ptr);
+			n_load(type);
+			break;
+		case CAST:
+			n_cast(expr);
+			break;
+		case SUBSCRIPT:
+			if(expr->array->type->kind == STRING) {
+				n_string_item(expr);
+			}
+			else {
+				n_item_addr(expr);
+				n_load(type);
+			}
+			break;
+		case BINOP:
+			n_binop(expr);
+			break;
+		case ARRAY:
+			n_array(expr);
+			break;
+		case CALL:
+			n_call(expr);
+			break;
+		case MEMBER:
+			n_member_addr(expr);
+			n_load(type);
+			break;
+		case LENGTH:
+			n_length(expr);
+			break;
+		case NEW:
+			n_new(expr);
+			break;
+		case NEGATION:
+			n_expr(expr->subexpr);
+			asm_neg_r64(RAX);
+			break;
+		case COMPLEMENT:
+			n_expr(expr->subexpr);
+			asm_not_r64(RAX);
+			break;
+		case DYNCALL:
+			if(expr->array->type->kind == BUILDER)
+				unsupported(expr->start, "string builders");
+			
+			if(expr->array->type->kind == MAP)
+				unsupported(expr->start, "maps");
+			
+			unsupported(expr->start, "growing arrays");
+			break;
+		default:
+			unsupported(expr->start, "expression");
+	}
+}
+
+static void n_addr(Expr *expr)
+{
+	switch(expr->kind) {
+		case VAR:
+			n_var_addr(RAX, expr->decl);
+			return;
+		case DEREF:
+			n_expr(expr->ptr);
+			return;
+		case SUBSCRIPT:
+			if(expr->array->type->kind != STRING) {
+				n_item_addr(expr);
+				return;
+			}
+			break;
+		case MEMBER:
+			n_member_addr(expr);
+			return;
+	}
+	
+	// aggregate values are addressed already
+	if(!is_aggregate(expr->type))
+		unsupported(expr->start, "address of this expression");
+	
+	n_expr(expr);
+}
+
+/*
+	Printing
+*/
+
+// print the value at the address in rax
+static void n_print_mem(Type *type, bool repr)
+{
+	int64_t size = type_size(type);
+	
+	switch(type->kind) {
+		case INT8:
+		case INT16:
+		case INT32:
+		case INT64:
+			asm_load(RAX, RAX, 0, size, true);
+			n_call_to(rt_print_int);
+			break;
+		case UINT8:
+		case UINT16:
+		case UINT32:
+		case UINT64:
+			asm_load(RAX, RAX, 0, size, false);
+			n_call_to(rt_print_uint);
+			break;
+		case BOOL:
+			asm_load(RAX, RAX, 0, size, false);
+			n_call_to(rt_print_bool);
+			break;
+		case STRING:
+			if(repr) {
+				asm_push(RAX);
+				n_write_raw("\"", 1);
+				asm_pop(RAX);
+			}
+			
+			asm_load(RSI, RAX, 8, 8, false);
+			asm_load(RDX, RAX, 0, 8, false);
+			n_call_to(rt_write);
+			if(repr) n_write_raw("\"", 1);
+			break;
+		case PTR: {
+			asm_load(RAX, RAX, 0, 8, false);
+			asm_test_r64_r64(RAX, RAX);
+			uint64_t null = asm_jcc(CC_E);
+			asm_push(RAX);
+			n_write_raw(">", 1);
+			asm_pop(RAX);
+			n_print_mem(type->subtype, true);
+			uint64_t done = asm_jmp();
+			asm_patch_rel32(null, here());
+			n_write_raw("null", 4);
+			asm_patch_rel32(done, here());
+			break;
+		}
+		case ARRAY: {
+			int32_t base = n_slot(8);
+			int64_t itemsize = type_size(type->itemtype);
+			asm_store(RBP, base, RAX, 8);
+			n_write_raw("[", 1);
+			
+			for(int64_t i=0; i < type->length; i++) {
+				if(i > 0) n_write_raw(", ", 2);
+				asm_load(RAX, RBP, base, 8, false);
+				asm_alu_r64_i32(ALU_ADD, RAX, i * itemsize);
+				n_print_mem(type->itemtype, true);
+			}
+			
+			n_write_raw("]", 1);
+			break;
+		}
+	}
+}
+
+static void n_print(Expr *expr)
+{
+	Type *type = expr->type;
+	
+	switch(type->kind) {
+		case INT8:
+		case INT16:
+		case INT32:
+		case INT64:
+			n_expr(expr);
+			n_call_to(rt_print_int);
+			break;
+		case UINT8:
+		case UINT16:
+		case UINT32:
+		case UINT64:
+			n_expr(expr);
+			n_call_to(rt_print_uint);
+			break;
+		case BOOL:
+			n_expr(expr);
+			n_call_to(rt_print_bool);
+			break;
+		case STRING:
+			n_expr(expr);
+			n_print_mem(type, false);
+			break;
+		case PTR: {
+			int32_t slot = n_slot(8);
+			n_expr(expr);
+			asm_store(RBP, slot, RAX, 8);
+			asm_lea(RAX, RBP, slot);
+			n_print_mem(type, false);
+			break;
+		}
+		case ARRAY:
+			if(type->length < 0) {
+				n_write_raw("[]", 2);
+				break;
+			}
+			
+			n_expr(expr);
+			n_print_mem(type, false);
+			break;
+	}
+}
+
+/*
+	Statements
+*/
+
+static void n_loop_start()
+{
+	Loop loop = {0};
+	array_push(loops, loop);
+}
+
+static void n_loop_end(uint64_t cont, uint64_t end)
+{
+	Loop *loop = array_last(loops);
+	
+	array_for(loop->continues, i) {
+		asm_patch_rel32(loop->continues[i], cont);
+	}
+	
+	array_for(loop->breaks, i) {
+		asm_patch_rel32(loop->breaks[i], end);
+	}
+	
+	array_resize(loops, array_length(loops) - 1);
+}
+
+static void n_invariants(Decl **invariants)
+{
+	array_for(invariants, i) {
+		n_local(invariants[i]);
+		n_init(invariants[i]);
+	}
+}
+
+static void n_if(If *ifstmt)
+{
+	Block *else_body = ifstmt->else_body;
+	
+	if(ifstmt->cond->kind == BOOL) {
+		// constant condition, only the branch taken is left
+		Block *body = ifstmt->cond->value ? ifstmt->if_body : else_body;
+		if(body) n_block(body);
+		return;
+	}
+	
+	n_expr(ifstmt->cond);
+	asm_test_r64_r64(RAX, RAX);
+	uint64_t other = asm_jcc(CC_E);
+	n_block(ifstmt->if_body);
+	
+	if(else_body && else_body->stmts) {
+		uint64_t done = asm_jmp();
+		asm_patch_rel32(other, here());
+		n_block(else_body);
+		asm_patch_rel32(done, here());
+	}
+	else {
+		asm_patch_rel32(other, here());
+	}
+}
+
+static void n_while(While *stmt)
+{
+	n_loop_start();
+	
+	if(stmt->invariants) {
+		// the hoisted invariants are only valid once cond held
+		n_expr(stmt->entry_cond);
+		asm_test_r64_r64(RAX, RAX);
+		uint64_t skip = asm_jcc(CC_E);
+		n_invariants(stmt->invariants);
+		uint64_t body = here();
+		n_block(stmt->body);
+		uint64_t cont = here();
+		n_expr(stmt->cond);
+		asm_test_r64_r64(RAX, RAX);
+		asm_jcc_to(CC_NE, body);
+		asm_patch_rel32(skip, here());
+		n_loop_end(cont, here());
+	}
+	else {
+		uint64_t top = here();
+		n_expr(stmt->cond);
+		asm_test_r64_r64(RAX, RAX);
+		uint64_t exit = asm_jcc(CC_E);
+		n_block(stmt->body);
+		asm_jmp_to(top);
+		asm_patch_rel32(exit, here());
+		n_loop_end(top, here());
+	}
+}
+
+// jump out unless iter <= end
+static uint64_t n_for_check(For *stmt, int32_t end)
+{
+	Type *type = stmt->iter->type;
+	bool isunsigned = type->kind == UINT64 || stmt->to->type->kind == UINT64;
+	
+	asm_load(RAX, RBP, stmt->iter->offset, type_size(type), is_signed(type));
+	asm_load(RCX, RBP, end, 8, false);
+	asm_alu_r64_r64(ALU_CMP, RAX, RCX);
+	return asm_jcc(isunsigned ? CC_A : CC_G);
+}
+
+static void n_for(For *stmt)
+{
+	Decl *iter = stmt->iter;
+	uint64_t skip = 0;
+	
+	// the upper bound is evaluated once, before the first iteration
+	int32_t end = n_slot(8);
+	n_expr(stmt->to);
+	asm_store(RBP, end, RAX, 8);
+	
+	n_local(iter);
+	n_expr(stmt->from);
+	asm_lea(RDI, RBP, iter->offset);
+	n_store(iter->type);
+	n_loop_start();
+	
+	if(stmt->invariants) {
+		skip = n_for_check(stmt, end);
+		n_invariants(stmt->invariants);
+	}
+	
+	uint64_t top = here();
+	uint64_t exit = n_for_check(stmt, end);
+	n_block(stmt->body);
+	uint64_t cont = here();
+	asm_lea(RDI, RBP, iter->offset);
+	asm_load(RAX, RDI, 0, type_size(iter->type), false);
+	asm_alu_r64_i32(ALU_ADD, RAX, 1);
+	n_store(iter->type);
+	asm_jmp_to(top);
+	asm_patch_rel32(exit, here());
+	if(stmt->invariants) asm_patch_rel32(skip, here());
+	n_loop_end(cont, here());
+}
+
+// jump out when the cursor reached the end
+static uint64_t n_foreach_check(int32_t cursor, int32_t end)
+{
+	asm_load(RAX, RBP, cursor, 8, false);
+	asm_load(RCX, RBP, end, 8, false);
+	asm_alu_r64_r64(ALU_CMP, RAX, RCX);
+	return asm_jcc(CC_AE);
+}
+
+/*
+	Walk a cursor from the first to one past the last item; the iterable is
+	evaluated and its length read only once
+*/
+static void n_foreach(ForEach *foreach)
+{
+	Decl *iter = foreach->iter;
+	Expr *array = foreach->array;
+	Type *type = array->type;
+	Type *itemtype = type->kind == STRING ? type : type->itemtype;
+	int64_t itemsize = type->kind == STRING ? 1 : type_size(itemtype);
+	int32_t cursor = n_slot(8);
+	int32_t end = n_slot(8);
+	uint64_t skip = 0;
+	
+	if(type->kind == ARRAY && type->length < 0)
+		unsupported(array->start, "dynamic array");
+	
+	if(type->kind == ARRAY) {
+		n_addr(array);
+		asm_mov_r64_r64(RCX, RAX);
+		asm_alu_r64_i32(ALU_ADD, RCX, type->length * itemsize);
+	}
+	else {
+		n_expr(array);
+		asm_load(RCX, RAX, 0, 8, false);
+		asm_load(RAX, RAX, 8, 8, false);
+		asm_mov_r64_i64(RDX, itemsize);
+		asm_imul_r64_r64(RCX, RDX);
+		asm_alu_r64_r64(ALU_ADD, RCX, RAX);
+	}
+	
+	asm_store(RBP, cursor, RAX, 8);
+	asm_store(RBP, end, RCX, 8);
+	n_local(iter);
+	n_loop_start();
+	
+	if(foreach->invariants) {
+		skip = n_foreach_check(cursor, end);
+		n_invariants(foreach->invariants);
+	}
+	
+	uint64_t top = here();
+	uint64_t exit = n_foreach_check(cursor, end);
+	asm_lea(RDI, RBP, iter->offset);
+	
+	if(type->kind == STRING) {
+		asm_store(RDI, 8, RAX, 8);
+		asm_mov_r64_i64(RAX, 1);
+		asm_store(RDI, 0, RAX, 8);
+	}
+	else if(foreach->byref) {
+		asm_store(RDI, 0, RAX, 8);
+	}
+	else {
+		n_load(itemtype);
+		n_store(itemtype);
+	}
+	
+	n_block(foreach->body);
+	uint64_t cont = here();
+	asm_load(RAX, RBP, cursor, 8, false);
+	asm_alu_r64_i32(ALU_ADD, RAX, itemsize);
+	asm_store(RBP, cursor, RAX, 8);
+	asm_jmp_to(top);
+	asm_patch_rel32(exit, here());
+	if(foreach->invariants) asm_patch_rel32(skip, here());
+	n_loop_end(cont, here());
+}
+
+static void n_vardecl(Decl *decl)
+{
+	if(decl->scope->parent) {
+		n_local(decl);
+		n_init(decl);
+	}
+	else if(decl->init && !decl->init->isconst) {
+		// global with non-constant initializer
+		n_expr(decl->init);
+		n_var_addr(RDI, decl);
+		n_store(decl->type);
+	}
+}
+
+static void n_assign(Assign *assign)
+{
+	n_addr(assign->target);
+	asm_push(RAX);
+	n_expr(assign->expr);
+	asm_pop(RDI);
+	n_store(assign->target->type);
+}
+
+static void n_return(Return *returnstmt)
+{
+	Expr *result = returnstmt->expr;
+	
+	if(result) {
+		n_expr(result);
+		
+		if(is_aggregate(result->type)) {
+			// the caller's result slot is the first word
+			asm_load(RDI, RBP, 16, 8, false);
+			n_store(result->type);
+			asm_load(RAX, RBP, 16, 8, false);
+		}
+	}
+	
+	array_push(returns, asm_jmp());
+}
+
+static void n_import(Import *import)
+{
+	array_for(units, i) {
+		if(units[i] == import->unit)
+			n_call_later(&unit_mains[i]);
+	}
+}
+
+static void n_stmt(Stmt *stmt)
+{
+	Loop *loop = array_last(loops);
+	
+	switch(stmt->kind) {
+		case PRINT:
+			n_print(stmt->as_print.expr);
+			n_call_to(rt_newline);
+			break;
+		case VAR:
+			n_vardecl(&stmt->as_decl);
+			break;
+		case IF:
+			n_if(&stmt->as_if);
+			break;
+		case WHILE:
+			n_while(&stmt->as_while);
+			break;
+		case ASSIGN:
+			n_assign(&stmt->as_assign);
+			break;
+		case CALL:
+			n_expr(stmt->as_call.call);
+			break;
+		case RETURN:
+			n_return(&stmt->as_return);
+			break;
+		case IMPORT:
+			n_import(&stmt->as_import);
+			break;
+		case FOREIGN:
+			// resolved before the program starts
+			if(!jit) unsupported(stmt->start, "foreign code");
+			break;
+		case BREAK:
+			array_push(loop->breaks, asm_jmp());
+			break;
+		case CONTINUE:
+			array_push(loop->continues, asm_jmp());
+			break;
+		case FOR:
+			n_for(&stmt->as_for);
+			break;
+		case FOREACH:
+			n_foreach(&stmt->as_foreach);
+			break;
+		case DELETE:
+			if(stmt->as_delete.expr->type->kind == MAP)
+				unsupported(stmt->start, "maps");
+			
+			// new memory is never given back
+			if(stmt->as_delete.allocator) n_expr(stmt->as_delete.allocator);
+			n_expr(stmt->as_delete.expr);
+			break;
+	}
+}
+
+static void n_block(Block *block)
+{
+	array_for(block->stmts, i) {
+		n_stmt(block->stmts[i]);
+	}
+}
+
+/*
+	Functions
+*/
+
+static void n_frame_start()
+{
+	frame_size = 0;
+	returns = 0;
+	loops = 0;
+	asm_push(RBP);
+	asm_mov_r64_r64(RBP, RSP);
+	asm_alu_r64_i32(ALU_SUB, RSP, 0);
+	frame_patch = here() - 4;
+}
+
+static void n_frame_end()
+{
+	array_for(returns, i) {
+		asm_patch_rel32(returns[i], here());
+	}
+	
+	asm_mov_r64_r64(RSP, RBP);
+	asm_pop(RBP);
+	asm_ret();
+	asm_patch_uint32(frame_patch, align_up(frame_size, 16));
+}
+
+static void n_func(Decl *decl)
+{
+	// params follow the return address and the result slot
+	int64_t first = is_aggregate(decl->type->returntype) ? 24 : 16;
+	decl->offset = here();
+	
+	array_for(decl->params, i) {
+		Decl *param = decl->params[i];
+		param->onstack = 1;
+		param->offset = first + i * 8;
+	}
+	
+	n_frame_start();
+	n_block(decl->body);
+	n_frame_end();
+}
+
+static void n_unit_main(int64_t index)
+{
+	unit_mains[index] = here();
+	n_frame_start();
+	
+	// the top level code of a unit runs once, on the first import
+	n_abs(R8, SEG_DATA, unit_flags[index]);
+	asm_load(RAX, R8, 0, 8, false);
+	asm_test_r64_r64(RAX, RAX);
+	array_push(returns, asm_jcc(CC_NE));
+	asm_mov_r64_i64(RAX, 1);
+	asm_store(R8, 0, RAX, 8);
+	
+	n_block(units[index]->block);
+	n_frame_end();
+}
+
+/*
+	Runtime routines, they take their arguments in registers and clobber
+	all but rbp and rsp
+*/
+static void n_runtime()
+{
+	// write rdx bytes at rsi to print_fd
+	uint64_t rt_syswrite = here();
+	uint64_t loop = here();
+	asm_test_r64_r64(RDX, RDX);
+	uint64_t done = asm_jcc(CC_LE);
+	n_abs(R8, SEG_DATA, print_fd);
+	asm_load(RDI, R8, 0, 8, false);
+	asm_mov_r64_i64(RAX, SYS_WRITE);
+	asm_syscall();
+	asm_test_r64_r64(RAX, RAX);
+	uint64_t failed = asm_jcc(CC_LE);
+	asm_alu_r64_r64(ALU_ADD, RSI, RAX);
+	asm_alu_r64_r64(ALU_SUB, RDX, RAX);
+	asm_jmp_to(loop);
+	asm_patch_rel32(done, here());
+	asm_patch_rel32(failed, here());
+	asm_ret();
+	
+	rt_flush = here();
+	n_abs(R8, SEG_DATA, print_len);
+	asm_load(RDX, R8, 0, 8, false);
+	asm_mov_r64_i64(RAX, 0);
+	asm_store(R8, 0, RAX, 8);
+	n_abs(RSI, SEG_BSS, print_buf);
+	asm_jmp_to(rt_syswrite);
+	
+	// buffer rdx bytes at rsi, too many for the buffer go out directly
+	rt_write = here();
+	n_abs(R8, SEG_DATA, print_len);
+	asm_load(RAX, R8, 0, 8, false);
+	asm_alu_r64_r64(ALU_ADD, RAX, RDX);
+	asm_alu_r64_i32(ALU_CMP, RAX, PRINT_BUF_SIZE);
+	uint64_t fits = asm_jcc(CC_BE);
+	asm_push(RSI);
+	asm_push(RDX);
+	n_call_to(rt_flush);
+	asm_pop(RDX);
+	asm_pop(RSI);
+	asm_alu_r64_i32(ALU_CMP, RDX, PRINT_BUF_SIZE);
+	uint64_t fits_now = asm_jcc(CC_BE);
+	asm_jmp_to(rt_syswrite);
+	asm_patch_rel32(fits, here());
+	asm_patch_rel32(fits_now, here());
+	n_abs(R8, SEG_DATA, print_len);
+	asm_load(RAX, R8, 0, 8, false);
+	n_abs(RDI, SEG_BSS, print_buf);
+	asm_alu_r64_r64(ALU_ADD, RDI, RAX);
+	asm_alu_r64_r64(ALU_ADD, RAX, RDX);
+	asm_store(R8, 0, RAX, 8);
+	asm_mov_r64_r64(RCX, RDX);
+	asm_rep_movsb();
+	asm_ret();
+	
+	// print rax in decimal
+	rt_print_uint = here();
+	asm_alu_r64_i32(ALU_SUB, RSP, 32);
+	asm_lea(RSI, RSP, 32);
+	asm_mov_r64_i64(RCX, 10);
+	uint64_t digit = here();
+	asm_mov_r64_i64(RDX, 0);
+	asm_div_r64(RCX);
+	asm_alu_r64_i32(ALU_ADD, RDX, '0');
+	asm_alu_r64_i32(ALU_SUB, RSI, 1);
+	asm_store(RSI, 0, RDX, 1);
+	asm_test_r64_r64(RAX, RAX);
+	asm_jcc_to(CC_NE, digit);
+	asm_lea(RDX, RSP, 32);
+	asm_alu_r64_r64(ALU_SUB, RDX, RSI);
+	n_call_to(rt_write);
+	asm_alu_r64_i32(ALU_ADD, RSP, 32);
+	asm_ret();
+	
+	rt_print_int = here();
+	asm_test_r64_r64(RAX, RAX);
+	asm_jcc_to(CC_NS, rt_print_uint);
+	asm_push(RAX);
+	n_write_raw("-", 1);
+	asm_pop(RAX);
+	asm_neg_r64(RAX);
+	asm_jmp_to(rt_print_uint);
+	
+	rt_print_bool = here();
+	asm_test_r64_r64(RAX, RAX);
+	uint64_t false_ = asm_jcc(CC_E);
+	n_abs(RSI, SEG_RODATA, put_string("true", 4));
+	asm_mov_r64_i64(RDX, 4);
+	asm_jmp_to(rt_write);
+	asm_patch_rel32(false_, here());
+	n_abs(RSI, SEG_RODATA, put_string("false", 5));
+	asm_mov_r64_i64(RDX, 5);
+	asm_jmp_to(rt_write);
+	
+	rt_newline = here();
+	n_write_raw("\n", 1);
+	n_abs(R8, SEG_DATA, print_linebuf);
+	asm_load(RAX, R8, 0, 8, false);
+	asm_test_r64_r64(RAX, RAX);
+	uint64_t buffered = asm_jcc(CC_E);
+	asm_jmp_to(rt_flush);
+	asm_patch_rel32(buffered, here());
+	asm_ret();
+	
+	// index in rax, length in rcx, location string at rsi of length rdx
+	rt_bounds_fail = here();
+	asm_push(RCX);
+	asm_push(RAX);
+	asm_push(RDX);
+	asm_push(RSI);
+	n_call_to(rt_flush);
+	n_abs(R8, SEG_DATA, print_fd);
+	asm_mov_r64_i64(RAX, 2);
+	asm_store(R8, 0, RAX, 8);
+	asm_pop(RSI);
+	asm_pop(RDX);
+	n_call_to(rt_write);
+	n_write_raw(": error: index ", 15);
+	asm_pop(RAX);
+	n_call_to(rt_print_int);
+	n_write_raw(" is out of range 0 .. ", 22);
+	asm_pop(RAX);
+	asm_alu_r64_i32(ALU_SUB, RAX, 1);
+	n_call_to(rt_print_int);
+	n_write_raw("\n", 1);
+	n_call_to(rt_flush);
+	asm_mov_r64_i64(RDI, EXIT_FAILURE);
+	
+	// exit with status rdi, in memory return it to the caller of the entry
+	rt_exit = here();
+	
+	if(jit) {
+		n_abs(R8, SEG_DATA, jit_rsp);
+		asm_load(RSP, R8, 0, 8, false);
+		asm_mov_r64_r64(RAX, RDI);
+		asm_pop(RBX);
+		asm_pop(RBP);
+		asm_ret();
+	}
+	else {
+		asm_mov_r64_i64(RAX, SYS_EXIT_GROUP);
+		asm_syscall();
+	}
+}
+
+/*
+	Entry point: set up the runtime and argv of every unit, run the main
+	unit, flush and exit. In memory it is called with the address of argc
+	and the argv pointers in rdi.
+*/
+static uint64_t n_start()
+{
+	uint64_t start = here();
+	
+	if(jit) {
+		asm_push(RBP);
+		asm_push(RBX);
+		n_abs(R8, SEG_DATA, jit_rsp);
+		asm_store(R8, 0, RSP, 8);
+		asm_mov_r64_r64(RBP, RDI);
+	}
+	else {
+		asm_mov_r64_r64(RBP, RSP);
+	}
+	
+	
+	asm_mov_r64_i64(RAX, SYS_MMAP);
+	asm_mov_r64_i64(RDI, 0);
+	asm_mov_r64_i64(RSI, HEAP_SIZE);
+	asm_mov_r64_i64(RDX, PROT_RW);
+	asm_mov_r64_i64(R10, MAP_HEAP);
+	asm_mov_r64_i64(R8, -1);
+	asm_mov_r64_i64(R9, 0);
+	asm_syscall();
+	n_abs(R8, SEG_DATA, heap_next);
+	asm_store(R8, 0, RAX, 8);
+	
+	// line buffered if stdout is a terminal
+	asm_alu_r64_i32(ALU_SUB, RSP, 64);
+	asm_mov_r64_i64(RAX, SYS_IOCTL);
+	asm_mov_r64_i64(RDI, 1);
+	asm_mov_r64_i64(RSI, TCGETS);
+	asm_mov_r64_r64(RDX, RSP);
+	asm_syscall();
+	asm_alu_r64_i32(ALU_ADD, RSP, 64);
+	asm_test_r64_r64(RAX, RAX);
+	asm_setcc(CC_E, RAX);
+	n_abs(R8, SEG_DATA, print_linebuf);
+	asm_store(R8, 0, RAX, 8);
+	
+	// argv strings on the heap, argc is at rbp and the pointers follow
+	asm_load(RCX, RBP, 0, 8, false);
+	n_abs(R8, SEG_DATA, heap_next);
+	asm_load(RDI, R8, 0, 8, false);
+	asm_push(RDI);
+	asm_mov_r64_r64(RAX, RCX);
+	asm_mov_r64_i64(RDX, 16);
+	asm_imul_r64_r64(RAX, RDX);
+	asm_alu_r64_r64(ALU_ADD, RAX, RDI);
+	asm_store(R8, 0, RAX, 8);
+	asm_lea(RSI, RBP, 8);
+	
+	uint64_t next = here();
+	asm_test_r64_r64(RCX, RCX);
+	uint64_t done = asm_jcc(CC_E);
+	asm_load(RDX, RSI, 0, 8, false);
+	asm_store(RDI, 8, RDX, 8);
+	asm_mov_r64_r64(RAX, RDX);
+	uint64_t scan = here();
+	asm_load(R9, RAX, 0, 1, false);
+	asm_test_r64_r64(R9, R9);
+	uint64_t found = asm_jcc(CC_E);
+	asm_alu_r64_i32(ALU_ADD, RAX, 1);
+	asm_jmp_to(scan);
+	asm_patch_rel32(found, here());
+	asm_alu_r64_r64(ALU_SUB, RAX, RDX);
+	asm_store(RDI, 0, RAX, 8);
+	asm_alu_r64_i32(ALU_ADD, RDI, 16);
+	asm_alu_r64_i32(ALU_ADD, RSI, 8);
+	asm_alu_r64_i32(ALU_SUB, RCX, 1);
+	asm_jmp_to(next);
+	asm_patch_rel32(done, here());
+	
+	asm_pop(RAX);
+	asm_load(RCX, RBP, 0, 8, false);
+	
+	array_for(units, i) {
+		Decl **decls = units[i]->block->scope->decls;
+		
+		array_for(decls, j) {
+			Decl *decl = decls[j];
+			
+			if(decl->builtin && decl->kind == VAR && decl->reachable) {
+				n_abs(R8, SEG_DATA, decl->offset);
+				asm_store(R8, 0, RCX, 8);
+				asm_store(R8, 8, RAX, 8);
+			}
+		}
+	}
+	
+	n_call_later(&unit_mains[0]);
+	n_call_to(rt_flush);
+	asm_mov_r64_i64(RDI, 0);
+	asm_jmp_to(rt_exit);
+	return start;
+}
+
+/*
+	Generate the whole program, returns the text offset of the entry point
+*/
+static uint64_t n_program(Unit **_units)
+{
+	units = _units;
+	rodata = 0;
+	data = 0;
+	fixups = 0;
+	call_fixups = 0;
+	unit_mains = 0;
+	unit_flags = 0;
+	asm_start();
+	
+	int64_t stdout_fd = 1;
+	print_len = put_zeros(&data, 8, 8);
+	print_linebuf = put_zeros(&data, 8, 8);
+	print_fd = put_zeros(&data, 8, 8);
+	memcpy(data + print_fd, &stdout_fd, 8);
+	heap_next = put_zeros(&data, 8, 8);
+	jit_rsp = put_zeros(&data, 8, 8);
+	jit_fflush = put_zeros(&data, 8, 8);
+	print_buf = 0;
+	
+	array_resize(unit_mains, array_length(units));
+	array_resize(unit_flags, array_length(units));
+	
+	array_for(units, i) {
+		cur_unit = units[i];
+		src_end = cur_unit->src + cur_unit->src_len;
+		unit_flags[i] = put_zeros(&data, 8, 8);
+		put_globals(cur_unit);
+		put_foreigns(cur_unit);
+	}
+	
+	n_runtime();
+	uint64_t start = n_start();
+	
+	array_for(units, i) {
+		cur_unit = units[i];
+		src_end = cur_unit->src + cur_unit->src_len;
+		Decl **decls = cur_unit->block->scope->decls;
+		
+		array_for(decls, j) {
+			Decl *decl = decls[j];
+			
+			if(
+				decl->kind == FUNC && !decl->imported && decl->reachable &&
+				!decl->isproto
+			) {
+				n_func(decl);
+			}
+		}
+		
+		n_unit_main(i);
+	}
+	
+	array_for(call_fixups, i) {
+		asm_patch_rel32(call_fixups[i].pos, *call_fixups[i].target);
+	}
+	
+	// the print buffer follows data
+	put_zeros(&data, 0, 16);
+	
+	#ifdef JA_DEBUG
+	printf(
+		"%" PRIu64 " bytes of code, %" PRIu64 " bytes of data\n",
+		asm_get_text_size(), array_length(rodata) + array_length(data)
+	);
+	#endif
+	
+	return start;
+}
+
+// patch in the absolute addresses, seg_addr holds the segment addresses
+static void n_relocate(uint64_t *seg_addr)
+{
+	array_for(fixups, i) {
+		Fixup *fixup = &fixups[i];
+		uint64_t addr = seg_addr[fixup->seg] + fixup->offset;
+		
+		if(fixup->where == SEG_TEXT)
+			asm_patch_uint32(fixup->pos, addr);
+		else
+			memcpy(data + fixup->pos, &addr, 8);
+	}
+}
+
+int gen_native(Unit **units, char *exe_filename)
+{
+	jit = false;
+	uint64_t start = n_program(units);
+	
+	Elf *elf = new_elf();
+	elf_set_text(elf, asm_get_text(), asm_get_text_size());
+	elf_set_rodata(elf, rodata, array_length(rodata));
+	elf_set_data(elf, data, array_length(data));
+	elf_set_bss(elf, PRINT_BUF_SIZE);
+	elf_layout(elf);
+	elf->hdr.entry = elf->phdr_text.vaddr + start;
+	
+	n_relocate((uint64_t[]){
+		[SEG_TEXT] = elf->phdr_text.vaddr,
+		[SEG_RODATA] = elf->phdr_rodata.vaddr,
+		[SEG_DATA] = elf->phdr_data.vaddr,
+		[SEG_BSS] = elf->phdr_data.vaddr + elf->phdr_data.filesz,
+	});
+	
+	return elf_save(elf, exe_filename);
+}
+
+// store the addresses of foreign functions and variables in their slots
+static void n_resolve_foreigns()
+{
+	void *flush = dlsym(RTLD_DEFAULT, "fflush");
+	memcpy(data + jit_fflush, &flush, 8);
+	
+	array_for(units, i) {
+		cur_unit = units[i];
+		src_end = cur_unit->src + cur_unit->src_len;
+		Foreign **foreigns = cur_unit->block->scope->foreigns;
+		
+		array_for(foreigns, j) {
+			Foreign *foreign = foreigns[j];
+			void *lib = dlopen(foreign->filename, RTLD_LAZY);
+			
+			if(lib == 0) {
+				fatal_at(
+					foreign->start, "could not load library %s",
+					foreign->filename
+				);
+			}
+			
+			array_for(foreign->decls, k) {
+				Decl *decl = foreign->decls[k];
+				if(!decl->reachable) continue;
+				
+				char *name = 0;
+				string_append_token(name, decl->id);
+				void *addr = dlsym(lib, name);
+				
+				if(addr == 0)
+					fatal_at(decl->start, "could not load symbol %t", decl->id);
+				
+				memcpy(data + decl->offset, &addr, 8);
+			}
+		}
+	}
+}
+
+int jit_native(Unit **units, int argc, char **argv)
+{
+	jit = true;
+	uint64_t start = n_program(units);
+	n_resolve_foreigns();
+	
+	// absolute addresses are 32 bit immediates, so map below 4 GiB
+	uint64_t text_size = align_up(asm_get_text_size(), PAGE_SIZE);
+	uint64_t rodata_size = align_up(array_length(rodata), PAGE_SIZE);
+	uint64_t data_size = array_length(data) + PRINT_BUF_SIZE;
+	uint64_t size = text_size + rodata_size + data_size;
+	
+	uint8_t *mem = mmap(
+		0, size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0
+	);
+	
+	if(mem == MAP_FAILED)
+		return -1;
+	
+	uint64_t base = (uint64_t)mem;
+	
+	n_relocate((uint64_t[]){
+		[SEG_TEXT] = base,
+		[SEG_RODATA] = base + text_size,
+		[SEG_DATA] = base + text_size + rodata_size,
+		[SEG_BSS] = base + text_size + rodata_size + array_length(data),
+	});
+	
+	memcpy(mem, asm_get_text(), asm_get_text_size());
+	memcpy(mem + text_size, rodata, array_length(rodata));
+	memcpy(mem + text_size + rodata_size, data, array_length(data));
+	mprotect(mem, text_size, PROT_READ | PROT_EXEC);
+	mprotect(mem + text_size, rodata_size, PROT_READ);
+	
+	// the stack layout the kernel gives a new process
+	uint64_t *stack = malloc((argc + 2) * sizeof(uint64_t));
+	stack[0] = argc;
+	memcpy(stack + 1, argv, argc * sizeof(char*));
+	stack[argc + 1] = 0;
+	
+	int (*entry)(uint64_t *stack) = 0;
+	*(void**)&entry = mem + start;
+	fflush(stdout);
+	return entry(stack);
+}
@@ -0,0 +1,21 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "build.h"
+
+/*
+	Lower the analyzed units straight to x86-64 machine code and write a
+	static ELF executable, no C compiler involved. The first unit is the
+	main unit. Returns nonzero if the executable could not be written.
+*/
+int gen_native(Unit **units, char *exe_filename);
+
+/*
+	Generate the same code into executable memory and run it with the given
+	arguments, argv[0] being the program name. Foreign symbols are resolved
+	first. Returns the exit status of the program, or -1 if the memory could
+	not be mapped.
+*/
+int jit_native(Unit **units, int argc, char **argv);
+
+#endif
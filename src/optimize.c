@@ -0,0 +1,1767 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "optimize.h"
+#include "analyze.h"
+#include "ctfe.h"
+#include "array.h"
+
+/*
+	Loop invariant code motion
+	
+	Subexpressions of a loop body or while condition whose value can not
+	change between iterations are moved into temporaries that are evaluated
+	once before the first iteration. Expressions that might trap (derefs,
+	checked subscripts, divisions) are only hoisted from positions that every
+	iteration reaches before it can leave the loop.
+*/
+
+typedef struct {
+	Decl **written; // assigned or declared inside the loop
+	bool has_calls;
+	bool mem_writes; // stores through pointers or slices, calls, delete
+	Scope *scope;
+	Decl **invariants;
+} Loop;
+
+static BuildOptions *options;
+static Decl **addressed; // vars whose address is taken in the current func
+static int64_t hoisted_count;
+
+static void o_stmts(Stmt **stmts);
+
+static bool contains_decl(Decl **decls, Decl *decl)
+{
+	array_for(decls, i) {
+		if(decls[i] == decl) return true;
+	}
+	
+	return false;
+}
+
+/*
+	Get the variable whose own storage is written when assigning to target,
+	or 0 if the store goes through a pointer or slice
+*/
+static Decl *store_root(Expr *target)
+{
+	while(true) {
+		if(target->kind == VAR) {
+			return target->decl;
+		}
+		else if(target->kind == MEMBER) {
+			target = target->object;
+		}
+		else if(
+			target->kind == SUBSCRIPT && (
+				target->array->type->kind == ARRAY ||
+				target->array->type->kind == MAP
+			)
+		) {
+			// the items of a map move when it grows
+			target = target->array;
+		}
+		else {
+			return 0;
+		}
+	}
+}
+
+static void scan_addressed_expr(Expr *expr, void *ctx)
+{
+	if(expr->kind == PTR) {
+		Decl *decl = store_root(expr->subexpr);
+		if(decl) array_push(addressed, decl);
+	}
+}
+
+static void push_invariants(Loop *loop, Decl **invariants)
+{
+	array_for(invariants, i) {
+		array_push(loop->written, invariants[i]);
+	}
+}
+
+/*
+	A store to a variable whose address is taken is a store to memory as
+	well, and so is one to a global, any function may have its address
+*/
+static void push_written(Loop *loop, Decl *root)
+{
+	array_push(loop->written, root);
+	
+	if(contains_decl(addressed, root) || !root->scope->funchost)
+		loop->mem_writes = true;
+}
+
+static void scan_loop_stmt(Stmt *stmt, void *ctx)
+{
+	Loop *loop = ctx;
+	Decl *root = 0;
+	
+	switch(stmt->kind) {
+		case VAR:
+			array_push(loop->written, &stmt->as_decl);
+			break;
+		case ASSIGN:
+			root = store_root(stmt->as_assign.target);
+			
+			if(root) {
+				push_written(loop, root);
+			}
+			else {
+				loop->mem_writes = true;
+			}
+			break;
+		case WHILE:
+			push_invariants(loop, stmt->as_while.invariants);
+			break;
+		case FOR:
+			array_push(loop->written, stmt->as_for.iter);
+			push_invariants(loop, stmt->as_for.invariants);
+			break;
+		case FOREACH:
+			array_push(loop->written, stmt->as_foreach.iter);
+			push_invariants(loop, stmt->as_foreach.invariants);
+			break;
+		case DELETE:
+			loop->mem_writes = true;
+			break;
+	}
+}
+
+static void scan_loop_expr(Expr *expr, void *ctx)
+{
+	Loop *loop = ctx;
+	
+	Decl *root = 0;
+	
+	if(expr->kind == CALL) {
+		loop->has_calls = true;
+		loop->mem_writes = true;
+	}
+	else if(expr->kind == DYNCALL) {
+		// the runtime may move the items or exit
+		root = store_root(expr->array);
+		if(root) push_written(loop, root);
+		loop->has_calls = true;
+		loop->mem_writes = true;
+	}
+	else if(expr->kind == NEW && expr->allocator) {
+		root = store_root(expr->allocator);
+		if(root) push_written(loop, root);
+		loop->mem_writes = true;
+	}
+}
+
+static bool var_is_invariant(Loop *loop, Decl *decl)
+{
+	if(decl->kind == FUNC)
+		return true;
+	
+	if(contains_decl(loop->written, decl))
+		return false;
+	
+	// outside of functions, variables are visible to every function
+	if(!decl->scope->funchost && (loop->has_calls || loop->mem_writes))
+		return false;
+	
+	if(contains_decl(addressed, decl) && loop->mem_writes)
+		return false;
+	
+	return true;
+}
+
+static bool is_invariant(Loop *loop, Expr *expr)
+{
+	switch(expr->kind) {
+		case INT:
+		case BOOL:
+		case STRING:
+		case ENUM:
+			return true;
+		case VAR:
+			return var_is_invariant(loop, expr->decl);
+		case DEREF:
+			return !loop->mem_writes && is_invariant(loop, expr->ptr);
+		case MEMBER:
+			return is_invariant(loop, expr->object);
+		case LENGTH:
+			if(
+				expr->array->type->kind == ARRAY &&
+				expr->array->type->length >= 0
+			) {
+				return true;
+			}
+			
+			return is_invariant(loop, expr->array);
+		case SUBSCRIPT:
+			if(expr->array->type->kind != ARRAY && loop->mem_writes)
+				return false;
+			
+			return
+				is_invariant(loop, expr->array) &&
+				is_invariant(loop, expr->index);
+		case BINOP:
+			return
+				is_invariant(loop, expr->left) &&
+				is_invariant(loop, expr->right);
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			return is_invariant(loop, expr->subexpr);
+	}
+	
+	return false;
+}
+
+static bool may_trap(Expr *expr)
+{
+	switch(expr->kind) {
+		case DEREF:
+			return true;
+		case MEMBER:
+			return may_trap(expr->object);
+		case LENGTH:
+			return may_trap(expr->array);
+		case SUBSCRIPT:
+			return
+				expr->needs_check || expr->array->type->kind != ARRAY ||
+				may_trap(expr->array) || may_trap(expr->index);
+		case BINOP:
+			if(
+				expr->operator->kind == TK_DSLASH ||
+				expr->operator->kind == TK_MOD
+			) {
+				if(expr->right->kind != INT || expr->right->value == 0)
+					return true;
+			}
+			
+			return may_trap(expr->left) || may_trap(expr->right);
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			return may_trap(expr->subexpr);
+	}
+	
+	return false;
+}
+
+/*
+	Check if expr costs more than reading a single variable or field and is
+	not folded to a constant by gcc anyway
+*/
+static bool is_costly(Expr *expr)
+{
+	switch(expr->kind) {
+		case DEREF:
+		case SUBSCRIPT:
+			return true;
+		case MEMBER:
+			return is_costly(expr->object);
+		case LENGTH:
+			if(expr->array->type->kind == ARRAY)
+				return expr->array->type->length == -1;
+			
+			return is_costly(expr->array);
+		case BINOP:
+			return !expr->isconst && (
+				is_costly(expr->left) || is_costly(expr->right) ||
+				expr->left->kind == VAR || expr->right->kind == VAR
+			);
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			return is_costly(expr->subexpr);
+	}
+	
+	return false;
+}
+
+static bool is_worth_hoisting(Expr *expr)
+{
+	Kind kind = expr->type->kind;
+	
+	return (
+		is_integral_type(expr->type) || kind == PTR || kind == STRING ||
+		kind == SLICE
+	) && is_costly(expr);
+}
+
+static bool expr_equ(Expr *left, Expr *right)
+{
+	if(left->kind != right->kind || !type_equ(left->type, right->type))
+		return false;
+	
+	switch(left->kind) {
+		case INT:
+		case BOOL:
+			return left->value == right->value;
+		case VAR:
+			return left->decl == right->decl;
+		case ENUM:
+			return left->item == right->item;
+		case DEREF:
+			return expr_equ(left->ptr, right->ptr);
+		case MEMBER:
+			return
+				left->member == right->member &&
+				expr_equ(left->object, right->object);
+		case LENGTH:
+			return expr_equ(left->array, right->array);
+		case SUBSCRIPT:
+			return
+				left->needs_check == right->needs_check &&
+				left->inserts == right->inserts &&
+				expr_equ(left->array, right->array) &&
+				expr_equ(left->index, right->index);
+		case BINOP:
+			return
+				left->operator->kind == right->operator->kind &&
+				expr_equ(left->left, right->left) &&
+				expr_equ(left->right, right->right);
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			return expr_equ(left->subexpr, right->subexpr);
+	}
+	
+	return false;
+}
+
+/*
+	Replace expr in place by a temporary holding its value
+*/
+static void hoist(Loop *loop, Expr *expr)
+{
+	Decl *tmp = 0;
+	
+	array_for(loop->invariants, i) {
+		if(expr_equ(loop->invariants[i]->init, expr)) {
+			tmp = loop->invariants[i];
+			break;
+		}
+	}
+	
+	if(!tmp) {
+		tmp = new_temp_var(loop->scope, expr->type, clone_expr(expr));
+		array_push(loop->invariants, tmp);
+		hoisted_count ++;
+	}
+	
+	Token *start = expr->start;
+	*expr = *new_var_expr(tmp->start, tmp);
+	expr->start = start;
+}
+
+/*
+	always: expr is evaluated in every iteration that reaches its statement
+*/
+static void hoist_expr(Loop *loop, Expr *expr, bool always)
+{
+	if(!expr) return;
+	
+	if(
+		is_worth_hoisting(expr) && is_invariant(loop, expr) &&
+		(always || !may_trap(expr))
+	) {
+		hoist(loop, expr);
+		return;
+	}
+	
+	switch(expr->kind) {
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			hoist_expr(loop, expr->subexpr, always);
+			break;
+		case DEREF:
+			hoist_expr(loop, expr->ptr, always);
+			break;
+		case SUBSCRIPT:
+			hoist_expr(loop, expr->array, always);
+			hoist_expr(loop, expr->index, always);
+			break;
+		case LENGTH:
+			hoist_expr(loop, expr->array, always);
+			break;
+		case BINOP:
+			hoist_expr(loop, expr->left, always);
+			
+			hoist_expr(
+				loop, expr->right,
+				always &&
+				expr->operator->kind != TK_AND && expr->operator->kind != TK_OR
+			);
+			break;
+		case ARRAY:
+			array_for(expr->items, i) {
+				hoist_expr(loop, expr->items[i], always);
+			}
+			break;
+		case CALL:
+		case DYNCALL:
+			array_for(expr->args, i) {
+				hoist_expr(loop, expr->args[i], always);
+			}
+			break;
+		case MEMBER:
+			hoist_expr(loop, expr->object, always);
+			break;
+	}
+}
+
+/*
+	Check if the statements following stmt might not be reached
+*/
+static bool may_leave(Stmt *stmt)
+{
+	Loop loop = {0};
+	
+	switch(stmt->kind) {
+		case PRINT:
+			walk_expr(stmt->as_print.expr, scan_loop_expr, &loop);
+			break;
+		case VAR:
+			walk_expr(stmt->as_decl.init, scan_loop_expr, &loop);
+			break;
+		case ASSIGN:
+			walk_expr(stmt->as_assign.target, scan_loop_expr, &loop);
+			walk_expr(stmt->as_assign.expr, scan_loop_expr, &loop);
+			break;
+		default:
+			return true;
+	}
+	
+	// a foreign call might exit
+	return loop.has_calls;
+}
+
+static void hoist_stmts(Loop *loop, Stmt **stmts, bool always)
+{
+	array_for(stmts, i) {
+		Stmt *stmt = stmts[i];
+		
+		switch(stmt->kind) {
+			case PRINT:
+				hoist_expr(loop, stmt->as_print.expr, always);
+				break;
+			case VAR:
+				hoist_expr(loop, stmt->as_decl.init, always);
+				break;
+			case ASSIGN:
+				// the target is an lvalue and stays as it is
+				hoist_expr(loop, stmt->as_assign.expr, always);
+				break;
+			case CALL:
+				hoist_expr(loop, stmt->as_call.call, always);
+				break;
+			case RETURN:
+				hoist_expr(loop, stmt->as_return.expr, always);
+				break;
+			case DELETE:
+				hoist_expr(loop, stmt->as_delete.expr, always);
+				break;
+			case IF:
+				hoist_expr(loop, stmt->as_if.cond, always);
+				hoist_stmts(loop, stmt->as_if.if_body->stmts, false);
+				
+				if(stmt->as_if.else_body)
+					hoist_stmts(loop, stmt->as_if.else_body->stmts, false);
+				break;
+			case WHILE:
+				hoist_expr(loop, stmt->as_while.cond, always);
+				hoist_stmts(loop, stmt->as_while.body->stmts, false);
+				break;
+			case FOR:
+				hoist_expr(loop, stmt->as_for.from, always);
+				hoist_expr(loop, stmt->as_for.to, always);
+				hoist_stmts(loop, stmt->as_for.body->stmts, false);
+				break;
+			case FOREACH:
+				hoist_stmts(loop, stmt->as_foreach.body->stmts, false);
+				break;
+		}
+		
+		if(may_leave(stmt))
+			always = false;
+	}
+}
+
+static Decl **hoist_loop(Stmt *stmt, Block *body, Expr *cond)
+{
+	Loop loop = {0};
+	loop.scope = body->scope;
+	
+	if(stmt->kind == FOR)
+		array_push(loop.written, stmt->as_for.iter);
+	else if(stmt->kind == FOREACH)
+		array_push(loop.written, stmt->as_foreach.iter);
+	
+	walk_expr(cond, scan_loop_expr, &loop);
+	walk_block(body, scan_loop_stmt, scan_loop_expr, &loop);
+	
+	hoist_expr(&loop, cond, true);
+	hoist_stmts(&loop, body->stmts, true);
+	
+	return loop.invariants;
+}
+
+/*
+	Parameter copy elision
+	
+	Array and large struct parameters are passed as a pointer to the
+	caller's object instead of a copy, when the callee never writes them or
+	takes their address and can not observe them changing: it calls nothing
+	and writes no memory besides its own locals. Only functions private to
+	the unit that are never used as a value qualify, so every call site and
+	prototype sees the same signature.
+*/
+
+#define BYREF_MIN_SIZE 17
+
+typedef struct {
+	Decl **pinned; // params that need their own copy
+	bool writes_memory;
+} ParamScan;
+
+static Expr **direct_callees;
+static Decl **func_values; // funcs whose name is used other than in a call
+static int64_t byref_count;
+
+static void scan_values_expr(Expr *expr, void *ctx)
+{
+	if(expr->kind == CALL && expr->callee->kind == VAR) {
+		array_push(direct_callees, expr->callee);
+	}
+	else if(expr->kind == VAR && expr->decl->kind == FUNC) {
+		array_for(direct_callees, i) {
+			if(direct_callees[i] == expr) return;
+		}
+		
+		array_push(func_values, expr->decl);
+	}
+}
+
+static void scan_values_stmt(Stmt *stmt, void *ctx)
+{
+	if(stmt->kind == FUNC && stmt->as_decl.body) {
+		walk_block(
+			stmt->as_decl.body, scan_values_stmt, scan_values_expr, ctx
+		);
+	}
+}
+
+static int64_t type_size(Type *type)
+{
+	int64_t size = 0;
+	
+	switch(type->kind) {
+		case INT8:
+		case UINT8:
+		case BOOL:
+			return 1;
+		case INT16:
+		case UINT16:
+			return 2;
+		case INT32:
+		case UINT32:
+			return 4;
+		case STRING:
+		case SLICE:
+			return 16;
+		case DYNARRAY:
+		case BUILDER:
+			return 24;
+		case ARENA:
+			return 32;
+		case POOL:
+		case MAP:
+			return 40;
+		case ARRAY:
+			if(type->length == -1) return 16;
+			return type->length * type_size(type->itemtype);
+		case STRUCT:
+			array_for(type->decl->members, i) {
+				size += type_size(type->decl->members[i]->type);
+			}
+			
+			return size;
+		case UNION:
+			array_for(type->decl->members, i) {
+				int64_t member_size = type_size(type->decl->members[i]->type);
+				if(member_size > size) size = member_size;
+			}
+			
+			return size;
+	}
+	
+	return 8;
+}
+
+static void pin_root(ParamScan *scan, Expr *expr)
+{
+	Decl *root = store_root(expr);
+	if(root) array_push(scan->pinned, root);
+}
+
+static void scan_param_stmt(Stmt *stmt, void *ctx)
+{
+	ParamScan *scan = ctx;
+	Decl *root = 0;
+	
+	switch(stmt->kind) {
+		case ASSIGN:
+			root = store_root(stmt->as_assign.target);
+			
+			if(!root || !root->scope->funchost)
+				scan->writes_memory = true;
+			else
+				array_push(scan->pinned, root);
+			break;
+		case FOREACH:
+			if(stmt->as_foreach.byref)
+				pin_root(scan, stmt->as_foreach.array);
+			break;
+		case DELETE:
+			scan->writes_memory = true;
+			
+			// an arena or pool changes in place
+			if(stmt->as_delete.allocator)
+				pin_root(scan, stmt->as_delete.allocator);
+			else
+				pin_root(scan, stmt->as_delete.expr);
+			break;
+	}
+}
+
+static void scan_param_expr(Expr *expr, void *ctx)
+{
+	ParamScan *scan = ctx;
+	
+	if(expr->kind == CALL) {
+		scan->writes_memory = true;
+	}
+	else if(expr->kind == DYNCALL) {
+		scan->writes_memory = true;
+		pin_root(scan, expr->array);
+	}
+	else if(expr->kind == NEW && expr->allocator) {
+		scan->writes_memory = true;
+		pin_root(scan, expr->allocator);
+	}
+	else if(expr->kind == PTR) {
+		pin_root(scan, expr->subexpr);
+	}
+}
+
+static void elide_param_copies(Decl *func)
+{
+	ParamScan scan = {0};
+	
+	if(func->exported || contains_decl(func_values, func))
+		return;
+	
+	walk_block(func->body, scan_param_stmt, scan_param_expr, &scan);
+	
+	if(scan.writes_memory)
+		return;
+	
+	array_for(func->params, i) {
+		Decl *param = func->params[i];
+		Kind kind = param->type->kind;
+		bool aggregate = false;
+		
+		if(kind == ARRAY) {
+			aggregate = param->type->length >= 0;
+		}
+		else if(kind == STRUCT || kind == UNION) {
+			aggregate = type_size(param->type) >= BYREF_MIN_SIZE;
+		}
+		
+		if(aggregate && !contains_decl(scan.pinned, param)) {
+			param->byref = 1;
+			byref_count ++;
+		}
+	}
+}
+
+/*
+	Return slots
+	
+	A call returning an array constructs its result directly in the local
+	variable it is assigned to, when the callee can not reach that variable
+	by any other way: its address is never taken and the call does not use
+	it as an argument.
+*/
+
+static int64_t in_place_count;
+
+static void find_decl_expr(Expr *expr, void *ctx)
+{
+	Decl **decl = ctx;
+	
+	if(expr->kind == VAR && expr->decl == *decl)
+		*decl = 0;
+}
+
+static bool can_construct_in(Decl *decl, Expr *expr)
+{
+	Decl *unused = decl;
+	
+	if(
+		expr->kind != CALL || expr->type->kind != ARRAY ||
+		decl->kind != VAR || !decl->scope->parent || decl->byref ||
+		contains_decl(addressed, decl)
+	) {
+		return false;
+	}
+	
+	walk_expr(expr, find_decl_expr, &unused);
+	
+	if(unused) {
+		in_place_count ++;
+		return true;
+	}
+	
+	return false;
+}
+
+/*
+	Constant propagation
+	
+	Reads of variables that are initialized with a literal and never written
+	again are replaced by the literal, and the expressions around them are
+	folded. An if statement whose condition folds to a constant only keeps
+	the branch that is taken. Exported variables can be written by other
+	units and are left alone.
+*/
+
+static Decl **stored; // vars written or addressed anywhere in the unit
+static int64_t propagated_count;
+static int64_t dead_branch_count;
+static int64_t ctfe_count;
+
+static void scan_stored_expr(Expr *expr, void *ctx)
+{
+	Decl *decl = 0;
+	
+	if(expr->kind == PTR)
+		decl = store_root(expr->subexpr);
+	else if(expr->kind == DYNCALL)
+		decl = store_root(expr->array);
+	else if(expr->kind == NEW && expr->allocator)
+		decl = store_root(expr->allocator);
+	
+	if(decl) array_push(stored, decl);
+}
+
+static void scan_stored_stmt(Stmt *stmt, void *ctx)
+{
+	Decl *root = 0;
+	
+	switch(stmt->kind) {
+		case FUNC:
+			walk_block(
+				stmt->as_decl.body, scan_stored_stmt, scan_stored_expr, ctx
+			);
+			break;
+		case ASSIGN:
+			root = store_root(stmt->as_assign.target);
+			if(root) array_push(stored, root);
+			break;
+		case FOR:
+			array_push(stored, stmt->as_for.iter);
+			break;
+		case FOREACH:
+			array_push(stored, stmt->as_foreach.iter);
+			break;
+	}
+}
+
+static bool is_unwritten(Decl *decl)
+{
+	return
+		decl->kind == VAR && !decl->isparam && !decl->builtin &&
+		!decl->imported && !decl->exported && !contains_decl(stored, decl);
+}
+
+static bool is_propagatable(Decl *decl)
+{
+	return is_unwritten(decl) && decl->init && is_literal(decl->init);
+}
+
+/*
+	Replace a call of a pure function with constant arguments by its result
+*/
+static void fold_call(Expr *expr)
+{
+	Expr *result = ctfe_call(expr, is_unwritten);
+	
+	if(result) {
+		Token *start = expr->start;
+		*expr = *result;
+		expr->start = start;
+		ctfe_count ++;
+	}
+}
+
+static bool folding_overflows(Kind kind, int64_t left, int64_t right)
+{
+	int64_t result;
+	
+	switch(kind) {
+		case TK_PLUS:
+			return __builtin_add_overflow(left, right, &result);
+		case TK_MINUS:
+			return __builtin_sub_overflow(left, right, &result);
+		case TK_MUL:
+			return __builtin_mul_overflow(left, right, &result);
+	}
+	
+	return false;
+}
+
+static void fold_binop(Expr *expr)
+{
+	Expr *left = expr->left;
+	Expr *right = expr->right;
+	Kind kind = expr->operator->kind;
+	
+	if(left->kind == ENUM && right->kind == ENUM) {
+		expr->kind = BOOL;
+		expr->value = left->item->val->value == right->item->val->value;
+		expr->isconst = 1;
+		return;
+	}
+	
+	if(
+		left->kind != INT && left->kind != BOOL && left->kind != STRING ||
+		right->kind != INT && right->kind != BOOL && right->kind != STRING
+	) {
+		return;
+	}
+	
+	// leave traps and overflows to run time
+	if(
+		(kind == TK_DSLASH || kind == TK_MOD) && (
+			right->value == 0 ||
+			right->value == -1 && left->value == INT64_MIN
+		)
+	) {
+		return;
+	}
+	
+	if(
+		is_integral_type(expr->type) &&
+		folding_overflows(kind, left->value, right->value)
+	) {
+		return;
+	}
+	
+	// values are folded as int64, uint64 ones order and divide differently
+	if(
+		(left->type->kind == UINT64 || right->type->kind == UINT64) && (
+			kind == TK_LOWER || kind == TK_GREATER || kind == TK_LEQUALS ||
+			kind == TK_GEQUALS || kind == TK_DSLASH || kind == TK_MOD
+		)
+	) {
+		return;
+	}
+	
+	eval_binop(expr);
+	
+	if(expr->kind != BINOP)
+		expr->isconst = 1;
+}
+
+/*
+	Inlining
+	
+	With -inl, a call of a function whose body only returns an expression
+	without calls is replaced by that expression, with the arguments in
+	place of the parameters. An argument that is not a literal or a variable
+	must be used exactly once and not only conditionally, so it is still
+	evaluated exactly once. An argument with calls could write what the body
+	reads, so it blocks bodies reading memory, which the call would only read
+	after the argument. Functions declared inline are substituted at any
+	size, others up to INLINE_MAX_NODES.
+*/
+
+#define INLINE_MAX_NODES 16
+
+typedef struct {
+	Decl **params;
+	int64_t *uses; // per param
+	bool *conditional; // per param: used where it might not be evaluated
+	int64_t nodes;
+	bool blocked; // calls or a param's address taken
+	bool reads; // globals, derefs, by-ref params or slice items
+} InlineScan;
+
+static int64_t inlined_count;
+
+static int64_t param_index(Decl **params, Decl *decl)
+{
+	array_for(params, i) {
+		if(params[i] == decl) return i;
+	}
+	
+	return -1;
+}
+
+static void scan_inline_expr(InlineScan *scan, Expr *expr, bool conditional)
+{
+	int64_t index = 0;
+	Decl *root = 0;
+	scan->nodes ++;
+	
+	switch(expr->kind) {
+		case VAR:
+			index = param_index(scan->params, expr->decl);
+			
+			if(index >= 0) {
+				scan->uses[index] ++;
+				if(conditional) scan->conditional[index] = true;
+			}
+			
+			if(
+				expr->decl->kind == VAR &&
+				(index < 0 || expr->decl->byref)
+			) {
+				scan->reads = true;
+			}
+			break;
+		case CALL:
+		case DYNCALL:
+		case NEW:
+			scan->blocked = true;
+			break;
+		case PTR:
+			root = store_root(expr->subexpr);
+			
+			if(root && param_index(scan->params, root) >= 0)
+				scan->blocked = true;
+			
+			scan_inline_expr(scan, expr->subexpr, conditional);
+			break;
+		case CAST:
+		case NEGATION:
+		case COMPLEMENT:
+			scan_inline_expr(scan, expr->subexpr, conditional);
+			break;
+		case DEREF:
+			scan->reads = true;
+			scan_inline_expr(scan, expr->ptr, conditional);
+			break;
+		case SUBSCRIPT:
+			if(expr->array->type->kind != ARRAY)
+				scan->reads = true;
+			
+			scan_inline_expr(scan, expr->array, conditional);
+			scan_inline_expr(scan, expr->index, conditional);
+			break;
+		case LENGTH:
+			scan_inline_expr(scan, expr->array, conditional);
+			break;
+		case MEMBER:
+			scan_inline_expr(scan, expr->object, conditional);
+			break;
+		case BINOP:
+			scan_inline_expr(scan, expr->left, conditional);
+			
+			scan_inline_expr(
+				scan, expr->right,
+				conditional ||
+				expr->operator->kind == TK_AND || expr->operator->kind == TK_OR
+			);
+			break;
+		case ARRAY:
+			array_for(expr->items, i) {
+				scan_inline_expr(scan, expr->items[i], conditional);
+			}
+			break;
+	}
+}
+
+static void scan_side_effect(Expr *expr, void *ctx)
+{
+	if(expr->kind == CALL || expr->kind == DYNCALL || expr->kind == NEW)
+		*(bool*)ctx = true;
+}
+
+static Expr *inline_body(Decl *func)
+{
+	if(
+		!func->body || func->imported || func->isproto || func->cfunc ||
+		func->type->returntype->kind == ARRAY ||
+		array_length(func->body->stmts) != 1 ||
+		func->body->stmts[0]->kind != RETURN
+	) {
+		return 0;
+	}
+	
+	return func->body->stmts[0]->as_return.expr;
+}
+
+static void substitute_param(Expr *expr, void *ctx)
+{
+	Expr *call = ctx;
+	
+	if(expr->kind == VAR) {
+		Decl **params = call->callee->decl->params;
+		int64_t index = param_index(params, expr->decl);
+		
+		if(index >= 0)
+			*expr = *clone_expr(call->args[index]);
+	}
+}
+
+static bool inline_call(Expr *call)
+{
+	if(call->callee->kind != VAR || call->callee->decl->kind != FUNC)
+		return false;
+	
+	Decl *func = call->callee->decl;
+	Expr *body = inline_body(func);
+	if(!body) return false;
+	
+	InlineScan scan = {0};
+	scan.params = func->params;
+	
+	array_for(func->params, i) {
+		array_push(scan.uses, 0);
+		array_push(scan.conditional, false);
+	}
+	
+	scan_inline_expr(&scan, body, false);
+	
+	if(scan.blocked || !func->isinline && scan.nodes > INLINE_MAX_NODES)
+		return false;
+	
+	array_for(call->args, i) {
+		Expr *arg = call->args[i];
+		
+		bool is_trivial =
+			is_literal(arg) || arg->kind == VAR && arg->decl->kind == VAR;
+		
+		if(!is_trivial && (scan.uses[i] != 1 || scan.conditional[i]))
+			return false;
+		
+		bool has_side_effect = false;
+		walk_expr(arg, scan_side_effect, &has_side_effect);
+		
+		if(scan.reads && has_side_effect)
+			return false;
+	}
+	
+	Expr *result = clone_expr(body);
+	walk_expr(result, substitute_param, call);
+	
+	Token *start = call->start;
+	*call = *result;
+	call->start = start;
+	inlined_count ++;
+	return true;
+}
+
+static void propagate_expr(Expr *expr)
+{
+	if(!expr) return;
+	
+	switch(expr->kind) {
+		case VAR:
+			if(is_propagatable(expr->decl)) {
+				Token *start = expr->start;
+				*expr = *clone_expr(expr->decl->init);
+				expr->start = start;
+				propagated_count ++;
+			}
+			break;
+		case DEREF:
+			propagate_expr(expr->ptr);
+			break;
+		case CAST:
+			propagate_expr(expr->subexpr);
+			
+			if(
+				(expr->subexpr->kind == INT || expr->subexpr->kind == BOOL) &&
+				is_integral_type(expr->type)
+			) {
+				Type *type = expr->type;
+				*expr = *expr->subexpr;
+				eval_integral_cast(expr, type);
+			}
+			break;
+		case NEGATION:
+		case COMPLEMENT:
+			propagate_expr(expr->subexpr);
+			
+			if(
+				expr->subexpr->kind == INT &&
+				!(expr->kind == NEGATION && expr->subexpr->value == INT64_MIN)
+			) {
+				expr->value =
+					expr->kind == NEGATION ?
+					-expr->subexpr->value : ~expr->subexpr->value;
+				
+				expr->kind = INT;
+				expr->isconst = 1;
+			}
+			break;
+		case SUBSCRIPT:
+			propagate_expr(expr->array);
+			propagate_expr(expr->index);
+			
+			if(
+				expr->needs_check && expr->index->kind == INT &&
+				expr->array->type->kind == ARRAY &&
+				expr->index->value >= 0 &&
+				expr->index->value < expr->array->type->length
+			) {
+				expr->needs_check = 0;
+			}
+			break;
+		case LENGTH:
+			propagate_expr(expr->array);
+			
+			if(expr->array->kind == STRING) {
+				expr->value = expr->array->length;
+				expr->kind = INT;
+				expr->isconst = 1;
+			}
+			break;
+		case BINOP:
+			propagate_expr(expr->left);
+			propagate_expr(expr->right);
+			fold_binop(expr);
+			break;
+		case ARRAY:
+			array_for(expr->items, i) {
+				propagate_expr(expr->items[i]);
+			}
+			break;
+		case CALL:
+			array_for(expr->args, i) {
+				propagate_expr(expr->args[i]);
+			}
+			
+			// array results are only folded into initializers
+			if(expr->type->kind != ARRAY)
+				fold_call(expr);
+			
+			if(
+				expr->kind == CALL && options->inline_calls &&
+				inline_call(expr)
+			) {
+				propagate_expr(expr);
+			}
+			break;
+		case MEMBER:
+			propagate_expr(expr->object);
+			break;
+		case DYNCALL:
+			// the array itself is written, only its arguments are read
+			array_for(expr->args, i) {
+				propagate_expr(expr->args[i]);
+			}
+			break;
+	}
+}
+
+static void propagate_stmt(Stmt *stmt, void *ctx)
+{
+	switch(stmt->kind) {
+		case FUNC:
+			walk_block(stmt->as_decl.body, propagate_stmt, 0, ctx);
+			break;
+		case PRINT:
+			propagate_expr(stmt->as_print.expr);
+			break;
+		case VAR:
+			propagate_expr(stmt->as_decl.init);
+			
+			if(stmt->as_decl.init && stmt->as_decl.init->kind == CALL)
+				fold_call(stmt->as_decl.init);
+			break;
+		case IF:
+			propagate_expr(stmt->as_if.cond);
+			
+			// cgen only emits the branch taken
+			if(stmt->as_if.cond->kind == BOOL)
+				dead_branch_count ++;
+			break;
+		case WHILE:
+			propagate_expr(stmt->as_while.cond);
+			break;
+		case ASSIGN:
+			propagate_expr(stmt->as_assign.target);
+			propagate_expr(stmt->as_assign.expr);
+			break;
+		case CALL:
+			propagate_expr(stmt->as_call.call);
+			break;
+		case RETURN:
+			propagate_expr(stmt->as_return.expr);
+			break;
+		case FOR:
+			propagate_expr(stmt->as_for.from);
+			propagate_expr(stmt->as_for.to);
+			break;
+		case FOREACH:
+			propagate_expr(stmt->as_foreach.array);
+			break;
+		case DELETE:
+			propagate_expr(stmt->as_delete.expr);
+			break;
+	}
+}
+
+static void o_while(While *stmt)
+{
+	o_stmts(stmt->body->stmts);
+	
+	Expr *entry_cond = clone_expr(stmt->cond);
+	stmt->invariants = hoist_loop((Stmt*)stmt, stmt->body, stmt->cond);
+	
+	if(stmt->invariants)
+		stmt->entry_cond = entry_cond;
+}
+
+static void o_func(Decl *decl)
+{
+	Decl **old_addressed = addressed;
+	addressed = 0;
+	walk_block(decl->body, 0, scan_addressed_expr, 0);
+	
+	elide_param_copies(decl);
+	o_stmts(decl->body->stmts);
+	
+	addressed = old_addressed;
+}
+
+static void o_stmts(Stmt **stmts)
+{
+	array_for(stmts, i) {
+		Stmt *stmt = stmts[i];
+		
+		switch(stmt->kind) {
+			case FUNC:
+				if(!stmt->as_decl.imported && !stmt->as_decl.isproto)
+					o_func(&stmt->as_decl);
+				break;
+			case VAR:
+				if(stmt->as_decl.init) {
+					stmt->as_decl.in_place = can_construct_in(
+						&stmt->as_decl, stmt->as_decl.init
+					);
+				}
+				break;
+			case ASSIGN:
+				if(stmt->as_assign.target->kind == VAR) {
+					stmt->as_assign.in_place = can_construct_in(
+						stmt->as_assign.target->decl, stmt->as_assign.expr
+					);
+				}
+				break;
+			case IF:
+				o_stmts(stmt->as_if.if_body->stmts);
+				
+				if(stmt->as_if.else_body)
+					o_stmts(stmt->as_if.else_body->stmts);
+				break;
+			case WHILE:
+				o_while(&stmt->as_while);
+				break;
+			case FOR:
+				o_stmts(stmt->as_for.body->stmts);
+				
+				stmt->as_for.invariants =
+					hoist_loop(stmt, stmt->as_for.body, 0);
+				break;
+			case FOREACH:
+				o_stmts(stmt->as_foreach.body->stmts);
+				
+				stmt->as_foreach.invariants =
+					hoist_loop(stmt, stmt->as_foreach.body, 0);
+				break;
+		}
+	}
+}
+
+/*
+	Purity
+	
+	Functions are classified for the C compiler, which may then merge or
+	hoist their calls. A pure function has no side effects: it does not
+	print, allocate, free, write outside its own locals, trap or call
+	anything impure. A function that also reads no memory besides its
+	locals and scalar params is const. The classes start out empty and grow
+	until nothing changes, so recursive functions, which might not
+	terminate, are never pure. Loops whose end is not known are excluded
+	for the same reason.
+	
+	A function that reaches a call of exit or of another noreturn function
+	on every path is noreturn.
+*/
+
+typedef struct {
+	bool impure;
+	bool reads; // memory besides locals and scalar params
+} PurityScan;
+
+static int64_t pure_count;
+static int64_t const_count;
+static int64_t noreturn_count;
+
+static bool is_local_decl(Decl *decl)
+{
+	return decl->kind == VAR && decl->scope->parent && !decl->byref;
+}
+
+static void scan_purity_stmt(Stmt *stmt, void *ctx)
+{
+	PurityScan *scan = ctx;
+	Decl *root = 0;
+	
+	switch(stmt->kind) {
+		case PRINT:
+		case DELETE:
+		case WHILE:
+			scan->impure = true;
+			break;
+		case ASSIGN:
+			root = store_root(stmt->as_assign.target);
+			if(!root || !is_local_decl(root)) scan->impure = true;
+			break;
+		case FOREACH:
+			scan->reads = true;
+			break;
+	}
+}
+
+static void scan_purity_expr(Expr *expr, void *ctx)
+{
+	PurityScan *scan = ctx;
+	Decl *decl = 0;
+	
+	switch(expr->kind) {
+		case CALL:
+			decl = expr->callee->kind == VAR ? expr->callee->decl : 0;
+			
+			if(!decl || decl->kind != FUNC || !decl->ispure)
+				scan->impure = true;
+			else if(!decl->readsnone)
+				scan->reads = true;
+			break;
+		case NEW:
+		case DYNCALL:
+			scan->impure = true;
+			break;
+		case DEREF:
+			scan->reads = true;
+			break;
+		case VAR:
+			decl = expr->decl;
+			
+			if(decl->kind == VAR && (!decl->scope->parent || decl->byref))
+				scan->reads = true;
+			break;
+		case SUBSCRIPT:
+			if(expr->needs_check)
+				scan->impure = true;
+			
+			if(expr->array->type->kind != ARRAY)
+				scan->reads = true;
+			break;
+	}
+}
+
+static bool is_pointer_free(Type *type)
+{
+	return
+		type->kind != PTR && type->kind != ARRAY && type->kind != SLICE &&
+		type->kind != DYNARRAY && type->kind != ARENA &&
+		type->kind != POOL && type->kind != BUILDER && type->kind != MAP &&
+		type->kind != STRING && type->kind != CSTRING;
+}
+
+static void classify_purity(Decl *func)
+{
+	if(func->type->returntype->kind == ARRAY)
+		return;
+	
+	PurityScan scan = {0};
+	walk_block(func->body, scan_purity_stmt, scan_purity_expr, &scan);
+	
+	array_for(func->params, i) {
+		if(!is_pointer_free(func->params[i]->type))
+			scan.reads = true;
+	}
+	
+	if(scan.impure)
+		return;
+	
+	func->ispure = 1;
+	func->readsnone = !scan.reads;
+}
+
+static bool is_exit_call(Stmt *stmt)
+{
+	Expr *call = stmt->kind == CALL ? stmt->as_call.call : 0;
+	
+	if(!call || call->kind != CALL || call->callee->kind != VAR)
+		return false;
+	
+	Decl *callee = call->callee->decl;
+	
+	if(callee->cfunc) {
+		return
+			tokequ_str(callee->id, "exit") ||
+			tokequ_str(callee->id, "_exit") ||
+			tokequ_str(callee->id, "abort");
+	}
+	
+	return callee->kind == FUNC && callee->noreturn;
+}
+
+static void scan_return(Stmt *stmt, void *ctx)
+{
+	if(stmt->kind == RETURN) *(bool*)ctx = true;
+}
+
+/*
+	Check if every path through block reaches an exit call on its top level
+	or in both branches of an if
+*/
+static bool never_returns(Block *block)
+{
+	array_for(block->stmts, i) {
+		Stmt *stmt = block->stmts[i];
+		
+		if(is_exit_call(stmt))
+			return true;
+		
+		if(
+			stmt->kind == IF && stmt->as_if.else_body &&
+			never_returns(stmt->as_if.if_body) &&
+			never_returns(stmt->as_if.else_body)
+		) {
+			return true;
+		}
+		
+	}
+	
+	return false;
+}
+
+static void classify_funcs(Unit *unit)
+{
+	bool changed = true;
+	
+	while(changed) {
+		changed = false;
+		
+		array_for(unit->block->stmts, i) {
+			Decl *decl = &unit->block->stmts[i]->as_decl;
+			
+			if(decl->kind != FUNC || decl->imported || decl->isproto)
+				continue;
+			
+			uint8_t was_pure = decl->ispure;
+			uint8_t was_const = decl->readsnone;
+			uint8_t was_noreturn = decl->noreturn;
+			
+			if(!decl->ispure || !decl->readsnone)
+				classify_purity(decl);
+			
+			bool has_return = false;
+			walk_block(decl->body, scan_return, 0, &has_return);
+			
+			if(decl->type->returntype->kind == NONE && !has_return)
+				decl->noreturn = never_returns(decl->body);
+			
+			changed |=
+				was_pure != decl->ispure || was_const != decl->readsnone ||
+				was_noreturn != decl->noreturn;
+		}
+	}
+	
+	array_for(unit->block->stmts, i) {
+		Decl *decl = &unit->block->stmts[i]->as_decl;
+		
+		if(decl->kind == FUNC && !decl->imported) {
+			pure_count += decl->ispure && !decl->readsnone;
+			const_count += decl->readsnone;
+			noreturn_count += decl->noreturn;
+		}
+	}
+}
+
+/*
+	Header inlining
+	
+	Exported functions declared inline or with at most
+	HEADER_INLINE_MAX_NODES statements and expressions are defined static
+	inline in the unit header, so calls from importing units can be inlined
+	by the C compiler. Everything of the unit such a function refers to is
+	made visible to the header as well, without becoming importable.
+	Functions that refer to imported declarations stay in the C file, since
+	the header does not include other units' headers.
+*/
+
+#define HEADER_INLINE_MAX_NODES 24
+
+typedef struct {
+	int64_t nodes;
+	bool blocked; // refers to something declared in another unit
+} HeaderScan;
+
+static int64_t header_count;
+
+static bool is_imported_type(Type *type)
+{
+	while(
+		type->kind == PTR || type->kind == ARRAY || type->kind == SLICE ||
+		type->kind == DYNARRAY || type->kind == POOL || type->kind == MAP
+	) {
+		if(type->kind == MAP && is_imported_type(type->keytype))
+			return true;
+		
+		type = type->subtype;
+	}
+	
+	if(type->kind == FUNC) {
+		if(is_imported_type(type->returntype))
+			return true;
+		
+		array_for(type->paramtypes, i) {
+			if(is_imported_type(type->paramtypes[i]))
+				return true;
+		}
+	}
+	
+	return
+		(type->kind == STRUCT || type->kind == UNION || type->kind == ENUM) &&
+		type->decl->imported;
+}
+
+static void scan_header_stmt(Stmt *stmt, void *ctx)
+{
+	HeaderScan *scan = ctx;
+	scan->nodes ++;
+	
+	if(stmt->kind == VAR && is_imported_type(stmt->as_decl.type))
+		scan->blocked = true;
+}
+
+static void scan_header_expr(Expr *expr, void *ctx)
+{
+	HeaderScan *scan = ctx;
+	scan->nodes ++;
+	
+	if(is_imported_type(expr->type))
+		scan->blocked = true;
+	
+	if(
+		expr->kind == VAR &&
+		(expr->decl->imported || expr->decl->builtin)
+	) {
+		scan->blocked = true;
+	}
+}
+
+static void export_header_ref(Expr *expr, void *ctx)
+{
+	make_type_exportable(expr->type);
+	
+	if(expr->kind == VAR && !expr->decl->scope->parent) {
+		expr->decl->header_visible = 1;
+		make_type_exportable(expr->decl->type);
+	}
+}
+
+static void export_header_local(Stmt *stmt, void *ctx)
+{
+	if(stmt->kind == VAR)
+		make_type_exportable(stmt->as_decl.type);
+}
+
+static void inline_in_header(Decl *func)
+{
+	HeaderScan scan = {0};
+	walk_block(func->body, scan_header_stmt, scan_header_expr, &scan);
+	
+	if(
+		scan.blocked ||
+		!func->isinline && scan.nodes > HEADER_INLINE_MAX_NODES
+	) {
+		return;
+	}
+	
+	func->inheader = 1;
+	header_count ++;
+	walk_block(func->body, export_header_local, export_header_ref, 0);
+}
+
+void optimize(Unit *unit, BuildOptions *_options)
+{
+	options = _options;
+	hoisted_count = 0;
+	byref_count = 0;
+	in_place_count = 0;
+	propagated_count = 0;
+	dead_branch_count = 0;
+	ctfe_count = 0;
+	inlined_count = 0;
+	header_count = 0;
+	pure_count = 0;
+	const_count = 0;
+	noreturn_count = 0;
+	addressed = 0;
+	stored = 0;
+	direct_callees = 0;
+	func_values = 0;
+	walk_block(unit->block, scan_stored_stmt, scan_stored_expr, 0);
+	walk_block(unit->block, propagate_stmt, 0, 0);
+	walk_block(unit->block, scan_values_stmt, scan_values_expr, 0);
+	walk_block(unit->block, 0, scan_addressed_expr, 0);
+	
+	o_stmts(unit->block->stmts);
+	classify_funcs(unit);
+	
+	array_for(unit->block->stmts, i) {
+		Decl *decl = &unit->block->stmts[i]->as_decl;
+		
+		if(decl->kind == FUNC && decl->exported && decl->body)
+			inline_in_header(decl);
+	}
+	
+	#ifdef JA_DEBUG
+	printf("propagated %" PRId64 " constants\n", propagated_count);
+	printf("eliminated %" PRId64 " dead branches\n", dead_branch_count);
+	printf("evaluated %" PRId64 " calls at compile time\n", ctfe_count);
+	printf("inlined %" PRId64 " calls\n", inlined_count);
+	printf("defined %" PRId64 " functions in the header\n", header_count);
+	
+	printf(
+		"found %" PRId64 " pure, %" PRId64 " const and %" PRId64
+		" noreturn functions\n", pure_count, const_count, noreturn_count
+	);
+	printf("hoisted %" PRId64 " loop invariants\n", hoisted_count);
+	printf("passed %" PRId64 " params without copy\n", byref_count);
+	printf("constructed %" PRId64 " array results in place\n", in_place_count);
+	#endif
+}
+
+/*
+	Dead code elimination
+	
+	Starting from the top level code of every unit, which all runs when the
+	program starts, functions and global variables are marked as they are
+	referenced by calls, function values or reads. Imported declarations are
+	copies, so the declaration in the imported unit is marked instead. A
+	global is a root itself if it gets its value at run time.
+*/
+
+static Decl **reached;
+static int64_t func_count;
+static int64_t dead_func_count;
+static int64_t var_count;
+static int64_t dead_var_count;
+
+static void reach(Decl *decl)
+{
+	decl = original_decl(decl);
+	
+	if(!decl->reachable) {
+		decl->reachable = 1;
+		array_push(reached, decl);
+	}
+}
+
+static void reach_expr(Expr *expr, void *ctx)
+{
+	if(
+		expr->kind == VAR &&
+		(expr->decl->kind == FUNC || !expr->decl->scope->parent)
+	) {
+		reach(expr->decl);
+	}
+}
+
+static void reach_top_level_stmt(Stmt *stmt, void *ctx)
+{
+	Decl *decl = &stmt->as_decl;
+	
+	if(
+		stmt->kind == VAR && !stmt->scope->parent &&
+		decl->init && !decl->init->isconst
+	) {
+		reach(decl);
+	}
+}
+
+static void count_dead_decls(Unit *unit)
+{
+	array_for(unit->block->stmts, i) {
+		Decl *decl = &unit->block->stmts[i]->as_decl;
+		
+		if(decl->kind == FUNC && !decl->imported) {
+			func_count ++;
+			if(!decl->reachable) dead_func_count ++;
+		}
+		else if(decl->kind == VAR) {
+			var_count ++;
+			if(!decl->reachable) dead_var_count ++;
+		}
+	}
+}
+
+void eliminate_dead_code(Unit **units)
+{
+	reached = 0;
+	func_count = 0;
+	dead_func_count = 0;
+	var_count = 0;
+	dead_var_count = 0;
+	
+	array_for(units, i) {
+		Scope *scope = units[i]->block->scope;
+		
+		// builtins and foreign symbols are set up by the unit's main function
+		array_for(scope->decls, j) {
+			if(scope->decls[j]->builtin) reach(scope->decls[j]);
+		}
+		
+		array_for(scope->foreigns, j) {
+			array_for(scope->foreigns[j]->decls, k) {
+				reach(scope->foreigns[j]->decls[k]);
+			}
+		}
+		
+		walk_block(units[i]->block, reach_top_level_stmt, reach_expr, 0);
+	}
+	
+	// reached grows while it is walked
+	array_for(reached, i) {
+		Decl *decl = reached[i];
+		
+		if(decl->kind == FUNC)
+			walk_block(decl->body, 0, reach_expr, 0);
+		else
+			walk_expr(decl->init, reach_expr, 0);
+	}
+	
+	array_for(units, i) {
+		count_dead_decls(units[i]);
+	}
+	
+	#ifdef JA_DEBUG
+	printf(
+		"removed %" PRId64 " of %" PRId64 " functions, "
+		"%" PRId64 " of %" PRId64 " global variables\n",
+		dead_func_count, func_count, dead_var_count, var_count
+	);
+	#endif
+}
@@ -0,0 +1,14 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "build.h"
+
+void optimize(Unit *unit, BuildOptions *options);
+
+/*
+	Mark the functions and global variables of all units that can be reached
+	from their top level code. Code is only generated for those.
+*/
+void eliminate_dead_code(Unit **units);
+
+#endif
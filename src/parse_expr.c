@@ -20,19 +20,35 @@ static Expr *p_var()
 {
 	if(!eat(TK_IDENT)) return 0;
 	Token *ident = last;
-	return new_var_expr(ident, 0);
+	Expr *expr = new_var_expr(ident, 0);
+	Decl *decl = lookup(ident->id);
+	
+	// constants are replaced by their value during analysis
+	if(decl && decl->kind == VAR && decl->isconst) {
+		expr->isconst = 1;
+		expr->islvalue = 0;
+	}
+	
+	return expr;
 }
 
 static Expr *p_new()
 {
 	if(!eat(TK_new)) return 0;
 	Token *start = last;
+	Expr *allocator = 0;
+	
+	if(eat(TK_LPAREN)) {
+		allocator = p_expr();
+		if(!allocator) fatal_after(last, "expected arena or pool");
+		if(!eat(TK_RPAREN)) fatal_after(last, "expected )");
+	}
 	
 	Token *t_start = cur;
 	Type *obj_type = p_type();
 	if(!obj_type) fatal_at(t_start, "expected type of object to create");
 	
-	return new_new_expr(start, obj_type);
+	return new_new_expr(start, obj_type, allocator);
 }
 
 static Expr *p_array()
@@ -45,6 +45,21 @@ static void declare_builtins()
 	argv->builtin = 1;
 	
 	declare(argv);
+	
+	// flush() writes out what print has buffered so far
+	Token *flush_id = create_id("flush", 0);
+	
+	Decl *flush = new_func(
+		flush_id, scope, flush_id, 0, new_type(NONE), 0,
+		new_scope(unit_id, scope)
+	);
+	
+	flush->builtin = 1;
+	flush->isproto = 1;
+	flush->deps_scanned = 1;
+	flush->private_id = "jaflush";
+	
+	declare(flush);
 }
 
 static void enter()
@@ -144,11 +159,42 @@ static Stmt *p_vardecl(int exported, int foreign)
 	return core;
 }
 
-static Decl *p_funchead(int exported)
+static Stmt *p_constdecl(int exported)
 {
-	if(!eat(TK_function)) return 0;
+	if(!eat(TK_const)) return 0;
 	Token *start = last;
 	
+	Stmt *core = p_vardecl_core(start, exported, 0, 0);
+	if(!core) fatal_after(last, "expected identifier after keyword const");
+	
+	Decl *decl = &core->as_decl;
+	
+	if(!decl->init)
+		fatal_after(last, "expected value of constant %t", decl->id);
+	
+	if(!decl->init->isconst)
+		fatal_at(decl->init->start, "value of constant must be constant");
+	
+	decl->isconst = 1;
+	
+	if(!eat(TK_SEMICOLON))
+		error_after(last, "expected semicolon after constant declaration");
+	
+	return core;
+}
+
+static Decl *p_funchead(int exported)
+{
+	Token *start = cur;
+	bool isinline = eat(TK_inline);
+	
+	if(!eat(TK_function)) {
+		if(isinline)
+			fatal_after(last, "expected keyword function after inline");
+		
+		return 0;
+	}
+	
 	if(scope->parent)
 		fatal_at(last, "functions can only be declared at top level");
 	
@@ -185,6 +231,7 @@ static Decl *p_funchead(int exported)
 		start, scope, ident->id, exported, returntype, params, func_scope
 	);
 	
+	decl->isinline = isinline;
 	func_scope->funchost = decl;
 	
 	if(!declare(decl))
@@ -198,8 +245,12 @@ static Stmt *p_foreign_func(int exported)
 	Decl *decl = p_funchead(exported);
 	if(!decl) return 0;
 	
+	if(decl->isinline)
+		fatal_at(decl->start, "foreign functions can not be inline");
+	
 	decl->imported = 1;
 	decl->isproto = 1;
+	decl->cfunc = 1;
 	decl->deps_scanned = 1;
 	
 	if(!eat(TK_SEMICOLON))
@@ -563,6 +614,7 @@ static Stmt *p_foreign()
 	if(scope->parent)
 		fatal_at(last, "foreign imports can only be used at top level");
 	
+	int isstatic = eat(TK_static) != 0;
 	Token *filename = eat(TK_STRING);
 	if(!filename) fatal_at(cur, "expected filename of library to import from");
 	
@@ -582,7 +634,9 @@ static Stmt *p_foreign()
 	if(!eat(TK_RCURLY))
 		fatal_after(last, "expected } after library list");
 	
-	Foreign *import = new_foreign(start, scope, filename->string, decls);
+	Foreign *import = new_foreign(
+		start, scope, filename->string, decls, isstatic
+	);
 	array_push(scope->foreigns, import);
 	return (Stmt*)import;
 }
@@ -597,13 +651,16 @@ static Stmt *p_export()
 	
 	Stmt *stmt = 0;
 	(stmt = p_vardecl(1, 0)) ||
+	(stmt = p_constdecl(1)) ||
 	(stmt = p_funcdecl(1)) ||
 	(stmt = p_structdecl(1)) ||
 	(stmt = p_enumdecl(1)) ;
 	
 	if(!stmt) {
 		fatal_at(
-			cur, "you can only export variables, structures or functions"
+			cur,
+			"you can only export variables, constants, structures or "
+			"functions"
 		);
 	}
 	
@@ -666,6 +723,7 @@ static Stmt *p_for()
 {
 	if(!eat(TK_for)) return 0;
 	Token *start = last;
+	bool byref = eat(TK_GREATER);
 	
 	Token *iter_name = eat(TK_IDENT);
 	if(!iter_name)
@@ -681,6 +739,9 @@ static Stmt *p_for()
 		if(!array)
 			fatal_after(last, "expected iterable");
 	}
+	else if(byref) {
+		fatal_at(cur, "expected 'in' after reference iterator");
+	}
 	else if(eat(TK_ASSIGN)) {
 		from = p_expr();
 		if(!from) fatal_at(last, "expected start value after =");
@@ -704,10 +765,13 @@ static Stmt *p_for()
 	Scope *blockscope = leave();
 	
 	if(array) {
-		ForEach *foreach = new_foreach(start, blockscope, array, iter, 0);
+		ForEach *foreach = new_foreach(
+			start, blockscope, array, iter, byref, 0
+		);
+		
 		blockscope->loophost = (Stmt*)foreach;
 		foreach->body = p_block(blockscope);
-	
+		
 		if(!eat(TK_RCURLY))
 			fatal_after(last, "expected } after for-body");
 		
@@ -717,7 +781,7 @@ static Stmt *p_for()
 		For *forstmt = new_for(start, blockscope, iter, from, to, 0);
 		blockscope->loophost = (Stmt*)forstmt;
 		forstmt->body = p_block(blockscope);
-	
+		
 		if(!eat(TK_RCURLY))
 			fatal_after(last, "expected } after for-body");
 		
@@ -729,18 +793,34 @@ static Stmt *p_delete()
 {
 	if(!eat(TK_delete)) return 0;
 	Token *start = last;
-	Expr *expr = p_expr();
+	Token *paren = cur;
+	Expr *allocator = 0;
+	Expr *expr = 0;
+	
+	// delete(pool) obj, unless the parentheses start the object itself
+	if(eat(TK_LPAREN)) {
+		allocator = p_expr();
+		
+		if(allocator && eat(TK_RPAREN))
+			expr = p_expr();
+		
+		if(!expr) {
+			cur = paren;
+			last = start;
+			allocator = 0;
+		}
+	}
 	
 	if(!expr)
-		fatal_after(last, "expected object to delete");
+		expr = p_expr();
 	
-	if(expr->type->kind != PTR)
-		fatal_at(expr->start, "expression to delete is not a pointer");
+	if(!expr)
+		fatal_after(last, "expected object to delete");
 	
 	if(!eat(TK_SEMICOLON))
 		error_after(last, "expected semicolon after delete");
 	
-	return (Stmt*)new_delete(start, scope, expr);
+	return (Stmt*)new_delete(start, scope, expr, allocator);
 }
 
 static Stmt *p_stmt()
@@ -748,6 +828,7 @@ static Stmt *p_stmt()
 	Stmt *stmt = 0;
 	(stmt = p_print()) ||
 	(stmt = p_vardecl(0, 0)) ||
+	(stmt = p_constdecl(0)) ||
 	(stmt = p_funcdecl(0)) ||
 	(stmt = p_structdecl(0)) ||
 	(stmt = p_enumdecl(0)) ||
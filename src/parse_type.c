@@ -25,6 +25,8 @@ static Type *p_primtype()
 	if(eat(TK_string)) return new_type(STRING);
 	if(eat(TK_cstring)) return new_type(CSTRING);
 	if(eat(TK_ptr)) return new_ptr_type(new_type(NONE));
+	if(eat(TK_arena)) return new_type(ARENA);
+	if(eat(TK_builder)) return new_type(BUILDER);
 	return 0;
 }
 
@@ -46,30 +48,84 @@ static Type *p_ptrtype()
 	return new_ptr_type(subtype);
 }
 
+static Type *p_pooltype()
+{
+	if(!eat(TK_pool)) return 0;
+	
+	Type *itemtype = p_type();
+	if(!itemtype)
+		fatal_at(last, "expected item type");
+	
+	return new_pool_type(itemtype);
+}
+
+static Type *p_maptype()
+{
+	if(!eat(TK_map)) return 0;
+	
+	if(!eat(TK_LBRACK))
+		fatal_after(last, "expected [");
+	
+	Type *keytype = p_type();
+	if(!keytype)
+		fatal_at(last, "expected key type");
+	
+	if(!eat(TK_RBRACK))
+		fatal_after(last, "expected ]");
+	
+	Type *itemtype = p_type();
+	if(!itemtype)
+		fatal_at(last, "expected value type");
+	
+	return new_map_type(keytype, itemtype);
+}
+
 static Type *p_arraytype()
 {
 	if(!eat(TK_LBRACK)) return 0;
 	
+	if(eat(TK_DOTDOT)) {
+		if(!eat(TK_RBRACK))
+			fatal_after(last, "expected ]");
+		
+		Type *itemtype = p_type();
+		if(!itemtype)
+			fatal_at(last, "expected item type");
+		
+		return new_dynarray_type(itemtype);
+	}
+	
 	Token *length = eat(TK_INT);
+	Token *length_id = length ? 0 : eat(TK_IDENT);
 	
 	if(length && length->ival <= 0)
 		fatal_at(length, "array length must be greater than 0");
 	
 	if(!eat(TK_RBRACK)) {
-		if(length)
+		if(length || length_id)
 			fatal_after(last, "expected ]");
 		else
-			fatal_after(last, "expected integer literal for array length");
+			fatal_after(
+				last, "expected integer literal or constant for array length"
+			);
 	}
 	
 	Type *itemtype = p_type();
 	if(!itemtype)
 		fatal_at(last, "expected item type");
 	
-	if(length)
+	if(length) {
 		return new_array_type(length->ival, itemtype);
-	else
+	}
+	else if(length_id) {
+		// the length is looked up when the type is analyzed
+		Type *type = new_array_type(0, itemtype);
+		type->length_id = length_id;
+		return type;
+	}
+	else {
 		return new_slice_type(itemtype);
+	}
 }
 
 static Type *p_type()
@@ -78,6 +134,8 @@ static Type *p_type()
 	(type = p_primtype()) ||
 	(type = p_nametype()) ||
 	(type = p_ptrtype()) ||
+	(type = p_pooltype()) ||
+	(type = p_maptype()) ||
 	(type = p_arraytype()) ;
 	return type;
 }
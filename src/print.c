@@ -358,7 +358,12 @@ static void fprint_type(FILE *fs, Type *type)
 			break;
 		case ARRAY:
 			fprintf(fs, "[");
-			fprint_int(fs, type->length);
+			
+			if(type->length_id)
+				fprint_ident(fs, type->length_id);
+			else
+				fprint_int(fs, type->length);
+			
 			fprintf(fs, "]");
 			fprint_type(fs, type->itemtype);
 			break;
@@ -366,6 +371,27 @@ static void fprint_type(FILE *fs, Type *type)
 			fprintf(fs, "[]");
 			fprint_type(fs, type->itemtype);
 			break;
+		case DYNARRAY:
+			fprintf(fs, "[..]");
+			fprint_type(fs, type->itemtype);
+			break;
+		case ARENA:
+			fprint_keyword_cstr(fs, "arena");
+			break;
+		case POOL:
+			fprint_keyword_cstr(fs, "pool ");
+			fprint_type(fs, type->itemtype);
+			break;
+		case BUILDER:
+			fprint_keyword_cstr(fs, "builder");
+			break;
+		case MAP:
+			fprint_keyword_cstr(fs, "map");
+			fprintf(fs, "[");
+			fprint_type(fs, type->keytype);
+			fprintf(fs, "]");
+			fprint_type(fs, type->itemtype);
+			break;
 		case FUNC:
 			fprintf(fs, "(");
 			array_for(type->paramtypes, i) {
@@ -480,6 +506,13 @@ static void print_expr(Expr *expr)
 			break;
 		case NEW:
 			print_keyword_cstr("new ");
+			
+			if(expr->allocator) {
+				printf("(");
+				print_expr(expr->allocator);
+				printf(") ");
+			}
+			
 			print_type(expr->type->subtype);
 			break;
 		case ENUM:
@@ -495,6 +528,18 @@ static void print_expr(Expr *expr)
 		case COMPLEMENT:
 			printf("~(");
 			print_expr(expr->subexpr);
+			printf(")");
+			break;
+		case DYNCALL:
+			printf("(");
+			print_expr(expr->array);
+			printf(").%s(", dynop_names[expr->dynop]);
+			
+			array_for(expr->args, i) {
+				if(i > 0) printf(", ");
+				print_expr(expr->args[i]);
+			}
+			
 			printf(")");
 			break;
 	}
@@ -516,6 +561,7 @@ static void print_vardecl_core(Decl *decl)
 
 static void print_func(Decl *func)
 {
+	if(func->isinline) print_keyword_cstr("inline ");
 	print_keyword_cstr("function ");
 	print_ident(func->id);
 	printf("(");
@@ -577,7 +623,7 @@ static void print_stmt(Stmt *stmt)
 			break;
 		case VAR:
 			if(stmt->as_decl.exported) print_keyword_cstr("export ");
-			print_keyword_cstr("var ");
+			print_keyword_cstr(stmt->as_decl.isconst ? "const " : "var ");
 			print_vardecl_core((Decl*)stmt);
 			break;
 		case FUNC:
@@ -668,6 +714,10 @@ static void print_stmt(Stmt *stmt)
 			break;
 		case FOREIGN:
 			print_keyword_cstr("foreign ");
+			
+			if(stmt->as_foreign.isstatic)
+				print_keyword_cstr("static ");
+			
 			printf(
 				COL_MAGENTA "\"%s\"" COL_RESET " {\n",
 				stmt->as_foreign.filename
@@ -700,6 +750,7 @@ static void print_stmt(Stmt *stmt)
 			break;
 		case FOREACH:
 			print_keyword_cstr("for ");
+			if(stmt->as_foreach.byref) printf(">");
 			print_ident(stmt->as_foreach.iter->id);
 			print_keyword_cstr(" in ");
 			print_expr(stmt->as_foreach.array);
@@ -712,6 +763,13 @@ static void print_stmt(Stmt *stmt)
 			break;
 		case DELETE:
 			print_keyword_cstr("delete ");
+			
+			if(stmt->as_delete.allocator) {
+				printf("(");
+				print_expr(stmt->as_delete.allocator);
+				printf(") ");
+			}
+			
 			print_expr(stmt->as_delete.expr);
 			break;
 		case ENUM:
@@ -749,16 +807,8 @@ void print_ast(Block *block)
 	print_block(block);
 }
 
-void print_c_code(char *c_filename)
+void print_c_code(char *c_code, int64_t length)
 {
 	printf(COL_YELLOW "=== code ===" COL_RESET "\n");
-	FILE *fs = fopen(c_filename, "rb");
-	
-	while(!feof(fs)) {
-		int ch = fgetc(fs);
-		if(ch == EOF) break;
-		fputc(ch, stdout);
-	}
-	
-	fclose(fs);
+	fwrite(c_code, 1, length, stdout);
 }
@@ -30,6 +30,6 @@ void print_error(
 
 void print_tokens(Token *tokens);
 void print_ast(Block *block);
-void print_c_code(char *c_filename);
+void print_c_code(char *c_code, int64_t length);
 
 #endif
@@ -1,5 +1,16 @@
+#define _DEFAULT_SOURCE
+#include <unistd.h>
+#include <sys/mman.h>
 #include "runtime.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+char japrint_buf[JAPRINT_BUF_SIZE];
+int64_t japrint_len;
+static int japrint_linebuf = -1;
+
 jastring ja_read_file(jastring filename)
 {
 	FILE *fs = fopen(filename.string, "rb");
@@ -13,3 +24,600 @@ jastring ja_read_file(jastring filename)
 	fclose(fs);
 	return (jastring){.length = len, .string = text};
 }
+
+_Noreturn void jabounds_fail(int64_t index, int64_t length, char *where)
+{
+	jaflush();
+	
+	fprintf(
+		stderr,
+		"%s: error: index %" PRId64 " is out of range 0 .. %" PRId64 "\n",
+		where, index, length - 1
+	);
+	
+	exit(EXIT_FAILURE);
+}
+
+static _Noreturn void jaout_of_memory()
+{
+	jaflush();
+	fprintf(stderr, "error: out of memory\n");
+	exit(EXIT_FAILURE);
+}
+
+_Noreturn void jadynarray_fail(char *msg, char *where)
+{
+	jaflush();
+	fprintf(stderr, "%s: error: %s\n", where, msg);
+	exit(EXIT_FAILURE);
+}
+
+/*
+	Grow the buffer to hold at least capacity items, at least doubling it;
+	returns keep moved along if it pointed into the old buffer
+*/
+void *jadynarray_grow(
+	jadynarray *array, int64_t capacity, int64_t itemsize, void *keep
+) {
+	int64_t new_cap = array->capacity * 2;
+	
+	if(new_cap < capacity) new_cap = capacity;
+	if(new_cap < 8) new_cap = 8;
+	
+	// the old buffer must not be looked at once realloc has freed it
+	uintptr_t offset = (uintptr_t)keep - (uintptr_t)array->items;
+	jabool inside = keep && offset < (uintptr_t)(array->length * itemsize);
+	char *items = realloc(array->items, new_cap * itemsize);
+	
+	if(items == 0)
+		jaout_of_memory();
+	
+	if(inside)
+		keep = items + offset;
+	
+	array->items = items;
+	array->capacity = new_cap;
+	return keep;
+}
+
+/*
+	Write the decimal digits of val backwards from end, returns the first
+*/
+static char *jaformat_uint(char *end, uint64_t val)
+{
+	do {
+		*--end = '0' + val % 10;
+		val /= 10;
+	} while(val);
+	
+	return end;
+}
+
+jastring jastring_concat(int64_t count, jastring *parts)
+{
+	int64_t length = 0;
+	
+	for(int64_t i = 0; i < count; i ++) {
+		length += parts[i].length;
+	}
+	
+	char *string = malloc(length + 1);
+	char *cursor = string;
+	
+	if(string == 0)
+		jaout_of_memory();
+	
+	for(int64_t i = 0; i < count; i ++) {
+		memcpy(cursor, parts[i].string, parts[i].length);
+		cursor += parts[i].length;
+	}
+	
+	*cursor = 0;
+	return (jastring){.length = length, .string = string};
+}
+
+void jabuilder_append_uint(jabuilder *builder, uint64_t val)
+{
+	char digits[20];
+	char *end = digits + sizeof(digits);
+	char *start = jaformat_uint(end, val);
+	jadynarray_append(builder, start, end - start, 1);
+}
+
+void jabuilder_append_int(jabuilder *builder, int64_t val)
+{
+	if(val < 0) {
+		jabuilder_push(builder, '-');
+		jabuilder_append_uint(builder, -(uint64_t)val);
+	}
+	else {
+		jabuilder_append_uint(builder, val);
+	}
+}
+
+/*
+	The string keeps the buffer, terminated for use as a cstring
+*/
+jastring jabuilder_finish(jabuilder *builder)
+{
+	jabuilder_push(builder, 0);
+	jastring string = {.length = builder->length - 1, .string = builder->items};
+	*builder = (jabuilder){0};
+	return string;
+}
+
+#define JAMAP_GROUP 16
+#define JAMAP_EMPTY 0x80
+#define JAMAP_DELETED 0xfe
+
+static uint64_t jamap_hash(jamap_layout *layout, void *key)
+{
+	uint64_t hash = 0;
+	
+	if(layout->strkey) {
+		jastring string = *(jastring*)key;
+		hash = 0xcbf29ce484222325;
+		
+		for(int64_t i = 0; i < string.length; i ++) {
+			hash = (hash ^ (uint8_t)string.string[i]) * 0x100000001b3;
+		}
+	}
+	else {
+		memcpy(&hash, key, layout->keysize);
+	}
+	
+	// mix all bits into the low seven of the control byte
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccd;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+static jabool jamap_key_equ(jamap_layout *layout, void *left, void *right)
+{
+	if(layout->strkey)
+		return jastring_equ(*(jastring*)left, *(jastring*)right);
+	
+	return memcmp(left, right, layout->keysize) == 0;
+}
+
+/*
+	Bit i is set if control byte i of the group equals byte
+*/
+static uint32_t jamap_match(uint8_t *group, uint8_t byte)
+{
+#ifdef __SSE2__
+	__m128i ctrl = _mm_loadu_si128((__m128i*)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+#else
+	uint32_t mask = 0;
+	
+	for(int i = 0; i < JAMAP_GROUP; i ++) {
+		mask |= (uint32_t)(group[i] == byte) << i;
+	}
+	
+	return mask;
+#endif
+}
+
+/*
+	Bit i is set if slot i of the group is empty or deleted
+*/
+static uint32_t jamap_match_free(uint8_t *group)
+{
+#ifdef __SSE2__
+	return _mm_movemask_epi8(_mm_loadu_si128((__m128i*)group));
+#else
+	uint32_t mask = 0;
+	
+	for(int i = 0; i < JAMAP_GROUP; i ++) {
+		mask |= (uint32_t)(group[i] >> 7) << i;
+	}
+	
+	return mask;
+#endif
+}
+
+static int64_t jamap_round(int64_t size, int64_t align)
+{
+	return (size + align - 1) / align * align;
+}
+
+static int64_t jamap_val_offset(jamap_layout *layout)
+{
+	return jamap_round(layout->keysize, layout->valalign);
+}
+
+static int64_t jamap_entry_size(jamap_layout *layout)
+{
+	int64_t align = layout->keyalign > layout->valalign ?
+		layout->keyalign : layout->valalign;
+	
+	return jamap_round(jamap_val_offset(layout) + layout->valsize, align);
+}
+
+/*
+	Returns the slot of key or -1; probing goes group by group in triangular
+	steps, which visits every group of a power of two count, and stops at the
+	first group with an empty slot
+*/
+static int64_t jamap_find_slot(
+	jamap *map, jamap_layout *layout, void *key, uint64_t hash
+) {
+	if(map->capacity == 0) return -1;
+	
+	int64_t entry_size = jamap_entry_size(layout);
+	uint64_t mask = map->capacity / JAMAP_GROUP - 1;
+	uint64_t pos = (hash >> 7) & mask;
+	
+	for(uint64_t step = 1;; step ++) {
+		uint8_t *group = map->ctrl + pos * JAMAP_GROUP;
+		uint32_t match = jamap_match(group, hash & 0x7f);
+		
+		while(match) {
+			int64_t slot = pos * JAMAP_GROUP + __builtin_ctz(match);
+			char *entry = map->entries + slot * entry_size;
+			
+			if(jamap_key_equ(layout, entry, key)) return slot;
+			
+			match &= match - 1;
+		}
+		
+		if(jamap_match(group, JAMAP_EMPTY)) return -1;
+		
+		pos = (pos + step) & mask;
+	}
+}
+
+/*
+	First empty or deleted slot on the probe sequence of hash
+*/
+static int64_t jamap_free_slot(jamap *map, uint64_t hash)
+{
+	uint64_t mask = map->capacity / JAMAP_GROUP - 1;
+	uint64_t pos = (hash >> 7) & mask;
+	
+	for(uint64_t step = 1;; step ++) {
+		uint32_t match = jamap_match_free(map->ctrl + pos * JAMAP_GROUP);
+		
+		if(match) return pos * JAMAP_GROUP + __builtin_ctz(match);
+		
+		pos = (pos + step) & mask;
+	}
+}
+
+/*
+	Move all entries into a new table, doubling it unless dropping the
+	deleted slots frees enough room
+*/
+static void jamap_rehash(jamap *map, jamap_layout *layout)
+{
+	int64_t entry_size = jamap_entry_size(layout);
+	int64_t capacity = map->capacity;
+	
+	if(capacity == 0)
+		capacity = JAMAP_GROUP;
+	else if(map->length >= capacity * 7 / 16)
+		capacity *= 2;
+	
+	uint8_t *ctrl = malloc(capacity + capacity * entry_size);
+	
+	if(ctrl == 0)
+		jaout_of_memory();
+	
+	memset(ctrl, JAMAP_EMPTY, capacity);
+	
+	jamap old = *map;
+	map->capacity = capacity;
+	map->growth_left = capacity * 7 / 8 - old.length;
+	map->ctrl = ctrl;
+	map->entries = (char*)ctrl + capacity;
+	
+	for(int64_t i = 0; i < old.capacity; i ++) {
+		if(old.ctrl[i] & 0x80) continue;
+		
+		char *entry = old.entries + i * entry_size;
+		uint64_t hash = jamap_hash(layout, entry);
+		int64_t slot = jamap_free_slot(map, hash);
+		
+		map->ctrl[slot] = hash & 0x7f;
+		memcpy(map->entries + slot * entry_size, entry, entry_size);
+	}
+	
+	free(old.ctrl);
+}
+
+void *jamap_find(jamap *map, jamap_layout *layout, void *key)
+{
+	uint64_t hash = jamap_hash(layout, key);
+	int64_t slot = jamap_find_slot(map, layout, key, hash);
+	
+	if(slot < 0) return 0;
+	
+	return
+		map->entries + slot * jamap_entry_size(layout) +
+		jamap_val_offset(layout);
+}
+
+/*
+	Returns the value of key, a new key gets a zero value
+*/
+void *jamap_insert(jamap *map, jamap_layout *layout, void *key)
+{
+	int64_t entry_size = jamap_entry_size(layout);
+	uint64_t hash = jamap_hash(layout, key);
+	int64_t slot = jamap_find_slot(map, layout, key, hash);
+	
+	if(slot < 0) {
+		if(map->growth_left == 0)
+			jamap_rehash(map, layout);
+		
+		slot = jamap_free_slot(map, hash);
+		
+		// reusing a deleted slot does not use up an empty one
+		if(map->ctrl[slot] == JAMAP_EMPTY)
+			map->growth_left --;
+		
+		char *entry = map->entries + slot * entry_size;
+		map->ctrl[slot] = hash & 0x7f;
+		memset(entry, 0, entry_size);
+		memcpy(entry, key, layout->keysize);
+		map->length ++;
+	}
+	
+	return map->entries + slot * entry_size + jamap_val_offset(layout);
+}
+
+/*
+	A slot can go back to empty only if its group still has an empty slot,
+	then no probe sequence passes beyond the group
+*/
+void jamap_remove(jamap *map, jamap_layout *layout, void *key)
+{
+	uint64_t hash = jamap_hash(layout, key);
+	int64_t slot = jamap_find_slot(map, layout, key, hash);
+	
+	if(slot < 0) return;
+	
+	uint8_t *group = map->ctrl + slot / JAMAP_GROUP * JAMAP_GROUP;
+	
+	if(jamap_match(group, JAMAP_EMPTY)) {
+		map->ctrl[slot] = JAMAP_EMPTY;
+		map->growth_left ++;
+	}
+	else {
+		map->ctrl[slot] = JAMAP_DELETED;
+	}
+	
+	map->length --;
+}
+
+void jamap_clear(jamap *map)
+{
+	free(map->ctrl);
+	*map = (jamap){0};
+}
+
+#ifndef JA_SYSTEM_MALLOC
+
+_Thread_local void *jaheap_lists[JAHEAP_CLASSES];
+
+static int64_t jaheap_class_size(int sizeclass)
+{
+	return sizeclass < 16 ? (sizeclass + 1) * 16 : 1 << (sizeclass - 7);
+}
+
+void *jaheap_map(int64_t size)
+{
+	void *ptr = mmap(
+		0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+	);
+	
+	if(ptr == MAP_FAILED)
+		jaout_of_memory();
+	
+	return ptr;
+}
+
+void jaheap_unmap(void *ptr, int64_t size)
+{
+	munmap(ptr, size);
+}
+
+/*
+	Carve a fresh chunk into objects of the size class, hand out the first
+	and put the rest on the list of this thread. Chunks are never unmapped,
+	freed objects only go back to a list
+*/
+void *jaheap_refill(int sizeclass)
+{
+	int64_t size = jaheap_class_size(sizeclass);
+	char *chunk = jaheap_map(JAHEAP_CHUNK_SIZE);
+	
+	// not every class size divides the chunk, the rest stays unused
+	int64_t count = JAHEAP_CHUNK_SIZE / size;
+	char *last = chunk + (count - 1) * size;
+	
+	for(char *obj = chunk + size; obj < last; obj += size) {
+		*(void**)obj = obj + size;
+	}
+	
+	*(void**)last = jaheap_lists[sizeclass];
+	jaheap_lists[sizeclass] = chunk + size;
+	return chunk;
+}
+
+#endif
+
+/*
+	Move on to the next block that fits, blocks too small for this size are
+	skipped but stay in the chain; a new block is linked in after the
+	current one
+*/
+void *jaarena_alloc_slow(jaarena *arena, int64_t size)
+{
+	jaarena_block *block = arena->current ? arena->current->next : 0;
+	
+	while(block && block->size < size) {
+		block = block->next;
+	}
+	
+	if(!block) {
+		int64_t block_size = size > JAARENA_BLOCK_SIZE ?
+			size : JAARENA_BLOCK_SIZE;
+		
+		block = malloc(sizeof(jaarena_block) + block_size);
+		
+		if(block == 0)
+			jaout_of_memory();
+		
+		block->size = block_size;
+		
+		if(arena->current) {
+			block->next = arena->current->next;
+			arena->current->next = block;
+		}
+		else {
+			block->next = 0;
+			arena->first = block;
+		}
+	}
+	
+	arena->current = block;
+	arena->cursor = (char*)(block + 1) + size;
+	arena->end = (char*)(block + 1) + block->size;
+	return block + 1;
+}
+
+typedef struct JaLib {
+	struct JaLib *next;
+	char *filename;
+	void *handle;
+} JaLib;
+
+static JaLib *jalibs;
+
+void *jaforeign_lib(char *filename)
+{
+	for(JaLib *lib = jalibs; lib; lib = lib->next) {
+		if(strcmp(lib->filename, filename) == 0) return lib->handle;
+	}
+	
+	void *handle = dlopen(filename, RTLD_LAZY);
+	
+	if(handle == 0) {
+		jaflush();
+		fprintf(stderr, "error: could not load library %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	
+	JaLib *lib = malloc(sizeof(JaLib));
+	*lib = (JaLib){.next = jalibs, .filename = filename, .handle = handle};
+	jalibs = lib;
+	return handle;
+}
+
+void *jaforeign_bind(char *filename, char *name)
+{
+	void *sym = dlsym(jaforeign_lib(filename), name);
+	
+	if(sym == 0) {
+		jaflush();
+		fprintf(stderr, "error: could not load symbol %s\n", name);
+		exit(EXIT_FAILURE);
+	}
+	
+	return sym;
+}
+
+void japrint_drain()
+{
+	fwrite(japrint_buf, 1, japrint_len, stdout);
+	japrint_len = 0;
+}
+
+void jaflush()
+{
+	japrint_sync();
+	fflush(stdout);
+}
+
+void japrint_raw_slow(char *data, int64_t length)
+{
+	japrint_sync();
+	
+	if(length > JAPRINT_BUF_SIZE) {
+		fwrite(data, 1, length, stdout);
+	}
+	else {
+		memcpy(japrint_buf, data, length);
+		japrint_len = length;
+	}
+}
+
+void japrint_string(jastring string)
+{
+	japrint_raw(string.string, string.length);
+}
+
+void japrint_uint(uint64_t val)
+{
+	char digits[20];
+	char *end = digits + sizeof(digits);
+	char *start = jaformat_uint(end, val);
+	japrint_raw(start, end - start);
+}
+
+void japrint_int(int64_t val)
+{
+	if(val < 0) {
+		japrint_raw("-", 1);
+		japrint_uint(-(uint64_t)val);
+	}
+	else {
+		japrint_uint(val);
+	}
+}
+
+void japrint_bool(jabool val)
+{
+	if(val)
+		japrint_raw("true", 4);
+	else
+		japrint_raw("false", 5);
+}
+
+void japrint_ptr(void *ptr)
+{
+	static char hexdigits[] = "0123456789abcdef";
+	uintptr_t val = (uintptr_t)ptr;
+	char digits[2 + sizeof(val) * 2];
+	char *p = digits + sizeof(digits);
+	
+	if(!ptr) {
+		japrint_raw("(nil)", 5);
+		return;
+	}
+	
+	do {
+		*--p = hexdigits[val & 0xf];
+		val >>= 4;
+	} while(val);
+	
+	*--p = 'x';
+	*--p = '0';
+	japrint_raw(p, digits + sizeof(digits) - p);
+}
+
+void japrint_newline()
+{
+	japrint_raw("\n", 1);
+	
+	if(japrint_linebuf == -1)
+		japrint_linebuf = isatty(STDOUT_FILENO);
+	
+	if(japrint_linebuf)
+		jaflush();
+}
@@ -23,6 +23,395 @@ typedef struct {
 	char *string;
 } jastring;
 
+static inline jabool jastring_equ(jastring left, jastring right)
+{
+	return
+		left.length == right.length &&
+		memcmp(left.string, right.string, left.length) == 0;
+}
+
 jastring ja_read(jastring filename);
 
+/*
+	bounds checks
+	
+	emitted for subscripts when compiling with -bc, unless the analyzer can
+	prove the index to be in range
+*/
+
+__attribute__((cold))
+_Noreturn void jabounds_fail(int64_t index, int64_t length, char *where);
+
+static inline int64_t jabounds(int64_t index, int64_t length, char *where)
+{
+	if(__builtin_expect((uint64_t)index >= (uint64_t)length, 0))
+		jabounds_fail(index, length, where);
+	
+	return index;
+}
+
+static inline void *jaslice_item(
+	jaslice slice, int64_t index, int64_t itemsize, char *where
+) {
+	jabounds(index, slice.length, where);
+	return (char*)slice.items + index * itemsize;
+}
+
+static inline jastring jastring_item(
+	jastring string, int64_t index, char *where
+) {
+	jabounds(index, string.length, where);
+	return (jastring){1, string.string + index};
+}
+
+/*
+	growable arrays
+	
+	length and items come first as in jaslice; the buffer grows geometrically
+	out of line, so the inline fast paths only compare against the capacity
+*/
+
+typedef struct {
+	int64_t length;
+	void *items;
+	int64_t capacity;
+} jadynarray;
+
+__attribute__((cold))
+_Noreturn void jadynarray_fail(char *msg, char *where);
+
+void *jadynarray_grow(
+	jadynarray *array, int64_t capacity, int64_t itemsize, void *keep
+);
+
+static inline jaslice jadynarray_view(jadynarray array)
+{
+	return (jaslice){array.length, array.items};
+}
+
+static inline void jadynarray_append(
+	jadynarray *array, void *items, int64_t count, int64_t itemsize
+) {
+	int64_t length = array->length + count;
+	
+	// items may point into the buffer that is about to move
+	if(__builtin_expect(length > array->capacity, 0))
+		items = jadynarray_grow(array, length, itemsize, items);
+	
+	memcpy(
+		(char*)array->items + array->length * itemsize, items,
+		count * itemsize
+	);
+	
+	array->length = length;
+}
+
+static inline void jadynarray_append_slice(
+	jadynarray *array, jaslice slice, int64_t itemsize
+) {
+	jadynarray_append(array, slice.items, slice.length, itemsize);
+}
+
+static inline void *jadynarray_pop(
+	jadynarray *array, int64_t itemsize, char *where
+) {
+	if(__builtin_expect(array->length == 0, 0))
+		jadynarray_fail("pop from empty array", where);
+	
+	array->length --;
+	return (char*)array->items + array->length * itemsize;
+}
+
+static inline void jadynarray_reserve(
+	jadynarray *array, int64_t capacity, int64_t itemsize, char *where
+) {
+	if(__builtin_expect(capacity < 0, 0))
+		jadynarray_fail("negative capacity", where);
+	
+	if(capacity > array->capacity)
+		jadynarray_grow(array, capacity, itemsize, 0);
+}
+
+static inline void jadynarray_resize(
+	jadynarray *array, int64_t length, int64_t itemsize, char *where
+) {
+	if(__builtin_expect(length < 0, 0))
+		jadynarray_fail("negative length", where);
+	
+	if(length > array->capacity)
+		jadynarray_grow(array, length, itemsize, 0);
+	
+	if(length > array->length) {
+		memset(
+			(char*)array->items + array->length * itemsize, 0,
+			(length - array->length) * itemsize
+		);
+	}
+	
+	array->length = length;
+}
+
+/*
+	string builders and concatenation
+	
+	a builder is a growable array of bytes, finishing it hands the buffer
+	over to the string and leaves the builder empty. A chain of + on strings
+	is a single jastring_concat, which sums up the lengths and allocates once
+*/
+
+typedef jadynarray jabuilder;
+
+jastring jastring_concat(int64_t count, jastring *parts);
+void jabuilder_append_int(jabuilder *builder, int64_t val);
+void jabuilder_append_uint(jabuilder *builder, uint64_t val);
+jastring jabuilder_finish(jabuilder *builder);
+
+static inline void jabuilder_append(jabuilder *builder, jastring string)
+{
+	jadynarray_append(builder, string.string, string.length, 1);
+}
+
+static inline void jabuilder_push(jabuilder *builder, uint8_t byte)
+{
+	jadynarray_append(builder, &byte, 1, 1);
+}
+
+/*
+	maps
+	
+	open addressing in the manner of a Swiss table: each slot has a control
+	byte holding seven bits of the hash or marking it empty or deleted, a
+	lookup matches a whole group of 16 control bytes at once and compares only
+	the keys whose bits match. Keys and values are stored inline, the layout
+	gives their sizes. At least one slot in eight stays empty
+*/
+
+typedef struct {
+	int64_t length;
+	int64_t capacity;
+	int64_t growth_left;
+	uint8_t *ctrl;
+	char *entries;
+} jamap;
+
+typedef struct {
+	int64_t keysize;
+	int64_t keyalign;
+	int64_t valsize;
+	int64_t valalign;
+	jabool strkey;
+} jamap_layout;
+
+void *jamap_find(jamap *map, jamap_layout *layout, void *key);
+void *jamap_insert(jamap *map, jamap_layout *layout, void *key);
+void jamap_remove(jamap *map, jamap_layout *layout, void *key);
+void jamap_clear(jamap *map);
+
+static inline void *jamap_get(
+	jamap *map, jamap_layout *layout, void *key, void *zero
+) {
+	void *val = jamap_find(map, layout, key);
+	return val ? val : zero;
+}
+
+/*
+	default heap
+	
+	new and delete without an allocator call ja_alloc and ja_free; small
+	objects come from per-thread free lists, one for each size class, and
+	larger ones are mapped directly. ja_free is told the size again, so
+	objects carry no header. Compiling with -malloc defines JA_SYSTEM_MALLOC,
+	which maps both onto malloc and free for comparison
+*/
+
+#ifdef JA_SYSTEM_MALLOC
+
+static inline void *ja_alloc(int64_t size)
+{
+	return malloc(size);
+}
+
+static inline void ja_free(void *ptr, int64_t size)
+{
+	free(ptr);
+}
+
+#else
+
+// 16 byte steps up to 256, then powers of two up to 32768
+#define JAHEAP_CLASSES 23
+#define JAHEAP_SMALL_MAX 32768
+#define JAHEAP_CHUNK_SIZE 65536
+
+extern _Thread_local void *jaheap_lists[JAHEAP_CLASSES];
+
+void *jaheap_refill(int sizeclass);
+void *jaheap_map(int64_t size);
+void jaheap_unmap(void *ptr, int64_t size);
+
+static inline int jaheap_class(int64_t size)
+{
+	if(size <= 256)
+		return size > 0 ? (size - 1) >> 4 : 0;
+	
+	return 64 - __builtin_clzll(size - 1) + 7;
+}
+
+static inline void *ja_alloc(int64_t size)
+{
+	if(__builtin_expect(size > JAHEAP_SMALL_MAX, 0))
+		return jaheap_map(size);
+	
+	int sizeclass = jaheap_class(size);
+	void *ptr = jaheap_lists[sizeclass];
+	
+	if(__builtin_expect(ptr == 0, 0))
+		return jaheap_refill(sizeclass);
+	
+	jaheap_lists[sizeclass] = *(void**)ptr;
+	return ptr;
+}
+
+static inline void ja_free(void *ptr, int64_t size)
+{
+	if(ptr == 0) return;
+	
+	if(__builtin_expect(size > JAHEAP_SMALL_MAX, 0)) {
+		jaheap_unmap(ptr, size);
+		return;
+	}
+	
+	int sizeclass = jaheap_class(size);
+	*(void**)ptr = jaheap_lists[sizeclass];
+	jaheap_lists[sizeclass] = ptr;
+}
+
+#endif
+
+/*
+	arenas and pools
+	
+	an arena bumps a cursor through a chain of blocks, deleting it rewinds to
+	the first block in O(1) and keeps the blocks for reuse; a pool hands out
+	objects of one type from an arena of its own and recycles deleted ones
+	through a free list
+*/
+
+#define JAARENA_BLOCK_SIZE 65536
+
+typedef struct jaarena_block {
+	struct jaarena_block *next;
+	int64_t size;
+} jaarena_block;
+
+typedef struct {
+	char *cursor;
+	char *end;
+	jaarena_block *first;
+	jaarena_block *current;
+} jaarena;
+
+typedef struct {
+	void *free;
+	jaarena arena;
+} japool;
+
+void *jaarena_alloc_slow(jaarena *arena, int64_t size);
+
+static inline void *jaarena_alloc(jaarena *arena, int64_t size)
+{
+	size = (size + 15) & ~(int64_t)15;
+	
+	if(__builtin_expect(arena->end - arena->cursor < size, 0))
+		return jaarena_alloc_slow(arena, size);
+	
+	void *ptr = arena->cursor;
+	arena->cursor += size;
+	return ptr;
+}
+
+static inline void jaarena_reset(jaarena *arena)
+{
+	if(arena->first) {
+		arena->current = arena->first;
+		arena->cursor = (char*)(arena->first + 1);
+		arena->end = arena->cursor + arena->first->size;
+	}
+}
+
+static inline void *japool_alloc(japool *pool, int64_t size)
+{
+	void *ptr = pool->free;
+	
+	if(ptr) {
+		pool->free = *(void**)ptr;
+		return ptr;
+	}
+	
+	return jaarena_alloc(&pool->arena, size);
+}
+
+static inline void japool_free(japool *pool, void *ptr)
+{
+	if(ptr) {
+		*(void**)ptr = pool->free;
+		pool->free = ptr;
+	}
+}
+
+static inline void japool_reset(japool *pool)
+{
+	pool->free = 0;
+	jaarena_reset(&pool->arena);
+}
+
+/*
+	foreign imports
+	
+	each library is opened once per process, however many units import it,
+	foreign functions look up their symbol on the first call
+*/
+
+void *jaforeign_lib(char *filename);
+void *jaforeign_bind(char *filename, char *name);
+
+/*
+	print output buffer
+	
+	print statements append to this buffer, which is written to stdout when it
+	is full, at exit, before foreign functions are called and, when stdout is a
+	terminal, at the end of each printed line
+*/
+
+#define JAPRINT_BUF_SIZE 65536
+
+extern char japrint_buf[JAPRINT_BUF_SIZE];
+extern int64_t japrint_len;
+
+void jaflush();
+void japrint_drain();
+void japrint_raw_slow(char *data, int64_t length);
+void japrint_string(jastring string);
+void japrint_int(int64_t val);
+void japrint_uint(uint64_t val);
+void japrint_bool(jabool val);
+void japrint_ptr(void *ptr);
+void japrint_newline();
+
+static inline void japrint_sync()
+{
+	if(japrint_len) japrint_drain();
+}
+
+static inline void japrint_raw(char *data, int64_t length)
+{
+	if(japrint_len + length <= JAPRINT_BUF_SIZE) {
+		memcpy(japrint_buf + japrint_len, data, length);
+		japrint_len += length;
+	}
+	else {
+		japrint_raw_slow(data, length);
+	}
+}
+
 #endif